@@ -0,0 +1,78 @@
+// Bottleneck and blocking analysis based on runtime data
+
+#pragma once
+
+#include "factory.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Runtime statistics of one Worker
+ */
+struct WorkerLoad {
+    ElementID id = 0;
+    double utilization = 0.0;     // fraction of rounds spent processing
+    double mean_queue_length = 0.0;
+    std::size_t max_queue_length = 0;
+    std::size_t final_queue_length = 0;
+    double queue_growth = 0.0;    // least-squares slope, packages per round
+};
+
+/**
+ * @brief End-of-run bottleneck report
+ */
+struct BottleneckReport {
+    Time rounds_observed = 0;
+    std::vector<WorkerLoad> ranking; // most constraining worker first
+    std::vector<ElementID> feeding_ramps;   // ramps upstream of ranking[0]
+    std::vector<ElementID> feeding_workers; // workers upstream of ranking[0]
+};
+
+/**
+ * @brief Collects worker load every round (O(workers), no allocations) and
+ * builds the bottleneck report on demand
+ * Can be called directly from the report function passed to simulate()
+ */
+class BottleneckAnalyzer {
+  public:
+    /**
+     * @brief Collects statistics after round t
+     */
+    void observe(const Factory &f, Time t);
+
+    /**
+     * @brief Ranks workers by queue growth, then utilization, and walks
+     * upstream from the top one via the receiver links
+     */
+    BottleneckReport make_report(const Factory &f) const;
+
+  private:
+    /**
+     * @brief Running sums of one worker (regression of queue size on time)
+     */
+    struct Accumulator {
+        ElementID id = 0;
+        std::size_t busy_rounds = 0;
+        std::size_t max_queue = 0;
+        std::size_t last_queue = 0;
+        double sum_q = 0.0;
+        double sum_tq = 0.0;
+    };
+
+    std::vector<Accumulator> workers_;
+    std::size_t samples_ = 0;
+    double sum_t_ = 0.0;
+    double sum_tt_ = 0.0;
+};
+
+/**
+ * @brief Writes the report in a compact text form
+ */
+void print_bottleneck_report(const BottleneckReport &report, std::ostream &os);
+
+} // namespace NetSim
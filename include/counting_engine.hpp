@@ -0,0 +1,123 @@
+// Rounds of a Net whose packages are only counted (sweeps, modules)
+
+#pragma once
+
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Mutable state of a counting run
+ * Packages are not told apart, so queues are counters. Senders are the
+ * ramps, then the workers; receivers are the workers, then the storehouses
+ */
+struct CountingState {
+    std::vector<std::uint8_t> sending; // output buffer of every sender
+    std::vector<std::size_t> queues;
+    std::vector<std::uint8_t> busy;
+    std::vector<Time> finish; // round the package in hand is done
+    std::vector<std::size_t> stock;
+
+    std::size_t queue_sum = 0; // summed over rounds
+    std::size_t busy_rounds = 0;
+    std::size_t max_queue = 0;
+    std::size_t max_queue_worker = 0;
+
+    /**
+     * @brief Empty Net, keeping the allocated memory
+     */
+    void reset(std::size_t n_ramps, std::size_t n_workers,
+               std::size_t n_storehouses) {
+        sending.assign(n_ramps + n_workers, 0);
+        queues.assign(n_workers, 0);
+        busy.assign(n_workers, 0);
+        finish.assign(n_workers, 0);
+        stock.assign(n_storehouses, 0);
+        queue_sum = 0;
+        busy_rounds = 0;
+        max_queue = 0;
+        max_queue_worker = 0;
+    }
+};
+
+/**
+ * @brief Position of the link a drawn number selects in cumulative
+ * thresholds (as ReceiverPreferences::choose_receiver, the last link is
+ * the safety net)
+ */
+inline std::size_t choose_link(const double *thresholds, std::size_t n,
+                               double p) {
+    std::size_t link = 0;
+    while (link + 1 < n && p > thresholds[link]) {
+        ++link;
+    }
+    return link;
+}
+
+/**
+ * @brief Runs d rounds from an empty Net, the same rounds as simulate()
+ * with unbounded FIFO queues, fixed durations and probability routing
+ * The structure is read through net, so it can be a flat copy (Topology)
+ * or cells shared by many instances (ModularFactory):
+ * - get_ramp_count(), get_worker_count(), get_storehouse_count()
+ * - get_delivery_interval(ramp), get_processing_duration(worker)
+ * - route(sender, receiver): draws the number of the sender (also without
+ *   receivers, as choose_receiver does), false if it has no receivers
+ */
+template <typename Net>
+void run_counting_rounds(Net &net, CountingState &state, TimeOffset d) {
+    std::size_t n_ramps = net.get_ramp_count();
+    std::size_t n_workers = net.get_worker_count();
+    std::size_t n_senders = n_ramps + n_workers;
+    state.reset(n_ramps, n_workers, net.get_storehouse_count());
+
+    for (Time t = 1; t <= d; ++t) {
+        // Deliveries
+        for (std::size_t r = 0; r < n_ramps; ++r) {
+            if ((t - 1) % net.get_delivery_interval(r) == 0) {
+                state.sending[r] = 1;
+            }
+        }
+
+        // Package passing
+        for (std::size_t s = 0; s < n_senders; ++s) {
+            std::uint32_t receiver;
+            if (!state.sending[s] || !net.route(s, receiver)) {
+                continue; // nothing to send, or no receivers - it stays
+            }
+            if (receiver < n_workers) {
+                ++state.queues[receiver];
+            } else {
+                ++state.stock[receiver - n_workers];
+            }
+            state.sending[s] = 0;
+        }
+
+        // Work
+        for (std::size_t w = 0; w < n_workers; ++w) {
+            if (!state.busy[w] && state.queues[w] > 0) {
+                --state.queues[w];
+                state.busy[w] = 1;
+                state.finish[w] = t + net.get_processing_duration(w) - 1;
+            }
+            if (state.busy[w]) {
+                ++state.busy_rounds;
+                if (t >= state.finish[w]) {
+                    state.sending[n_ramps + w] = 1;
+                    state.busy[w] = 0;
+                }
+            }
+            state.queue_sum += state.queues[w];
+            if (state.queues[w] > state.max_queue) {
+                state.max_queue = state.queues[w];
+                state.max_queue_worker = w;
+            }
+        }
+    }
+}
+
+} // namespace NetSim
@@ -0,0 +1,225 @@
+// Differential verification of optimized engines against the Factory
+
+#pragma once
+
+#include "factory.hpp"
+#include "node_counts.hpp"
+#include "static_factory.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief FNV-1a hash of one node: its type, ID and the values added
+ * Packages are added by number - the order of their delivery in the run,
+ * not the ID (two Factories in a process share the IDs, StaticFactory
+ * reuses them)
+ */
+class NodeHash {
+  public:
+    static constexpr std::uint64_t NO_PACKAGE = ~0ULL; // empty buffer
+    static constexpr std::uint64_t UNNUMBERED = ~0ULL - 1; // put in from outside
+
+    NodeHash(NodeType type, ElementID id);
+
+    void add(std::uint64_t value);
+
+    NodeType get_type() const { return type_; }
+    ElementID get_id() const { return id_; }
+    std::uint64_t get() const { return hash_; }
+
+  private:
+    NodeType type_;
+    ElementID id_;
+    std::uint64_t hash_;
+};
+
+/**
+ * @brief Hash of the whole state: sum of the node hashes, so the nodes may
+ * be added in any order
+ */
+class StateHash {
+  public:
+    /**
+     * @param keep_nodes keeps every node hash (to locate a difference)
+     */
+    explicit StateHash(bool keep_nodes = false) : keep_nodes_(keep_nodes) {}
+
+    void add(const NodeHash &node);
+
+    std::uint64_t get() const { return sum_; }
+
+    /**
+     * @brief Node hashes (with keep_nodes), in the order added
+     */
+    const std::vector<NodeHash> &get_nodes() const { return nodes_; }
+
+  private:
+    bool keep_nodes_;
+    std::uint64_t sum_ = 0;
+    std::vector<NodeHash> nodes_;
+};
+
+/**
+ * @brief Anything that can simulate the Net round by round
+ */
+class ISteppingEngine {
+  public:
+    virtual ~ISteppingEngine() = default;
+
+    /**
+     * @brief Deliveries, package passing and work of round t
+     */
+    virtual void do_round(Time t) = 0;
+
+    virtual NodeCounts get_node_counts() const = 0;
+
+    /**
+     * @brief Adds every node in one pass: a ramp - its output buffer, a
+     * worker - its queue (size, packages front to back), processing and
+     * output buffers, a storehouse - its stock size and the package numbers
+     * folded in arrival order (fold_package_number)
+     */
+    virtual void hash_state(StateHash &hash) const = 0;
+};
+
+/**
+ * @brief Reference engine - the object model (Ramp, Worker, Storehouse)
+ * Numbers the packages its ramps deliver from its first round
+ */
+class FactoryEngine : public ISteppingEngine {
+  public:
+    explicit FactoryEngine(Factory &f) : f_(f) {}
+
+    void do_round(Time t) override;
+    NodeCounts get_node_counts() const override;
+    void hash_state(StateHash &hash) const override;
+
+  private:
+    std::uint64_t number_of(const Package &p) const;
+
+    struct StockDigest {
+        std::size_t size = 0; // packages folded so far
+        std::uint64_t digest = 0;
+    };
+
+    Factory &f_;
+    std::unordered_map<ElementID, std::uint64_t> numbers_; // ID -> number
+    std::uint64_t delivered_ = 0;
+    std::vector<char> ramp_was_empty_;
+    // Stock only grows, so only new packages are folded (cache)
+    mutable std::unordered_map<ElementID, StockDigest> stock_;
+};
+
+/**
+ * @brief StaticFactory with its probability generator
+ * Package numbers are the PackageTable serials
+ */
+template <const auto &Spec, typename Generator>
+class StaticFactoryEngine : public ISteppingEngine {
+  public:
+    explicit StaticFactoryEngine(Generator pg) : pg_(std::move(pg)) {}
+
+    void do_round(Time t) override { factory_.do_round(t, pg_); }
+    NodeCounts get_node_counts() const override {
+        return factory_.collect_node_counts();
+    }
+
+    void hash_state(StateHash &hash) const override {
+        using SF = StaticFactory<Spec>;
+        const PackageTable &table = factory_.get_package_table();
+        auto number = [&table](const PackageHandle *handle) {
+            return handle ? table.get_serial(*handle) : NodeHash::NO_PACKAGE;
+        };
+        for (std::size_t r = 0; r < SF::N_RAMPS; ++r) {
+            NodeHash node(NodeType::RAMP, Spec.ramps[r].id);
+            node.add(number(factory_.get_sending_package(r)));
+            hash.add(node);
+        }
+        for (std::size_t w = 0; w < SF::N_WORKERS; ++w) {
+            NodeHash node(NodeType::WORKER, Spec.workers[w].id);
+            const PackageHandleQueue &queue = factory_.get_queue(w);
+            node.add(queue.size());
+            for (std::size_t i = 0; i < queue.size(); ++i) {
+                node.add(table.get_serial(queue[i]));
+            }
+            node.add(number(factory_.get_processing_package(w)));
+            node.add(number(factory_.get_sending_package(SF::N_RAMPS + w)));
+            hash.add(node);
+        }
+        for (std::size_t s = 0; s < SF::N_STOREHOUSES; ++s) {
+            NodeHash node(NodeType::STOREHOUSE, Spec.storehouses[s].id);
+            node.add(factory_.get_stock(s));
+            node.add(factory_.get_stock_digest(s));
+            hash.add(node);
+        }
+    }
+
+  private:
+    StaticFactory<Spec> factory_;
+    Generator pg_;
+};
+
+/**
+ * @brief Gives every sender the same generator (one shared sequence)
+ * Engines drawing one number per sending node in the Factory order (ramps,
+ * then workers) then route identically, e.g. StaticFactory
+ */
+void set_routing_generator(Factory &f, const ProbabilityGenerator &pg);
+
+/**
+ * @brief Parameters of a random layered Net
+ * Ramps feed workers, workers feed later workers and always one storehouse,
+ * so the Net is consistent and has no cycles
+ */
+struct RandomFactoryOptions {
+    int n_ramps = 3;
+    int n_workers = 50;
+    int n_storehouses = 3;
+    int max_links = 3;             // receivers per sender (at most)
+    TimeOffset max_interval = 3;   // ramp delivery interval 1..max
+    TimeOffset max_duration = 3;   // worker processing duration 1..max
+    std::uint64_t seed = 1;
+};
+
+/**
+ * @brief Builds the same random Net for the same options
+ */
+void build_random_factory(Factory &f, const RandomFactoryOptions &options);
+
+/**
+ * @brief Result of a lockstep run - first divergence, if any
+ */
+struct DifferentialReport {
+    bool diverged = false;
+    Time rounds_compared = 0;
+    Time round = 0; // first round with different state
+    NodeType node_type = NodeType::WORKER;
+    ElementID node_id = 0;
+    // "queue", "busy", "sending", "stock", "missing" or "packages" (same
+    // counts, other packages)
+    std::string field;
+    std::size_t reference_value = 0;
+    std::size_t candidate_value = 0;
+};
+
+/**
+ * @brief Runs both engines for d rounds and compares state hashes after
+ * every round; stops at the first difference and locates the node (counts
+ * first, then the node hashes)
+ */
+DifferentialReport run_differential(ISteppingEngine &reference,
+                                    ISteppingEngine &candidate, TimeOffset d);
+
+void print_differential_report(std::ostream &os,
+                               const DifferentialReport &report);
+
+} // namespace NetSim
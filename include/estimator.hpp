@@ -0,0 +1,69 @@
+// Analytical (queueing network) estimate of the Net, computed without
+// running the simulation
+
+#pragma once
+
+#include "factory.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Solver settings for the traffic equations
+ */
+struct EstimatorOptions {
+    std::size_t max_iterations = 10000;
+    double tolerance = 1e-12; // max change of any arrival rate per iteration
+};
+
+/**
+ * @brief Estimate for one Worker, all rates are in packages per round
+ */
+struct WorkerEstimate {
+    ElementID id = 0;
+    double arrival_rate = 0.0;     // offered load (lambda)
+    double service_rate = 0.0;     // 1 / rounds needed for one package (mu)
+    double utilization = 0.0;      // lambda / mu
+    bool saturated = false;        // utilization >= 1, queue grows forever
+    double mean_queue_length = 0.0; // M/D/1 approximation, inf if saturated
+    double mean_waiting_time = 0.0; // rounds spent in the queue (Little's law)
+    double queue_growth_rate = 0.0; // lambda - mu for saturated workers
+};
+
+/**
+ * @brief Estimate for one Storehouse
+ */
+struct StorehouseEstimate {
+    ElementID id = 0;
+    double arrival_rate = 0.0;
+};
+
+/**
+ * @brief Result of the whole Net estimation
+ */
+struct NetworkEstimate {
+    std::vector<WorkerEstimate> workers;       // in Factory iteration order
+    std::vector<StorehouseEstimate> storehouses;
+    bool converged = false;
+    std::size_t iterations = 0;
+
+    /**
+     * @brief True if any worker is saturated
+     */
+    bool has_saturated_worker() const;
+};
+
+/**
+ * @brief Solves the traffic equations of the Net
+ * lambda_j = sum(ramp rates * p) + sum(departure rate of worker k * p_kj)
+ * where a saturated worker departs at most at its service rate. The sparse
+ * system (links from ReceiverPreferences) is solved with Gauss-Seidel
+ * iterations
+ */
+NetworkEstimate estimate_network(const Factory &f,
+                                 const EstimatorOptions &options = {});
+
+} // namespace NetSim
@@ -2,13 +2,23 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <functional>
 #include <list>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <queue>
+#include <set>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "memory_accounting.hpp"
 #include "nodes.hpp"
+#include "package_table.hpp"
 #include "types.hpp" // REMEMBER TO INCLUDE TYPES WHERE NEEDED
 namespace NetSim {
 /**
@@ -24,12 +34,21 @@ template <typename Node>
 class NodeCollection {
   public:
     // Type alliases
-    using container_t = std::list<Node>;
+    using container_t = std::pmr::list<Node>;
     using iterator = typename container_t::iterator;
     using const_iterator =
         typename container_t::const_iterator; // used by const methods, cannot
                                               // modify elements
 
+    /**
+     * @brief Constructor
+     * @param resource memory for the list nodes (and for the containers
+     * inside allocator-aware nodes - Ramp, Worker)
+     */
+    explicit NodeCollection(
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : container_(resource) {}
+
     // Access methods
     iterator begin() { return container_.begin(); }
     iterator end() { return container_.end(); }
@@ -54,6 +73,65 @@ class NodeCollection {
         }
     }
 
+    /**
+     * @brief Moves node out of the collection without destroying it
+     * The node keeps its address (list splice), so pointers to it stay
+     * valid as long as the returned container lives
+     */
+    container_t extract_by_id(ElementID id) {
+        container_t extracted(container_.get_allocator()); // splice needs it
+        auto it = find_by_id(id);
+        if (it != container_.end()) {
+            extracted.splice(extracted.end(), container_, it);
+        }
+        return extracted;
+    }
+
+    /**
+     * @brief Throws std::logic_error if two nodes share an ID
+     * (add doesn't check, but relocate needs IDs to tell nodes apart)
+     */
+    void check_unique_ids() const {
+        std::set<ElementID> seen;
+        for (const auto &node : container_) {
+            if (!seen.insert(node.get_id()).second) {
+                throw std::logic_error("Duplicate node ID: " +
+                                       std::to_string(node.get_id()));
+            }
+        }
+    }
+
+    /**
+     * @brief Moves the nodes to new memory, in the given order of IDs
+     * Nodes not listed follow in their current order. New nodes are
+     * allocated one after another, so in a pool they end up side by side
+     * Throws std::logic_error (nothing moved) if two nodes share an ID
+     * @return the old container with the moved-from nodes, still alive so
+     * pointers to them can be translated before it is destroyed
+     */
+    container_t relocate(const std::vector<ElementID> &order) {
+        check_unique_ids();
+        std::map<ElementID, iterator> remaining;
+        for (auto it = container_.begin(); it != container_.end(); ++it) {
+            remaining.emplace(it->get_id(), it);
+        }
+        container_t relocated(container_.get_allocator());
+        for (ElementID id : order) {
+            auto found = remaining.find(id);
+            if (found != remaining.end()) {
+                relocated.emplace_back(std::move(*found->second));
+                remaining.erase(found);
+            }
+        }
+        for (auto it = container_.begin(); it != container_.end(); ++it) {
+            if (remaining.count(it->get_id())) {
+                relocated.emplace_back(std::move(*it));
+            }
+        }
+        container_.swap(relocated);
+        return relocated;
+    }
+
     /**
      * @brief Finds an element in the container by the id
      * Uses lambda to compare all Nodes' IDs with a given ID
@@ -84,19 +162,74 @@ class NodeCollection {
  */
 class Factory {
   public:
+    /**
+     * @brief Constructor, the Factory gets its own memory pool
+     * Nodes, their list links and receiver maps are allocated from the pool
+     * in big chunks and released all at once when the Factory is destroyed
+     * (see 'docs/adr/01-memory-resources.md')
+     */
+    Factory();
+
+    /**
+     * @brief Constructor using an external memory resource
+     * e.g. std::pmr::new_delete_resource() for one heap allocation per node
+     * The resource must outlive the Factory
+     */
+    explicit Factory(std::pmr::memory_resource *resource);
+
+    /**
+     * @brief Memory of this Factory for anything without a category below
+     */
+    std::pmr::memory_resource *get_memory_resource() const {
+        return memory_->get_resource(MemoryCategory::OTHER);
+    }
+
+    /**
+     * @brief Memory of this Factory counted as the given category - pass
+     * QUEUES to a worker's PackageQueue and STOCKPILES to a storehouse's
+     * one. Throws std::logic_error for PACKAGE_IDS
+     */
+    std::pmr::memory_resource *
+    get_memory_resource(MemoryCategory category) const {
+        return memory_->get_resource(category);
+    }
+
+    /**
+     * @brief Bytes and blocks of every category now, O(1) - can be taken
+     * in any round. Only memory taken from this Factory's resources is
+     * counted (e.g. not a queue created with the default resource)
+     */
+    MemoryReport get_memory_report() const { return memory_->get_report(); }
+
+    /**
+     * @brief Packages of this Factory, from delivery until their stock (or
+     * the node holding them) is destroyed. Nodes pass handles to them
+     */
+    const PackageTable &get_package_table() const { return *packages_; }
+
     // STRUCTURE MANAGEMENT METHODS
 
     // RAMPS
     /**
      * @brief Adds ramp to the Net
      */
-    void add_ramp(Ramp &&r) { ramps_.add(std::move(r)); }
+    void add_ramp(Ramp &&r) {
+        r.set_package_table(*packages_);
+        ramps_.add(std::move(r));
+    }
 
     /**
      * @brief Removes ramp from the Net
      */
     void remove_ramp(ElementID id) { ramps_.remove_by_id(id); }
 
+    /**
+     * @brief Moves ramp out of the Net (ramps are never receivers)
+     * Its package goes to default_package_table(), like the ones of the
+     * extracted workers and storehouses below
+     */
+    NodeCollection<Ramp>::container_t extract_ramp(ElementID id);
+
     /**
      * @brief Finds ramp by ID
      * Delegating method
@@ -123,12 +256,18 @@ class Factory {
     NodeCollection<Ramp>::const_iterator ramp_cend() const {
         return ramps_.cend();
     }
+    NodeCollection<Ramp>::iterator ramp_begin() { return ramps_.begin(); }
+    NodeCollection<Ramp>::iterator ramp_end() { return ramps_.end(); }
 
     // WORKERS
     /**
      * @brief Adds worker to the Net
      */
-    void add_worker(Worker &&w) { workers_.add(std::move(w)); }
+    void add_worker(Worker &&w) {
+        w.set_package_table(*packages_);
+        workers_.add(std::move(w));
+        active_.dirty = true;
+    }
 
     /**
      * @brief Removes worker from the Net
@@ -136,6 +275,12 @@ class Factory {
      */
     void remove_worker(ElementID id);
 
+    /**
+     * @brief Unlinks worker from all senders and moves it out of the Net
+     * Used when the node must outlive its removal (deferred reclamation)
+     */
+    NodeCollection<Worker>::container_t extract_worker(ElementID id);
+
     /**
      * @brief Finds worker by ID
      * Delegating method
@@ -163,12 +308,17 @@ class Factory {
     NodeCollection<Worker>::const_iterator worker_cend() const {
         return workers_.cend();
     }
+    NodeCollection<Worker>::iterator worker_begin() { return workers_.begin(); }
+    NodeCollection<Worker>::iterator worker_end() { return workers_.end(); }
 
     // STOREHOUSES
     /**
      * @brief Adds storehouse to the Net
      */
-    void add_storehouse(Storehouse &&s) { storehouses_.add(std::move(s)); }
+    void add_storehouse(Storehouse &&s) {
+        s.set_package_table(*packages_);
+        storehouses_.add(std::move(s));
+    }
 
     /**
      * @brief Removes storehouse from the Net
@@ -176,6 +326,11 @@ class Factory {
      */
     void remove_storehouse(ElementID id); // Złożona logika -> w .cpp
 
+    /**
+     * @brief Unlinks storehouse from all senders and moves it out of the Net
+     */
+    NodeCollection<Storehouse>::container_t extract_storehouse(ElementID id);
+
     /**
      * @brief Finds storehouse by ID
      * Delegating method
@@ -203,6 +358,23 @@ class Factory {
     NodeCollection<Storehouse>::const_iterator storehouse_cend() const {
         return storehouses_.cend();
     }
+    NodeCollection<Storehouse>::iterator storehouse_begin() {
+        return storehouses_.begin();
+    }
+    NodeCollection<Storehouse>::iterator storehouse_end() {
+        return storehouses_.end();
+    }
+
+    /**
+     * @brief Lays workers and storehouses out again in the given order of
+     * IDs (see locality.hpp), links are updated
+     * Iteration follows the new order. Pointers and iterators to workers
+     * and storehouses are invalidated - call it between simulations
+     * Throws std::logic_error (nothing moved) if two workers or two
+     * storehouses share an ID
+     */
+    void reorder_nodes(const std::vector<ElementID> &workers,
+                       const std::vector<ElementID> &storehouses);
 
     // VERIFICATION AND SIMULATION METHODS
 
@@ -228,7 +400,72 @@ class Factory {
      */
     void do_work(Time t);
 
+    /**
+     * @brief Steps only the workers that can make progress (off by default)
+     * do_work visits a worker with a package queued or in hand, a busy one
+     * not before its processing ends, one with a behaviour at its wake round
+     * or when a package arrives; do_package_passing visits a worker with a
+     * package in the output buffer. Ramps are always stepped
+     * Visited nodes keep the list order, so the results (and the drawn
+     * numbers) are the same as with full stepping, while the cost of a
+     * round follows the packages instead of the size of the Net
+     */
+    void set_active_stepping(bool enabled);
+
+    bool is_active_stepping() const { return active_.enabled; }
+
+    /**
+     * @brief Rebuilds the active sets from the node state before the next
+     * phase. Structure changes (add, remove, extract, reorder) do it
+     * already, and a worker receiving a package (also receive_package from
+     * outside the Factory) tells the Factory itself - call it after
+     * changing a worker in another way (e.g. set_behaviour, start_processing)
+     */
+    void wake_all_nodes() { active_.dirty = true; }
+
   private:
+    /**
+     * @brief State of active stepping, workers by position in the list
+     */
+    struct ActiveSets {
+        bool enabled = false;
+        bool dirty = true; // rebuild from the node state first
+        Time last_work_round = 0;
+        std::vector<Worker *> workers;
+        std::unordered_map<const IPackageReceiver *, std::size_t> slots;
+        std::vector<std::size_t> sending; // package in the output buffer
+        std::vector<std::size_t> working; // visited by the next do_work
+        std::vector<std::size_t> stepped; // working of the current do_work
+        std::vector<char> is_sending;
+        std::vector<char> is_working;
+        std::vector<Time> wake_round; // busy worker scheduled, 0 - none
+        std::priority_queue<std::pair<Time, std::size_t>,
+                            std::vector<std::pair<Time, std::size_t>>,
+                            std::greater<>>
+            wakeups; // (round, slot), earliest first
+    };
+
+    /**
+     * @brief Workers that received a package since the last do_work, told
+     * by the package table (on the heap, so it stays put if Factory moves)
+     */
+    struct ReceivedWorkers : IReceiveListener {
+        std::vector<const IPackageReceiver *> workers;
+
+        void on_receive(const IPackageReceiver *receiver) override {
+            workers.push_back(receiver);
+        }
+    };
+
+    void rebuild_active_sets();
+    void mark_working(std::size_t slot);
+
+    /**
+     * @brief Wakes the workers that received a package (found by the slot
+     * map, removed ones are skipped)
+     */
+    void wake_received();
+
     template <typename Node>
 
     /**
@@ -237,8 +474,17 @@ class Factory {
      */
     void remove_receiver(NodeCollection<Node> &collection, ElementID id);
 
+    // Declared before the nodes, so it is destroyed after them
+    std::unique_ptr<std::pmr::unsynchronized_pool_resource> pool_;
+    std::pmr::memory_resource *resource_;
+    std::unique_ptr<MemoryAccounts> memory_; // stays put if Factory moves
+    std::unique_ptr<PackageTable> packages_; // nodes keep a pointer to it
+    std::unique_ptr<ReceivedWorkers> received_; // listener of packages_
+
     NodeCollection<Ramp> ramps_;
     NodeCollection<Worker> workers_;
     NodeCollection<Storehouse> storehouses_;
+
+    ActiveSets active_;
 };
 } // namespace NetSim
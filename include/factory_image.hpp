@@ -0,0 +1,108 @@
+// Precompiled binary image of a Net
+
+#pragma once
+
+#include "factory.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace NetSim {
+
+/**
+ * @brief Layout of an image file (native byte order, 8-byte aligned)
+ * Header, then the sections at the header offsets (from the file start):
+ * ramp table, worker table, storehouse table and the links in CSR form.
+ * Links of sender s (ramps, then workers) are link_offsets[s] ..
+ * link_offsets[s + 1] - 1; a link names its receiver by index (workers,
+ * then storehouses), never by pointer, so the file is relocatable
+ */
+struct FactoryImageHeader {
+    char magic[8];               // "NETSIMIM"
+    std::uint32_t version;
+    std::uint32_t byte_order;    // 0x01020304 as written
+    std::uint64_t n_ramps;
+    std::uint64_t n_workers;
+    std::uint64_t n_storehouses;
+    std::uint64_t n_links;
+    std::uint64_t ramps_offset;
+    std::uint64_t workers_offset;
+    std::uint64_t storehouses_offset;
+    std::uint64_t link_offsets_offset;   // n_ramps + n_workers + 1 entries
+    std::uint64_t link_receivers_offset; // n_links entries
+    std::uint64_t link_weights_offset;   // n_links entries
+    std::uint64_t file_size;
+};
+
+struct RampRecord {
+    std::int32_t id;
+    std::int32_t delivery_interval;
+};
+
+struct WorkerRecord {
+    std::int32_t id;
+    std::int32_t processing_duration;
+    std::uint32_t queue_type; // PackageQueueType
+    std::uint32_t queue_capacity;
+};
+
+struct StorehouseRecord {
+    std::int32_t id;
+};
+
+/**
+ * @brief "Compiles" the Net: validates it once and writes the image
+ * Throws std::logic_error for an inconsistent Net, routing policies or
+ * worker behaviours, std::runtime_error when the file can't be written
+ */
+void write_factory_image(Factory &f, const std::string &path);
+
+/**
+ * @brief Read-only mapping of an image file (RAII, munmap on destruction)
+ * The constructor only checks the header and that every section and link
+ * index lies inside the file
+ */
+class FactoryImage {
+  public:
+    /**
+     * @brief Maps the file, throws std::runtime_error for a missing or
+     * malformed image (sections, link indices, non-positive intervals or
+     * durations, unknown queue types)
+     */
+    explicit FactoryImage(const std::string &path);
+    ~FactoryImage();
+
+    FactoryImage(const FactoryImage &) = delete;
+    FactoryImage &operator=(const FactoryImage &) = delete;
+
+    const FactoryImageHeader &get_header() const { return *header_; }
+
+    const RampRecord *ramps() const;
+    const WorkerRecord *workers() const;
+    const StorehouseRecord *storehouses() const;
+    const std::uint64_t *link_offsets() const;
+    const std::uint32_t *link_receivers() const;
+    const double *link_weights() const;
+
+  private:
+    template <typename T> const T *section(std::uint64_t offset) const {
+        return reinterpret_cast<const T *>(data_ + offset);
+    }
+
+    const unsigned char *data_ = nullptr;
+    std::size_t size_ = 0;
+    const FactoryImageHeader *header_ = nullptr;
+};
+
+/**
+ * @brief Builds a ready-to-run Factory from an image
+ * Nodes are created straight from the tables and links are fixed up from
+ * receiver indices to pointers - no parsing, lookups by ID or consistency
+ * check (the image was validated when written)
+ * Throws std::logic_error if f is not empty
+ */
+void load_factory_image(Factory &f, const FactoryImage &image);
+
+} // namespace NetSim
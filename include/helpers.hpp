@@ -3,6 +3,7 @@
 #pragma once
 
 #include "types.hpp"
+#include <cstdint>
 #include <functional>
 #include <random>
 
@@ -17,4 +18,19 @@ double default_probability_generator();
  */
 extern ProbabilityGenerator probability_generator; // extern means that this function is defined somethere else
 
+/**
+ * @brief Creates an independent, reproducible generator for one stream
+ * Same (seed, stream) pair always gives the same sequence, in any process
+ * Antithetic generator returns 1 - u for every u of the normal one
+ */
+ProbabilityGenerator make_stream_generator(std::uint64_t seed,
+                                           std::uint64_t stream,
+                                           bool antithetic = false);
+
+/**
+ * @brief Engine seed of one stream (what make_stream_generator uses)
+ * For engines drawing std::generate_canonical<double, 10> themselves
+ */
+std::uint64_t stream_seed(std::uint64_t seed, std::uint64_t stream);
+
 } // namespace NetSim
@@ -0,0 +1,122 @@
+// Live statistics of a running simulation, published in shared memory
+
+#pragma once
+
+#include "factory.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Layout of the shared memory segment
+ * Protected by a seqlock: the writer makes sequence odd, updates the
+ * fields and makes it even again. Readers retry while sequence is odd or
+ * has changed during their copy. All fields are lock-free atomics, so the
+ * segment is valid in both processes
+ */
+struct LiveStatsSegment {
+    static constexpr std::uint32_t MAGIC = 0x4E534C53; // "NSLS"
+
+    struct NodeCounter {
+        std::atomic<std::int32_t> id;
+        std::atomic<std::int64_t> value; // queue length or stored packages
+    };
+
+    std::uint32_t magic;
+    std::uint32_t capacity; // max workers and max storehouses
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<std::int64_t> round;
+    std::atomic<double> rounds_per_second;
+    std::atomic<std::uint32_t> n_workers;
+    std::atomic<std::uint32_t> n_storehouses;
+    std::atomic<std::uint32_t> truncated; // 1 if the Net exceeds capacity
+
+    // Followed by capacity worker counters, then capacity storehouse counters
+    NodeCounter *workers() { return reinterpret_cast<NodeCounter *>(this + 1); }
+    NodeCounter *storehouses() { return workers() + capacity; }
+
+    static std::size_t size_for(std::uint32_t capacity) {
+        return sizeof(LiveStatsSegment) + 2 * capacity * sizeof(NodeCounter);
+    }
+};
+
+/**
+ * @brief Consistent copy of the segment made by a reader
+ */
+struct LiveStatsSnapshot {
+    Time round = 0;
+    double rounds_per_second = 0.0;
+    bool truncated = false;
+    std::vector<std::pair<ElementID, std::int64_t>> worker_queues;
+    std::vector<std::pair<ElementID, std::int64_t>> storehouse_totals;
+};
+
+/**
+ * @brief Publishes live counters of the simulation (writer side)
+ * Never blocks or does I/O: every publish() only stores counters into
+ * the mapped segment
+ */
+class LiveStatsPublisher {
+  public:
+    /**
+     * @brief Creates the segment (POSIX shm name, e.g. "/netsim")
+     * @param capacity max workers and storehouses that are published
+     * @param publish_every publish every n-th round only
+     */
+    LiveStatsPublisher(const std::string &name, std::uint32_t capacity,
+                       Time publish_every = 1);
+
+    LiveStatsPublisher(const LiveStatsPublisher &) = delete;
+    LiveStatsPublisher &operator=(const LiveStatsPublisher &) = delete;
+
+    /**
+     * @brief Unmaps and removes the segment
+     */
+    ~LiveStatsPublisher();
+
+    /**
+     * @brief Stores the counters of the Net after round t
+     */
+    void publish(const Factory &f, Time t);
+
+  private:
+    std::string name_;
+    std::size_t size_;
+    Time publish_every_;
+    LiveStatsSegment *segment_;
+
+    std::chrono::steady_clock::time_point last_time_;
+    Time last_round_ = 0;
+};
+
+/**
+ * @brief Reads the segment of a running simulation
+ */
+class LiveStatsReader {
+  public:
+    explicit LiveStatsReader(const std::string &name);
+
+    LiveStatsReader(const LiveStatsReader &) = delete;
+    LiveStatsReader &operator=(const LiveStatsReader &) = delete;
+
+    ~LiveStatsReader();
+
+    /**
+     * @brief Copies a consistent state, false if the writer kept updating
+     * during max_retries attempts
+     */
+    bool read(LiveStatsSnapshot &snapshot, int max_retries = 1000) const;
+
+  private:
+    std::size_t size_;
+    LiveStatsSegment *segment_;
+};
+
+} // namespace NetSim
@@ -0,0 +1,41 @@
+// Node orders that put producers next to their consumers in memory
+
+#pragma once
+
+#include "factory.hpp"
+#include "types.hpp"
+
+#include <vector>
+
+namespace NetSim {
+
+enum class NodeOrder {
+    BFS,         // breadth-first from the ramps (as make_partition_plan)
+    TOPOLOGICAL, // every worker after all workers feeding it, if no cycles
+    CHAINS       // depth-first, a worker is followed by its main consumer
+};
+
+/**
+ * @brief New order of workers and storehouses (IDs)
+ * Nodes not reachable from a ramp keep their order at the end; workers in
+ * cycles are placed in BFS order after the topologically ordered ones
+ */
+struct NodeLayout {
+    std::vector<ElementID> workers;
+    std::vector<ElementID> storehouses;
+};
+
+NodeLayout make_node_layout(const Factory &f, NodeOrder order = NodeOrder::BFS);
+
+/**
+ * @brief Reorders the Factory for locality (Factory::reorder_nodes)
+ * Routing doesn't change, but the order in which senders and workers are
+ * stepped does - with per-sender streams and unbounded queues the node
+ * counts of a run stay the same
+ * No benefit has been demonstrated: tools/netsim_locality_bench.cpp shows
+ * more links within a page, but round time unchanged within noise and no
+ * cache-miss counts (perf was not available) - measure before relying on it
+ */
+void reorder_for_locality(Factory &f, NodeOrder order = NodeOrder::BFS);
+
+} // namespace NetSim
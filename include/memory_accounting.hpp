@@ -0,0 +1,118 @@
+// Memory accounting per subsystem (counting memory resources)
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
+namespace NetSim {
+
+enum class MemoryCategory {
+    NODE_LISTS,  // list nodes holding ramps, workers and storehouses
+    PREFERENCES, // receiver maps of ramps and workers
+    QUEUES,      // worker queues
+    STOCKPILES,  // storehouse stockpiles
+    PACKAGE_IDS, // assigned and freed package IDs (global, all Factories)
+    OTHER        // anything else taken from Factory::get_memory_resource()
+};
+
+constexpr std::size_t N_MEMORY_CATEGORIES = 6;
+
+const char *memory_category_name(MemoryCategory category);
+
+/**
+ * @brief Memory taken from a resource, in requested bytes (the pool's own
+ * overhead is not included)
+ */
+struct MemoryUsage {
+    std::size_t bytes = 0;
+    std::size_t blocks = 0; // live allocations, one per list/map/set element
+    std::size_t peak_bytes = 0;
+    std::size_t allocations = 0; // all allocations so far
+};
+
+/**
+ * @brief Resource forwarding to an upstream one and counting what it hands
+ * out. A few additions per allocation - cheap enough to stay on
+ * Not synchronized, like the Factory pool
+ */
+class CountingMemoryResource : public std::pmr::memory_resource {
+  public:
+    /**
+     * @param nested resource for the containers inside the objects
+     * allocated here (see nested_resource), nullptr - this one
+     */
+    explicit CountingMemoryResource(
+        std::pmr::memory_resource *upstream = std::pmr::get_default_resource(),
+        std::pmr::memory_resource *nested = nullptr);
+
+    const MemoryUsage &get_usage() const { return usage_; }
+
+    std::pmr::memory_resource *get_upstream() const { return upstream_; }
+
+    std::pmr::memory_resource *get_nested() const { return nested_; }
+
+  private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *p, std::size_t bytes,
+                       std::size_t alignment) override;
+    bool do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept override;
+
+    std::pmr::memory_resource *upstream_;
+    std::pmr::memory_resource *nested_;
+    MemoryUsage usage_;
+};
+
+/**
+ * @brief Resource for the containers inside an object allocated from the
+ * given one - a node list passes its allocator to the nodes, this lets the
+ * receiver maps be counted apart from the list nodes
+ */
+std::pmr::memory_resource *
+nested_resource(std::pmr::memory_resource *resource);
+
+/**
+ * @brief Memory of every category at one moment
+ */
+struct MemoryReport {
+    std::array<MemoryUsage, N_MEMORY_CATEGORIES> categories;
+
+    const MemoryUsage &operator[](MemoryCategory category) const {
+        return categories[static_cast<std::size_t>(category)];
+    }
+    MemoryUsage &operator[](MemoryCategory category) {
+        return categories[static_cast<std::size_t>(category)];
+    }
+
+    std::size_t total_bytes() const;
+};
+
+/**
+ * @brief Counting resources of one Factory, one per category, over its
+ * memory (PACKAGE_IDS is global, see Package::get_id_memory_usage)
+ */
+class MemoryAccounts {
+  public:
+    explicit MemoryAccounts(std::pmr::memory_resource *upstream);
+
+    /**
+     * @brief Throws std::logic_error for PACKAGE_IDS
+     */
+    CountingMemoryResource *get_resource(MemoryCategory category);
+
+    /**
+     * @brief Usage of the Factory categories and of the package IDs
+     */
+    MemoryReport get_report() const;
+
+  private:
+    CountingMemoryResource preferences_;
+    CountingMemoryResource node_lists_; // nested: preferences_
+    CountingMemoryResource queues_;
+    CountingMemoryResource stockpiles_;
+    CountingMemoryResource other_;
+};
+
+} // namespace NetSim
@@ -0,0 +1,127 @@
+// Columnar, compressed per-round metrics of the simulation
+
+#pragma once
+
+#include "factory.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Recorded quantity
+ */
+enum class MetricType : std::uint8_t {
+    ROUND,            // time column, one per file
+    QUEUE_SIZE,       // Worker input queue size()
+    BUSY,             // 1 if Worker processed a package in the round
+    BUFFER_OCCUPANCY, // 1 if sender's output buffer holds a package
+    STOCK_SIZE        // packages in a Storehouse
+};
+
+/**
+ * @brief Describes one column of the file
+ */
+struct MetricColumn {
+    MetricType type;
+    ElementID node_id; // 0 for the ROUND column
+};
+
+/**
+ * @brief Recorder settings
+ */
+struct MetricsOptions {
+    Time sample_every = 1;          // downsampling - record every n-th round
+    std::size_t block_rows = 4096;  // rows encoded together in one block
+    std::size_t block_bytes = std::size_t(1) << 22; // ends a block earlier
+};
+
+/**
+ * @brief Writes metrics into a columnar binary file
+ * File: header (magic, column descriptors), then blocks. Each block holds
+ * up to block_rows rows stored column by column; every column is
+ * delta-encoded (zigzag + varint), prefixed with its byte length so readers
+ * can skip columns they don't need. Rows are encoded as they are recorded,
+ * and a block also ends once its columns take block_bytes, so the memory
+ * held does not grow with the number of columns times block_rows
+ */
+class MetricsRecorder {
+  public:
+    explicit MetricsRecorder(const std::string &path,
+                             const MetricsOptions &options = {});
+
+    /**
+     * @brief Writes the last (partial) block
+     */
+    ~MetricsRecorder();
+
+    /**
+     * @brief Records state of the Net after round t (if sampled)
+     * Columns are fixed by the first call - throws std::logic_error if
+     * the structure changes later
+     */
+    void record(const Factory &f, Time t);
+
+    /**
+     * @brief Writes buffered rows and closes the file
+     */
+    void close();
+
+    const std::vector<MetricColumn> &get_columns() const { return columns_; }
+
+  private:
+    void write_header(const Factory &f);
+    void write_block();
+
+    MetricsOptions options_;
+    std::ofstream out_;
+    std::vector<MetricColumn> columns_;
+    /**
+     * @brief Encoded values of one column in the current block
+     */
+    struct ColumnStream {
+        std::string encoded;
+        std::int64_t previous = 0; // every block decodes on its own
+    };
+
+    std::vector<ColumnStream> streams_; // current block, per column
+    std::size_t rows_ = 0;
+    std::size_t block_size_ = 0; // encoded bytes of the current block
+    bool header_written_ = false;
+    bool closed_ = false;
+};
+
+/**
+ * @brief Reads files written by MetricsRecorder
+ */
+class MetricsReader {
+  public:
+    explicit MetricsReader(const std::string &path);
+
+    const std::vector<MetricColumn> &get_columns() const { return columns_; }
+
+    Time get_sample_every() const { return sample_every_; }
+
+    /**
+     * @brief Index of a column, throws std::out_of_range if missing
+     */
+    std::size_t find_column(MetricType type, ElementID node_id) const;
+
+    /**
+     * @brief Decodes a whole column, other columns are skipped
+     */
+    std::vector<std::int64_t> read_column(std::size_t index);
+
+  private:
+    std::ifstream in_;
+    std::vector<MetricColumn> columns_;
+    Time sample_every_ = 1;
+    std::streampos data_begin_;
+};
+
+} // namespace NetSim
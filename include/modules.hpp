@@ -0,0 +1,193 @@
+// Reusable cells: a group of workers defined once and instantiated many
+// times, all instances sharing one copy of the structure
+
+#pragma once
+
+#include "counting_engine.hpp"
+#include "factory.hpp"
+#include "node_counts.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Immutable definition of a cell (made by CellBuilder)
+ * Workers are numbered 0..n-1 inside the cell. Internal links are stored
+ * in CSR form with cumulative probabilities, like Topology. A worker sends
+ * with equal probability over its internal links and output ports (as
+ * ReceiverPreferences::add_receiver does)
+ */
+class CellType {
+  public:
+    std::size_t get_worker_count() const { return durations_.size(); }
+    std::size_t get_input_count() const { return inputs_.size(); }
+    std::size_t get_output_count() const { return outputs_.size(); }
+
+    TimeOffset get_processing_duration(std::size_t worker) const {
+        return durations_[worker];
+    }
+    // Local worker behind an input or output port
+    std::size_t get_input_worker(std::size_t port) const {
+        return inputs_[port];
+    }
+    std::size_t get_output_worker(std::size_t port) const {
+        return outputs_[port];
+    }
+
+  private:
+    friend class CellBuilder;
+    friend class ModularFactory;
+
+    std::vector<TimeOffset> durations_;
+    std::vector<std::uint32_t> inputs_;  // port -> local worker
+    std::vector<std::uint32_t> outputs_; // port -> local worker
+
+    std::vector<std::size_t> link_offsets_;    // workers + 1
+    std::vector<std::uint32_t> link_targets_;  // local worker
+    std::vector<double> link_thresholds_;      // internal-only workers
+
+    // Workers with output ports route per instance (targets are outside),
+    // boundary_[w] is their slot, or NO_SLOT
+    static constexpr std::uint32_t NO_SLOT = UINT32_MAX;
+    std::vector<std::uint32_t> boundary_;
+    std::vector<std::vector<std::uint32_t>> boundary_ports_; // slot -> ports
+};
+
+/**
+ * @brief Defines a cell step by step, then freezes it
+ * Throws std::logic_error for unknown workers, self or duplicate links
+ */
+class CellBuilder {
+  public:
+    /**
+     * @return local index of the new worker
+     */
+    std::size_t add_worker(TimeOffset pd);
+
+    void add_link(std::size_t from, std::size_t to);
+
+    /**
+     * @brief Packages from outside enter the cell at this worker
+     * @return input port number
+     */
+    std::size_t add_input(std::size_t worker);
+
+    /**
+     * @brief The worker also sends outside, to whatever the port of an
+     * instance is connected to
+     * @return output port number
+     */
+    std::size_t add_output(std::size_t worker);
+
+    std::shared_ptr<const CellType> build() const;
+
+  private:
+    std::vector<TimeOffset> durations_;
+    std::vector<std::vector<std::uint32_t>> links_;
+    std::vector<std::uint32_t> inputs_;
+    std::vector<std::uint32_t> outputs_;
+};
+
+/**
+ * @brief Plant made of ramps, storehouses and cell instances
+ * Instances keep only their own state: queues, timers, buffers, random
+ * engines (of workers with more than one receiver) and the routing of
+ * their output workers. Worker IDs of an instance are first_worker_id +
+ * local index. Runs the same rounds as
+ * simulate() on the expanded Net seeded with seed_routing_streams(), with
+ * the counting engine of the sweeps (run_counting_rounds: unbounded FIFO
+ * queues, packages counted, not told apart). For reports, traces, metrics
+ * or time travel expand() it into a Factory
+ */
+class ModularFactory {
+  public:
+    void add_ramp(ElementID id, TimeOffset di);
+    void add_storehouse(ElementID id);
+
+    /**
+     * @brief Adds an instance, throws std::logic_error if its worker IDs
+     * overlap another instance
+     * @return instance number
+     */
+    std::size_t add_instance(std::shared_ptr<const CellType> cell,
+                             ElementID first_worker_id);
+
+    void link_ramp(ElementID ramp, std::size_t instance, std::size_t input);
+
+    void connect_output(std::size_t instance, std::size_t output,
+                        std::size_t to_instance, std::size_t to_input);
+    void connect_output_to_storehouse(std::size_t instance, std::size_t output,
+                                      ElementID storehouse);
+
+    std::size_t get_instance_count() const { return instances_.size(); }
+    std::size_t get_worker_count() const { return n_workers_; }
+
+    /**
+     * @brief Runs d rounds from an empty plant
+     * Throws std::logic_error for unconnected outputs or duplicate links
+     */
+    void simulate(TimeOffset d, std::uint64_t seed);
+
+    NodeCounts collect_node_counts() const;
+
+    /**
+     * @brief Builds the same Net node by node into an empty Factory
+     */
+    void expand(Factory &f) const;
+
+  private:
+    // Where an output port sends to
+    struct Target {
+        bool connected = false;
+        bool storehouse = false;
+        std::size_t worker = 0;    // global index
+        ElementID storehouse_id = 0;
+    };
+
+    struct Instance {
+        std::shared_ptr<const CellType> cell;
+        ElementID first_worker_id;
+        std::size_t first_worker; // global index
+        std::vector<Target> outputs;
+
+        // Resolved routing of boundary workers (per slot, CSR)
+        std::vector<std::size_t> route_offsets;
+        std::vector<std::uint32_t> route_receivers;
+        std::vector<double> route_thresholds;
+    };
+
+    struct RampNode {
+        ElementID id;
+        TimeOffset delivery_interval;
+        std::vector<std::size_t> workers; // global indices
+
+        std::vector<std::uint32_t> route_receivers;
+        std::vector<double> route_thresholds;
+    };
+
+    Instance &get_instance(std::size_t instance);
+    ElementID worker_id(std::size_t global) const;
+    std::size_t instance_of(std::size_t global) const;
+    std::size_t storehouse_index(ElementID id) const;
+    void resolve_routes();
+
+    std::vector<RampNode> ramps_;
+    std::vector<ElementID> storehouse_ids_;
+    std::vector<Instance> instances_;
+    std::size_t n_workers_ = 0;
+
+    // Run state, one entry per sender (ramps first, then global workers).
+    // Receivers are global worker indices, then storehouses
+    static constexpr std::uint32_t NO_ENGINE = UINT32_MAX;
+    std::vector<std::mt19937_64> engines_;    // branching senders only
+    std::vector<std::uint32_t> engine_index_; // per sender, or NO_ENGINE
+    CountingState state_; // queues, buffers, timers (counting_engine.hpp)
+};
+
+} // namespace NetSim
@@ -0,0 +1,33 @@
+// Node state in a form every engine can produce
+
+#pragma once
+
+#include "factory.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <map>
+
+namespace NetSim {
+
+/**
+ * @brief State of every node at the end of a run
+ * Package IDs are not compared - every engine (or process) numbers
+ * packages on its own
+ */
+struct NodeCounts {
+    std::map<ElementID, std::size_t> worker_queues;
+    std::map<ElementID, std::size_t> worker_busy;     // processing buffer 0/1
+    std::map<ElementID, std::size_t> worker_sending;  // output buffer 0/1
+    std::map<ElementID, std::size_t> storehouse_stock;
+
+    bool operator==(const NodeCounts &other) const;
+    bool operator!=(const NodeCounts &other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Collects node counts of a (single-process) Factory
+ */
+NodeCounts collect_node_counts(const Factory &f);
+
+} // namespace NetSim
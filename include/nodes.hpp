@@ -6,16 +6,57 @@
 #include "storage_types.hpp"
 #include "types.hpp"
 
+#include <cstddef>
 #include <map>
 #include <memory>
-#include <optional> // for buffer
+#include <memory_resource>
 
 namespace NetSim {
 
 enum class ReceiverType { WORKER, STOREHOUSE };
 
+/**
+ * @brief Any node of the Net (used where ramps count as well, e.g. links)
+ */
+enum class NodeType { RAMP, WORKER, STOREHOUSE };
+
+/**
+ * @brief Identifies a node of the Net
+ */
+struct NodeRef {
+    NodeType type;
+    ElementID id;
+};
+
 // Forward declaration (ReceiverPreferences uses it)
 class IPackageReceiver;
+class ReceiverPreferences;
+
+/**
+ * @brief Strategy picking the receiver of one sender instead of the static
+ * probabilities, e.g. from the receivers' current load
+ * A policy belongs to one sender and may keep state between decisions
+ */
+class IRoutingPolicy {
+  public:
+    virtual ~IRoutingPolicy() = default;
+
+    /**
+     * @brief Picks a receiver (nullptr if there are none)
+     * @param pg the sender's probability generator, for random policies
+     */
+    virtual IPackageReceiver *choose(const ReceiverPreferences &prefs,
+                                     ProbabilityGenerator &pg) = 0;
+};
+
+/**
+ * @brief Orders receivers by type and ID instead of memory address
+ * Keeps the routing (which receiver a drawn probability selects) the same
+ * in every run and every process. IDs are unique within a receiver type
+ */
+struct ReceiverOrder {
+    bool operator()(const IPackageReceiver *a, const IPackageReceiver *b) const;
+};
 
 /**
  * @brief Helper class, concrete
@@ -25,10 +66,14 @@ class ReceiverPreferences {
   public:
     // Using map data type for storing probability for choosing a given receiver
     // with pointers to base class which Worker and Storehouse derive from
-    using preferences_t = std::map<IPackageReceiver *, double>;
+    using preferences_t =
+        std::pmr::map<IPackageReceiver *, double, ReceiverOrder>;
 
     using const_iterator = preferences_t::const_iterator;
 
+    // Map nodes go to the memory of the owning Factory
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
     /**
      * @brief Constructor
      * @param pg Probability Generator (by default it's global from
@@ -37,6 +82,14 @@ class ReceiverPreferences {
     explicit ReceiverPreferences(
         ProbabilityGenerator pg = probability_generator);
 
+    /**
+     * @brief Moving constructor placing the map in the given memory
+     */
+    ReceiverPreferences(ReceiverPreferences &&other,
+                        const allocator_type &alloc);
+
+    ReceiverPreferences(ReceiverPreferences &&other);
+
     /**
      * @brief Method for adding receivers
      * This method allows to keep the class constant - all probabilities
@@ -44,13 +97,50 @@ class ReceiverPreferences {
      */
     void add_receiver(IPackageReceiver *receiver);
 
+    /**
+     * @brief Adds receiver with a given probability, without rescaling
+     * For restoring saved preferences - the caller keeps the sum at one
+     */
+    void add_receiver(IPackageReceiver *receiver, double probability);
+
     /**
      * @brief Method for removing receivers
      */
     void remove_receiver(IPackageReceiver *receiver);
 
     /**
-     * @brief Picks a receiver based on probability distribution
+     * @brief Replaces a receiver keeping its probability
+     * Replacement must have the same type and ID (e.g. a proxy)
+     */
+    void replace_receiver(IPackageReceiver *old_receiver,
+                          IPackageReceiver *new_receiver);
+
+    /**
+     * @brief Sets the probability generator used by choose_receiver
+     */
+    void set_probability_generator(ProbabilityGenerator pg);
+
+    const ProbabilityGenerator &get_probability_generator() const;
+
+    /**
+     * @brief Sets the routing policy, nullptr (default) - probabilities
+     */
+    void set_routing_policy(std::unique_ptr<IRoutingPolicy> policy);
+
+    const IRoutingPolicy *get_routing_policy() const;
+
+    /**
+     * @brief Stamp of the current receivers, taken from a process-wide
+     * counter on construction, move and every change of the receivers
+     * Equal stamps mean the same object and receivers, even when a new
+     * object reuses the memory of a removed one - lets policies and the
+     * replayer know when their copy of the receivers is out of date
+     */
+    std::size_t get_revision() const;
+
+    /**
+     * @brief Picks a receiver based on probability distribution, or asks
+     * the routing policy if there is one
      * @return pointer to the choosen receiver
      */
     IPackageReceiver *choose_receiver();
@@ -72,11 +162,14 @@ class ReceiverPreferences {
   private:
     preferences_t preferences_; // map containing pointers and numbers
     ProbabilityGenerator pg_;
+    std::unique_ptr<IRoutingPolicy> policy_;
+    std::size_t revision_ = 0;
 };
 
 /**
  * @brief Base class for sending Nodes (Ramp, Worker)
- * Uses buffer
+ * Uses buffer, a handle into the package table of the node (Ramp and
+ * Worker know the table, so it isn't stored twice in a Worker)
  */
 class PackageSender {
   public:
@@ -86,15 +179,18 @@ class PackageSender {
     PackageSender() = default;
 
     /**
-     * @brief Default Moving constructor
+     * @brief Moving constructor, the package in the buffer goes along
      */
-    PackageSender(PackageSender &&) = default;
+    PackageSender(PackageSender &&other);
 
     /**
-     * @brief Sends package from buffer to the choosen receiver
-     * If buffer is empty, it does nothig
+     * @brief Moving constructor used when a node is added to a Factory
+     * (std::pmr containers pass their allocator to allocator-aware nodes)
      */
-    void send_package();
+    using allocator_type = ReceiverPreferences::allocator_type;
+    PackageSender(PackageSender &&other, const allocator_type &alloc);
+
+    PackageSender &operator=(PackageSender &&) = delete;
 
     /**
      * @brief Method for getting receiver preferences
@@ -105,17 +201,40 @@ class PackageSender {
     // Non-const version to be able to modify
     ReceiverPreferences &get_receiver_preferences();
 
-    // No destructor since both 'std::optional<Package>' and
-    // 'ReceiverPreferences' are intelligent and clean up after themselves
+    /**
+     * @brief Rounds in which the chosen receiver was full and the package
+     * had to stay in the buffer (sender blocked)
+     */
+    std::size_t get_blocked_rounds() const;
 
   protected:
     /**
-     * @brief Inserts package (all of its content due to r-reference &&) to the
-     * output buffer
+     * @brief Sends package from buffer to the choosen receiver
+     * If buffer is empty, it does nothig
+     * @arg table holds the package in the buffer
+     * @return the receiver that took the package, nullptr if none did
+     */
+    IPackageReceiver *send_package(PackageTable &table);
+
+    /**
+     * @brief Package in the buffer, nullptr if none
+     */
+    const Package *get_sending_buffer(const PackageTable &table) const {
+        return buffer_ ? &table.get(buffer_) : nullptr;
+    }
+
+    /**
+     * @brief Moves the package in the buffer from one table to another
+     */
+    void move_buffer(PackageTable &from, PackageTable &to);
+
+    /**
+     * @brief Puts a package of the node's table to the output buffer
      */
-    void push_package(Package &&package);
+    void push_package(PackageHandle handle);
 
-    std::optional<Package> buffer_; // Output buffer
+    PackageHandle buffer_; // Output buffer, empty handle - no package
+    std::size_t blocked_rounds_ = 0;
     ReceiverPreferences
         receiver_preferences_; // ReceriverPreferences instance, containing
                                // preferences map for every object that derives
@@ -135,6 +254,27 @@ class IPackageReceiver {
      */
     virtual void receive_package(Package &&p) = 0;
 
+    /**
+     * @brief Receives a package of the sender's table (senders call it)
+     * Nodes sharing the table keep the handle; by default the package
+     * leaves the table and goes to receive_package
+     */
+    virtual void receive_handle(PackageTable &table, PackageHandle handle) {
+        receive_package(table.take(handle));
+    }
+
+    /**
+     * @brief Tells if the receiver accepts a package now
+     * A full receiver refuses it, the package stays with the sender
+     */
+    virtual bool can_receive() const { return true; }
+
+    /**
+     * @brief Packages the receiver still has to deal with (for routing
+     * policies), a storehouse takes everything at once
+     */
+    virtual std::size_t get_load() const { return 0; }
+
     /**
      * @brief Gets ID of a Node
      */
@@ -170,16 +310,62 @@ class Ramp : public PackageSender {
      * TimeOffset represents time between product deliveries
      */
     explicit Ramp(ElementID id, TimeOffset di);
+
+    /**
+     * @brief Moving constructor with the Factory allocator
+     */
+    Ramp(Ramp &&other, const allocator_type &alloc);
     // explicit for clarity, but it's not necessary with multi-argument
     // constructors, complilator will not convert types anyways
 
+    Ramp(Ramp &&other);
+
+    /**
+     * @brief Releases the package left in the buffer
+     */
+    ~Ramp();
+
+    /**
+     * @brief Sends the delivered package to the choosen receiver
+     * @return the receiver that took the package, nullptr if none did
+     */
+    IPackageReceiver *send_package() {
+        return PackageSender::send_package(*packages_);
+    }
+
+    /**
+     * @brief Read-only access to the output buffer (for reports and metrics)
+     * @return the package waiting to be sent, nullptr if none
+     */
+    const Package *get_sending_buffer() const {
+        return PackageSender::get_sending_buffer(*packages_);
+    }
+
+    /**
+     * @brief Table holding the delivered package
+     */
+    PackageTable &get_package_table() const { return *packages_; }
+
+    /**
+     * @brief Moves the package in the buffer to another table
+     * Factory::add_ramp does it, so all nodes of a Factory share its table
+     */
+    void set_package_table(PackageTable &table);
+
     /**
      * @brief Method for delivering goods with a set frequency
      * This method is called in every round of the simulation
+     * No delivery while the previous package is still blocked in the buffer
      * @arg is a current time of the simulation
      */
     void deliver_goods(Time t);
 
+    /**
+     * @brief Tells if round t is a delivery round (every delivery_interval_
+     * rounds, starting from round 1)
+     */
+    bool is_delivery_round(Time t) const;
+
     /**
      * @brief Gets Ramp ID
      */
@@ -193,6 +379,32 @@ class Ramp : public PackageSender {
   private:
     ElementID id_;
     TimeOffset delivery_interval_;
+    PackageTable *packages_ = &default_package_table();
+};
+
+class Worker;
+
+/**
+ * @brief Custom work of a station (setup times, maintenance, batches)
+ * replacing the fixed-duration step of Worker::do_work. Belongs to one
+ * worker; coroutine behaviours (C++20) are in worker_coroutines.hpp
+ */
+class IWorkerBehaviour {
+  public:
+    virtual ~IWorkerBehaviour() = default;
+
+    /**
+     * @brief Work phase of round t, called by worker.do_work(t)
+     * Uses the worker's start_processing and finish_processing
+     */
+    virtual void do_work(Worker &worker, Time t) = 0;
+
+    /**
+     * @brief Round from which do_work must be called again even without a
+     * new package, 0 - only once a package arrives (read by active stepping
+     * after do_work)
+     */
+    virtual Time get_wake_round() const = 0;
 };
 
 /**
@@ -207,23 +419,114 @@ class Worker : public PackageSender, public IPackageReceiver {
     explicit Worker(ElementID id, TimeOffset pd,
                     std::unique_ptr<IPackageQueue> q);
 
+    /**
+     * @brief Moving constructor with the Factory allocator
+     * The queue keeps its own memory (pass Factory::get_memory_resource()
+     * when creating a PackageQueue to put it in the Factory memory too)
+     */
+    Worker(Worker &&other, const allocator_type &alloc);
+
+    /**
+     * @brief Releases the package in hand
+     */
+    ~Worker();
+
+    /**
+     * @brief Table of the input queue, the buffers hold packages of the
+     * same table
+     */
+    PackageTable &get_package_table() const { return q_->get_package_table(); }
+
+    /**
+     * @brief Moves the packages of the worker (buffers and queue) to
+     * another table
+     */
+    void set_package_table(PackageTable &table);
+
+    // AS A SENDER
+
+    /**
+     * @brief Sends the finished product to the choosen receiver
+     * @return the receiver that took the package, nullptr if none did
+     */
+    IPackageReceiver *send_package() {
+        return PackageSender::send_package(get_package_table());
+    }
+
+    /**
+     * @brief Read-only access to the output buffer (for reports and metrics)
+     * @return the package waiting to be sent, nullptr if none
+     */
+    const Package *get_sending_buffer() const {
+        return buffer_ ? PackageSender::get_sending_buffer(get_package_table())
+                       : nullptr;
+    }
+
     // AS A RECEIVER
 
     void receive_package(Package &&p) override;
 
+    void receive_handle(PackageTable &table, PackageHandle handle) override;
+
+    /**
+     * @brief False when the queue is full (capacity reached)
+     */
+    bool can_receive() const override;
+
+    /**
+     * @brief Queue size, plus one while a product is in hand
+     */
+    std::size_t get_load() const override;
+
     ReceiverType get_receiver_type() const override;
 
     // AS A WORKER
 
+    /**
+     * @brief Limits the input queue, 0 means unbounded (default)
+     * Senders keep refused packages, so the memory of a run stays bounded
+     */
+    void set_queue_capacity(std::size_t capacity);
+
+    std::size_t get_queue_capacity() const;
+
+    /**
+     * @brief Moves the input queue to newly allocated memory
+     * (IPackageQueue::relocate), so it lies near recently moved nodes
+     */
+    void relocate_queue();
+
     /**
      * @brief Method for doing work by the Worker
      * This method is called in every round of the simulation (in
      * "processing" phase)
      * @arg t represents current time of the simulation, for the worker to
      * know when to finish processing current product
+     * A finished product waits in hand while the output buffer is blocked
+     * With a behaviour set, the behaviour does the work instead
      */
     void do_work(Time t);
 
+    /**
+     * @brief Replaces the fixed-duration step of do_work, nullptr restores
+     * it. The processing duration is then only what the behaviour makes of it
+     */
+    void set_behaviour(std::unique_ptr<IWorkerBehaviour> behaviour);
+
+    IWorkerBehaviour *get_behaviour() const;
+
+    /**
+     * @brief Takes the next package from the queue into hand in round t
+     * False (nothing done) while a package is in hand or the queue is empty
+     */
+    bool start_processing(Time t);
+
+    /**
+     * @brief Moves the package in hand to the output buffer in round t
+     * False (nothing done) with nothing in hand or the buffer still blocked
+     */
+    bool finish_processing(Time t);
+
     // GETTERS
 
     /**
@@ -241,6 +544,24 @@ class Worker : public PackageSender, public IPackageReceiver {
      */
     Time get_product_processing_start_time() const;
 
+    /**
+     * @brief Gets the round the last product left the hand (0 - none yet)
+     */
+    Time get_product_processing_finish_time() const;
+
+    /**
+     * @brief Gets the input queue, read-only (for reports and metrics)
+     */
+    const IPackageQueue *get_queue() const;
+
+    /**
+     * @brief Gets the product being currently processed, nullptr if none
+     */
+    const Package *get_processing_buffer() const {
+        return processing_buffer_ ? &get_package_table().get(processing_buffer_)
+                                  : nullptr;
+    }
+
     // ITERATORS
     const_iterator begin() const override;
     const_iterator end() const override;
@@ -251,10 +572,12 @@ class Worker : public PackageSender, public IPackageReceiver {
     ElementID id_;
     TimeOffset processing_duration_;
     Time package_processing_start_time_ = 0;
+    Time package_processing_finish_time_ = 0;
+    std::size_t queue_capacity_ = 0; // 0 - unbounded
 
     std::unique_ptr<IPackageQueue> q_; // Input queue
-    std::optional<Package>
-        processing_buffer_; // Product being current processed
+    PackageHandle processing_buffer_; // Product being current processed
+    std::unique_ptr<IWorkerBehaviour> behaviour_; // nullptr - fixed duration
 };
 
 /**
@@ -275,10 +598,22 @@ class Storehouse : public IPackageReceiver {
 
     void receive_package(Package &&p) override;
 
+    void receive_handle(PackageTable &table, PackageHandle handle) override;
+
+    /**
+     * @brief Moves the stock to another table
+     */
+    void set_package_table(PackageTable &table);
+
     ReceiverType get_receiver_type() const override;
 
     ElementID get_id() const override;
 
+    /**
+     * @brief Gets the stockpile, read-only (for reports and metrics)
+     */
+    const IPackageStockpile *get_stockpile() const;
+
     // Iterators implementation
     const_iterator begin() const override;
     const_iterator end() const override;
@@ -2,7 +2,9 @@
 
 #pragma once // modern, easy, clean way
 
+#include "memory_accounting.hpp"
 #include "types.hpp"
+#include <memory_resource>
 #include <set>
 
 namespace NetSim {
@@ -57,14 +59,19 @@ public:
    */
   ~Package();
 
+  /**
+   * @brief Memory of the ID sets below (shared by all Factories)
+   */
+  static const MemoryUsage &get_id_memory_usage();
+
 private:
   ElementID id_;
 
   // ID Poll
-  static std::set<ElementID>
+  static std::pmr::set<ElementID>
       assigned_ids_; // 'static' shares this one place in memory between all
                      // instances of this object
-  static std::set<ElementID> freed_ids_;
+  static std::pmr::set<ElementID> freed_ids_;
 };
 
 } // namespace NetSim
@@ -0,0 +1,265 @@
+// Compact package representation: handles into a table of packages
+
+#pragma once
+
+#include "package.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <queue>
+#include <type_traits>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Enumeration type defining a quque type
+ */
+enum class PackageQueueType { FIFO, LIFO };
+
+/**
+ * @brief Package as an index into a PackageTable (8 bytes)
+ * Trivially copyable - moving it through queues and buffers is a plain
+ * copy, no ID bookkeeping. The generation tells a stale handle (package
+ * already released, slot reused) from a live one; generations start at 1,
+ * so the empty handle PackageHandle{} stands for no package (a buffer
+ * needs no std::optional flag)
+ */
+struct PackageHandle {
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0;
+
+    explicit operator bool() const { return generation != 0; }
+};
+
+static_assert(std::is_trivially_copyable<PackageHandle>::value,
+              "PackageHandle must stay trivially copyable.");
+
+class IPackageReceiver;
+
+/**
+ * @brief Told when a receiver holding packages of a table (a Worker)
+ * receives one - from a sender or from outside, e.g. receive_package
+ * called by the user. The Factory wakes the worker under active stepping
+ */
+class IReceiveListener {
+  public:
+    virtual ~IReceiveListener() = default;
+
+    virtual void on_receive(const IPackageReceiver *receiver) = 0;
+};
+
+/**
+ * @brief Owns the packages of one simulation, nodes pass handles to them
+ * Two uses:
+ * - create() numbers packages itself, handing out IDs like Package does
+ *   (lowest freed ID first, otherwise the next one) - StaticFactory
+ * - create(Package) keeps the Package in its slot - Factory; the Package
+ *   is constructed once (its ID taken) and moved in, so queues and buffers
+ *   copy handles and never touch the ID sets of Package
+ * Not synchronized, like the Factory pool
+ */
+class PackageTable {
+  public:
+    /**
+     * @param resource memory of the slots, e.g. Factory::get_memory_resource()
+     */
+    explicit PackageTable(
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    // Handles refer to the slots - a table cannot be copied
+    PackageTable(const PackageTable &) = delete;
+    PackageTable &operator=(const PackageTable &) = delete;
+
+    /**
+     * @brief New package numbered by the table (delivery on a ramp)
+     */
+    PackageHandle create();
+
+    /**
+     * @brief Takes a package into the table (delivery, or a package coming
+     * from outside)
+     */
+    PackageHandle create(Package &&package);
+
+    /**
+     * @brief Package leaves the simulation, its slot (and the ID of a
+     * numbered one) can be reused; a kept Package is destroyed
+     * Throws std::logic_error for a stale handle
+     */
+    void release(PackageHandle handle);
+
+    /**
+     * @brief Moves a kept Package out of the table and releases its slot
+     * Throws std::logic_error for a stale handle
+     */
+    Package take(PackageHandle handle);
+
+    /**
+     * @brief Package kept by create(Package), the reference is valid until
+     * the next create
+     */
+    const Package &get(PackageHandle handle) const {
+        return *slots_[handle.index].package;
+    }
+
+    bool is_live(PackageHandle handle) const;
+
+    /**
+     * @brief ID of a package numbered by the table (create())
+     */
+    ElementID get_id(PackageHandle handle) const {
+        return static_cast<ElementID>(handle.index) + 1;
+    }
+
+    /**
+     * @brief Number of packages created before this one (never reused,
+     * unlike the ID)
+     */
+    std::uint64_t get_serial(PackageHandle handle) const {
+        return slots_[handle.index].serial;
+    }
+
+    /**
+     * @brief Packages created and not released yet
+     */
+    std::size_t size() const { return live_; }
+
+    /**
+     * @brief Listener of the receives by nodes of the table, nullptr
+     * (default) - nobody is told
+     */
+    void set_receive_listener(IReceiveListener *listener) {
+        listener_ = listener;
+    }
+
+    IReceiveListener *get_receive_listener() const { return listener_; }
+
+  private:
+    struct Slot {
+        std::uint32_t generation = 1; // 0 - the empty handle
+        bool live = false;
+        std::uint64_t serial = 0;
+        std::optional<Package> package; // create(Package) only
+    };
+
+    std::uint32_t allocate_slot();
+
+    std::pmr::vector<Slot> slots_; // slot index = ID - 1 (create())
+    std::priority_queue<std::uint32_t, std::pmr::vector<std::uint32_t>,
+                        std::greater<std::uint32_t>>
+        free_slots_; // lowest first
+    std::size_t live_ = 0;
+    std::uint64_t created_ = 0;
+    IReceiveListener *listener_ = nullptr;
+};
+
+/**
+ * @brief Adds a package number to an order-dependent digest of the packages
+ * a storehouse received (engines keeping only stock counts use it for
+ * differential checks)
+ */
+inline std::uint64_t fold_package_number(std::uint64_t digest,
+                                         std::uint64_t number) {
+    return (digest ^ number) * 0x100000001B3ULL; // FNV prime
+}
+
+/**
+ * @brief Table of the packages outside any Factory (nodes and queues not
+ * added to one yet), like std::pmr::get_default_resource()
+ */
+PackageTable &default_package_table();
+
+/**
+ * @brief FIFO/LIFO queue of package handles in one ring buffer
+ * Grows and moves packages between queues with memcpy
+ */
+class PackageHandleQueue {
+  public:
+    PackageHandleQueue() = default; // FIFO
+    explicit PackageHandleQueue(
+        PackageQueueType type,
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : queue_type_(type), buffer_(resource) {}
+
+    void push(PackageHandle handle) {
+        if (size_ == buffer_.size()) {
+            grow(size_ + 1);
+        }
+        buffer_[(head_ + size_) & mask_] = handle;
+        ++size_;
+    }
+
+    /**
+     * @brief Takes a package according to the queue type
+     */
+    PackageHandle pop() {
+        return queue_type_ == PackageQueueType::FIFO ? pop_front() : pop_back();
+    }
+
+    PackageHandle pop_front() {
+        PackageHandle handle = buffer_[head_];
+        head_ = (head_ + 1) & mask_;
+        --size_;
+        return handle;
+    }
+
+    PackageHandle pop_back() {
+        --size_;
+        return buffer_[(head_ + size_) & mask_];
+    }
+
+    /**
+     * @brief Appends all packages of other (in its order), other is emptied
+     * Taking from itself changes nothing
+     */
+    void take_all(PackageHandleQueue &other);
+
+    /**
+     * @brief i-th package from the front
+     */
+    PackageHandle operator[](std::size_t i) const {
+        return buffer_[(head_ + i) & mask_];
+    }
+
+    bool empty() const { return size_ == 0; }
+    std::size_t size() const { return size_; }
+    PackageQueueType get_queue_type() const { return queue_type_; }
+
+    /**
+     * @brief Forgets all handles (the packages are not released)
+     */
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    std::pmr::memory_resource *get_memory_resource() const {
+        return buffer_.get_allocator().resource();
+    }
+
+  private:
+    /**
+     * @brief Reallocates to a power of two >= min_capacity, unwrapping the
+     * ring so the packages start at index 0
+     */
+    void grow(std::size_t min_capacity);
+
+    /**
+     * @brief Copies n handles behind the last one (may wrap around)
+     */
+    void copy_in(const PackageHandle *handles, std::size_t n);
+
+    PackageQueueType queue_type_ = PackageQueueType::FIFO;
+    std::pmr::vector<PackageHandle> buffer_;
+    std::size_t mask_ = 0; // capacity - 1
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+};
+
+} // namespace NetSim
@@ -0,0 +1,51 @@
+// Multi-process partitioned simulation with conservative synchronization
+
+#pragma once
+
+#include "factory.hpp"
+#include "node_counts.hpp"
+#include "routing_streams.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+namespace NetSim {
+
+/**
+ * @brief Assignment of nodes to partitions (processes)
+ */
+struct PartitionPlan {
+    int n_partitions = 1;
+    std::map<ElementID, int> ramps;
+    std::map<ElementID, int> workers;
+    std::map<ElementID, int> storehouses;
+};
+
+/**
+ * @brief Splits the Net into n_partitions contiguous parts of similar size
+ * Nodes are taken in BFS order from the ramps, so most links stay inside
+ * a partition
+ */
+PartitionPlan make_partition_plan(const Factory &f, int n_partitions);
+
+/**
+ * @brief Runs d rounds with the Net split across several local processes
+ * Every child process (fork) owns the nodes of one partition. Senders keep
+ * their ReceiverPreferences, remote receivers are replaced by proxies that
+ * forward packages over local sockets. Rounds are synchronized with a
+ * one-round window: after the passing phase every partition sends each
+ * peer the packages for it - an empty (null) message if there are none -
+ * and waits for all peers before its workers process the round
+ * Routing uses seed_routing_streams(f, seed); the probability generators
+ * of f are restored afterwards
+ * Throws std::logic_error for an inconsistent Net, bounded worker queues
+ * (remote receivers can't refuse packages) or routing policies,
+ * std::runtime_error when a child process fails
+ */
+NodeCounts simulate_partitioned(Factory &f, TimeOffset d,
+                                const PartitionPlan &plan,
+                                std::uint64_t seed);
+
+} // namespace NetSim
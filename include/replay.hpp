@@ -0,0 +1,113 @@
+// Record and replay of routing decisions and ramp deliveries
+
+#pragma once
+
+#include "nodes.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace NetSim {
+
+/**
+ * @brief Extension point replacing the random parts of the simulation
+ * When routing_hook is set, senders ask it for a receiver instead of
+ * calling ReceiverPreferences::choose_receiver and ramps ask it whether to
+ * deliver in the current round
+ */
+class IRoutingHook {
+  public:
+    virtual ~IRoutingHook() = default;
+
+    /**
+     * @brief Picks the receiver for the package being sent
+     */
+    virtual IPackageReceiver *choose_receiver(ReceiverPreferences &prefs) = 0;
+
+    /**
+     * @brief Decides if the ramp delivers a package in round t
+     */
+    virtual bool should_deliver(const Ramp &ramp, Time t) = 0;
+};
+
+/**
+ * @brief Active routing hook, nullptr (default) - normal simulation
+ */
+extern IRoutingHook *routing_hook;
+
+/**
+ * @brief Records every routing decision and delivery into a binary log
+ * Events are stored as varints in the order they happen: receivers by
+ * type and ID (so the log doesn't depend on memory addresses), deliveries
+ * as 0/1
+ */
+class RoutingRecorder : public IRoutingHook {
+  public:
+    explicit RoutingRecorder(const std::string &path);
+
+    /**
+     * @brief Writes the log (if not closed before)
+     */
+    ~RoutingRecorder() override;
+
+    IPackageReceiver *choose_receiver(ReceiverPreferences &prefs) override;
+    bool should_deliver(const Ramp &ramp, Time t) override;
+
+    /**
+     * @brief Writes the log and detaches the recorder from routing_hook
+     */
+    void close();
+
+    std::size_t get_event_count() const { return events_; }
+
+  private:
+    void flush();
+
+    std::string path_;
+    std::string buffer_;
+    std::size_t events_ = 0;
+    bool closed_ = false;
+    bool truncate_ = true; // first write creates the file
+};
+
+/**
+ * @brief Drives the simulation from a log written by RoutingRecorder
+ * Neither the probability generator nor the delivery schedule is used.
+ * A decision is one hash lookup: every sender's receivers are indexed by
+ * code once, again only when they change (get_revision)
+ * Throws std::runtime_error when the log doesn't match the Net
+ */
+class RoutingReplayer : public IRoutingHook {
+  public:
+    explicit RoutingReplayer(const std::string &path);
+
+    ~RoutingReplayer() override;
+
+    IPackageReceiver *choose_receiver(ReceiverPreferences &prefs) override;
+    bool should_deliver(const Ramp &ramp, Time t) override;
+
+    /**
+     * @brief True when every recorded event has been replayed
+     */
+    bool finished() const { return pos_ == log_.size(); }
+
+  private:
+    std::uint64_t next_event();
+
+    /**
+     * @brief Receivers of one sender by code
+     */
+    struct ReceiverLookup {
+        std::size_t revision = 0;
+        std::unordered_map<std::uint64_t, IPackageReceiver *> receivers;
+    };
+
+    std::string log_;
+    std::size_t pos_ = 0;
+    std::unordered_map<const ReceiverPreferences *, ReceiverLookup> lookups_;
+};
+
+} // namespace NetSim
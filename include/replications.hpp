@@ -0,0 +1,82 @@
+// Replications comparing two configurations of a Net, with common random
+// numbers and antithetic runs as variance reduction
+
+#pragma once
+
+#include "factory.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Builds one configuration into an empty Factory
+ */
+using FactoryBuilder = std::function<void(Factory &)>;
+
+/**
+ * @brief Output measured at the end of a replication (higher or lower is
+ * up to the caller)
+ */
+using ReplicationMetric = std::function<double(const Factory &)>;
+
+/**
+ * @brief Packages in all storehouses - default metric
+ */
+double delivered_packages(const Factory &f);
+
+/**
+ * @brief How the replications are run
+ * Routing is the only randomness of a Net: every sender draws from its own
+ * stream (seed_routing_streams), one number per routed package
+ */
+struct ReplicationOptions {
+    std::size_t n_replications = 30; // runs of each configuration
+    TimeOffset rounds = 100;
+    std::uint64_t base_seed = 1;
+    bool common_random_numbers = true; // both configurations get one seed
+    bool antithetic = false; // runs 2k and 2k + 1 share a seed, the second
+                             // uses 1 - u (n_replications must be even)
+};
+
+/**
+ * @brief Comparison of configuration A and B, difference is A - B
+ * Independent variance is what the mean difference would have with
+ * independent streams: (var(A) + var(B)) / n, from the same runs (common
+ * numbers and antithetic pairs don't change a single run's distribution).
+ * Variance reduction is independent / achieved, so n * variance_reduction
+ * independent replications would be needed for the same interval
+ */
+struct ComparisonReport {
+    std::size_t n_replications = 0;
+    std::vector<double> metrics_a;
+    std::vector<double> metrics_b;
+    double mean_a = 0.0;
+    double mean_b = 0.0;
+    double mean_difference = 0.0;
+    double achieved_variance = 0.0;    // of mean_difference
+    double independent_variance = 0.0; // of mean_difference
+    double half_width = 0.0;           // 95% interval (normal approximation)
+    double variance_reduction = 1.0;
+    double equivalent_replications = 0.0;
+};
+
+/**
+ * @brief Runs both configurations n_replications times and compares them
+ * Throws std::logic_error for fewer than 2 independent units (replications,
+ * or antithetic pairs) or an odd count with antithetic runs
+ */
+ComparisonReport compare_configurations(const FactoryBuilder &build_a,
+                                        const FactoryBuilder &build_b,
+                                        const ReplicationOptions &options,
+                                        const ReplicationMetric &metric =
+                                            delivered_packages);
+
+void print_comparison_report(std::ostream &os, const ComparisonReport &report);
+
+} // namespace NetSim
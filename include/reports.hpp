@@ -0,0 +1,164 @@
+// Reports: Net structure and simulation state
+
+#pragma once
+
+#include "factory.hpp"
+#include "memory_accounting.hpp"
+#include "types.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Writes the Net structure (ramps, workers, storehouses and links)
+ */
+void generate_structure_report(const Factory &f, std::ostream &os);
+
+/**
+ * @brief Writes the simulation state after round t
+ * Same output as the asynchronous writer, formatted on the calling thread
+ */
+void generate_simulation_turn_report(const Factory &f, std::ostream &os,
+                                     Time t);
+
+/**
+ * @brief Writes the memory of every category (e.g. the end-of-run
+ * SimulationSummary::memory or Factory::get_memory_report())
+ */
+void generate_memory_report(const MemoryReport &report, std::ostream &os);
+
+/**
+ * @brief Report every n-th round (1, n + 1, 2n + 1, ...)
+ */
+class IntervalReportNotifier {
+  public:
+    explicit IntervalReportNotifier(TimeOffset to) : to_(to) {}
+
+    bool should_generate_report(Time t) const { return (t - 1) % to_ == 0; }
+
+  private:
+    TimeOffset to_;
+};
+
+/**
+ * @brief Report in chosen rounds only
+ */
+class SpecificTurnsReportNotifier {
+  public:
+    explicit SpecificTurnsReportNotifier(std::set<Time> turns)
+        : turns_(std::move(turns)) {}
+
+    bool should_generate_report(Time t) const { return turns_.count(t) > 0; }
+
+  private:
+    std::set<Time> turns_;
+};
+
+/**
+ * @brief Copy of the simulation state after one round
+ * All package IDs are kept in one flat vector, nodes only store offsets,
+ * so a reused snapshot does not allocate once it has grown
+ */
+struct TurnSnapshot {
+    static constexpr ElementID NO_PACKAGE = -1;
+
+    struct RampState {
+        ElementID id;
+        ElementID sending_package; // NO_PACKAGE if output buffer empty
+    };
+
+    struct WorkerState {
+        ElementID id;
+        ElementID processed_package; // NO_PACKAGE if idle
+        Time processing_time;        // rounds spent on processed_package
+        ElementID sending_package;   // NO_PACKAGE if output buffer empty
+        std::size_t queue_begin;     // range in package_ids
+        std::size_t queue_end;
+    };
+
+    struct StorehouseState {
+        ElementID id;
+        std::size_t stock_begin; // range in package_ids
+        std::size_t stock_end;
+    };
+
+    Time t = 0;
+    std::vector<RampState> ramps; // not in the turn report
+    std::vector<WorkerState> workers;
+    std::vector<StorehouseState> storehouses;
+    std::vector<ElementID> package_ids;
+};
+
+/**
+ * @brief Fills the snapshot with the state of the Net after round t
+ * @param with_stock false - storehouse ranges are left empty (the stock only
+ * grows, copying it every time would cost the whole history)
+ */
+void take_snapshot(const Factory &f, Time t, TurnSnapshot &snapshot,
+                   bool with_stock = true);
+
+/**
+ * @brief Appends the turn report of the snapshot to out
+ */
+void format_turn_report(const TurnSnapshot &snapshot, std::string &out);
+
+/**
+ * @brief Writes turn reports on a background thread
+ * The simulation thread only copies the state into a recycled snapshot and
+ * hands it over through a bounded queue; formatting (std::to_chars) and
+ * large buffered writes happen on the writer thread. When the queue is full
+ * publish() waits, so memory is bounded by queue_capacity snapshots
+ */
+class AsyncReportWriter {
+  public:
+    explicit AsyncReportWriter(std::ostream &os,
+                               std::size_t queue_capacity = 8,
+                               std::size_t write_buffer_size = 1 << 20);
+
+    AsyncReportWriter(const AsyncReportWriter &) = delete;
+    AsyncReportWriter &operator=(const AsyncReportWriter &) = delete;
+
+    /**
+     * @brief Flushes remaining reports and stops the writer thread
+     */
+    ~AsyncReportWriter();
+
+    /**
+     * @brief Takes a snapshot of the Net after round t and queues it
+     */
+    void publish(const Factory &f, Time t);
+
+    /**
+     * @brief Waits until every published report is written
+     */
+    void close();
+
+  private:
+    void writer_loop();
+
+    std::ostream &os_;
+    std::size_t write_buffer_size_;
+
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<std::unique_ptr<TurnSnapshot>> pending_; // waiting for writer
+    std::vector<std::unique_ptr<TurnSnapshot>> free_; // recycled snapshots
+    std::size_t capacity_;
+    bool stop_ = false;
+    bool closed_ = false;
+
+    std::thread writer_;
+};
+
+} // namespace NetSim
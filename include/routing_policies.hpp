@@ -0,0 +1,66 @@
+// Routing policies looking at the receivers' current load
+
+#pragma once
+
+#include "factory.hpp"
+#include "nodes.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Base of the policies below: keeps the receivers of its sender in
+ * an array (ReceiverPreferences order) for O(1) access by index
+ * The array is rebuilt only when the receivers change (revision) or the
+ * preferences object is a different one (node moved)
+ */
+class IndexedRoutingPolicy : public IRoutingPolicy {
+  protected:
+    const std::vector<IPackageReceiver *> &
+    get_receivers(const ReceiverPreferences &prefs);
+
+  private:
+    const ReceiverPreferences *cached_for_ = nullptr;
+    std::size_t revision_ = 0;
+    std::vector<IPackageReceiver *> receivers_;
+};
+
+/**
+ * @brief Receivers in turn, O(1) per decision
+ */
+class RoundRobinPolicy : public IndexedRoutingPolicy {
+  public:
+    IPackageReceiver *choose(const ReceiverPreferences &prefs,
+                             ProbabilityGenerator &pg) override;
+
+  private:
+    std::size_t next_ = 0;
+};
+
+/**
+ * @brief Samples d receivers (with replacement) and takes the one with the
+ * smallest load, O(d) per decision, first sampled wins a tie
+ * Bounded stand-in for join-shortest-queue, which would have to scan (or
+ * be told about every load change of) all receivers of the sender
+ */
+class PowerOfDPolicy : public IndexedRoutingPolicy {
+  public:
+    explicit PowerOfDPolicy(std::size_t d = 2);
+
+    IPackageReceiver *choose(const ReceiverPreferences &prefs,
+                             ProbabilityGenerator &pg) override;
+
+  private:
+    std::size_t d_;
+};
+
+/**
+ * @brief True if any sender of the Net has a routing policy
+ * (engines without receiver state - sweep, partitions, images - refuse it)
+ */
+bool uses_routing_policies(const Factory &f);
+
+} // namespace NetSim
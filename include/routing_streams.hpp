@@ -0,0 +1,27 @@
+// Per-sender random streams for reproducible routing
+
+#pragma once
+
+#include "factory.hpp"
+#include "types.hpp"
+
+#include <cstdint>
+
+namespace NetSim {
+
+/**
+ * @brief Gives every sender its own random stream derived from the seed
+ * Routing then doesn't depend on the order senders are simulated in, which
+ * lets a partitioned run reproduce the single-process one. The n-th
+ * package a sender routes always uses the n-th number of its stream, so
+ * two Nets seeded alike share random numbers node by node
+ */
+void seed_routing_streams(Factory &f, std::uint64_t seed,
+                          bool antithetic = false);
+
+/**
+ * @brief Stream number of a sender used by seed_routing_streams
+ */
+std::uint64_t routing_stream_id(NodeType type, ElementID id);
+
+} // namespace NetSim
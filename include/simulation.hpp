@@ -0,0 +1,126 @@
+#pragma once
+
+#include "factory.hpp"
+#include "memory_accounting.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Settings of the steady-state detection (early termination)
+ * Metrics are averaged in batches of batch_length rounds (batch means), the
+ * warm-up is cut off with MSER and the run stops once every metric's
+ * confidence interval is narrow enough. Once max_batches are stored,
+ * neighbouring batches are merged and the batch length doubles, so the
+ * history and the cost of an evaluation stay bounded
+ */
+struct SteadyStateOptions {
+    bool enabled = false;         // false - always run the full horizon
+    Time batch_length = 100;      // rounds per batch (at the start)
+    std::size_t min_batches = 20; // batches required after the warm-up
+    std::size_t max_batches = 256; // even, at least 2 * min_batches
+    double relative_half_width = 0.05; // target half-width / |mean|
+    double absolute_half_width = 0.05; // target for metrics with mean ~ 0
+    double z = 1.96;                   // ~95% confidence
+};
+
+/**
+ * @brief Outcome of a simulation run
+ */
+struct SimulationSummary {
+    Time horizon = 0;              // rounds requested
+    Time rounds_run = 0;           // rounds actually simulated
+    bool steady_state_reached = false;
+    Time warmup_length = 0;        // detected warm-up (in rounds)
+    Time rounds_saved = 0;         // horizon - rounds_run
+    MemoryReport memory;           // at the end of the run
+};
+
+/**
+ * @brief Tracks rolling statistics of the Net and decides if it has settled
+ * Tracked metrics: queue length of every Worker and throughput (packages
+ * received per round) of every Storehouse
+ */
+class SteadyStateDetector {
+  public:
+    /**
+     * @brief Throws std::invalid_argument for a non-positive batch length or
+     * an odd max_batches below 2 * min_batches
+     */
+    explicit SteadyStateDetector(const SteadyStateOptions &options);
+
+    /**
+     * @brief Collects metrics after round t, evaluates at the end of a batch
+     */
+    void observe(const Factory &f, Time t);
+
+    /**
+     * @brief True when all metrics are within the configured width
+     */
+    bool is_steady() const { return steady_; }
+
+    /**
+     * @brief Longest warm-up detected among the metrics (in rounds)
+     */
+    Time get_warmup_length() const { return warmup_length_; }
+
+    /**
+     * @brief Rounds per batch now (doubles with every merge)
+     */
+    Time get_batch_length() const { return batch_length_; }
+
+  private:
+    /**
+     * @brief One tracked metric, stored as batch means
+     */
+    struct Series {
+        double batch_sum = 0.0;
+        std::vector<double> batch_means;
+    };
+
+    /**
+     * @brief MSER truncation point (in batches) of the given series
+     */
+    static std::size_t mser_truncation(const std::vector<double> &means);
+
+    /**
+     * @brief Checks the batch-means confidence interval after truncation
+     */
+    bool is_series_settled(const Series &series, std::size_t truncation) const;
+
+    void evaluate();
+
+    /**
+     * @brief Merges neighbouring batch means, doubling the batch length
+     */
+    void merge_batches();
+
+    SteadyStateOptions options_;
+    Time batch_length_;        // current, options_.batch_length * 2^merges
+    std::size_t n_batches_ = 0; // stored per series
+    std::vector<Series> series_;
+    std::vector<std::size_t> last_storehouse_sizes_;
+    Time warmup_length_ = 0;
+    bool steady_ = false;
+};
+
+/**
+ * @brief Runs the simulation for d rounds
+ * Every round: deliveries, package passing, work and the report function
+ * Throws std::logic_error if the Net is not consistent
+ */
+void simulate(Factory &f, TimeOffset d,
+              std::function<void(Factory &, Time)> rf);
+
+/**
+ * @brief Runs the simulation with optional steady-state early termination
+ */
+SimulationSummary simulate(Factory &f, TimeOffset d,
+                           std::function<void(Factory &, Time)> rf,
+                           const SteadyStateOptions &options);
+
+} // namespace NetSim
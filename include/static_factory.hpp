@@ -0,0 +1,471 @@
+// Factories with the topology fixed at compile time
+
+#pragma once
+
+#include "factory.hpp"
+#include "node_counts.hpp"
+#include "nodes.hpp"
+#include "package_table.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace NetSim {
+
+struct RampSpec {
+    ElementID id;
+    TimeOffset delivery_interval;
+};
+
+struct WorkerSpec {
+    ElementID id;
+    TimeOffset processing_duration;
+    PackageQueueType queue_type;
+};
+
+struct StorehouseSpec {
+    ElementID id;
+};
+
+struct LinkSpec {
+    NodeRef sender;   // ramp or worker
+    NodeRef receiver; // worker or storehouse
+};
+
+/**
+ * @brief Description of a whole Net, usable as a constexpr object
+ * e.g. static constexpr TopologySpec<1, 1, 1, 2> line{
+ *          {RampSpec{1, 1}}, {WorkerSpec{1, 2, PackageQueueType::FIFO}},
+ *          {StorehouseSpec{1}}, {LinkSpec{...}, LinkSpec{...}}};
+ */
+template <std::size_t N_RAMPS, std::size_t N_WORKERS,
+          std::size_t N_STOREHOUSES, std::size_t N_LINKS>
+struct TopologySpec {
+    static constexpr std::size_t n_ramps = N_RAMPS;
+    static constexpr std::size_t n_workers = N_WORKERS;
+    static constexpr std::size_t n_storehouses = N_STOREHOUSES;
+    static constexpr std::size_t n_links = N_LINKS;
+
+    std::array<RampSpec, N_RAMPS> ramps;
+    std::array<WorkerSpec, N_WORKERS> workers;
+    std::array<StorehouseSpec, N_STOREHOUSES> storehouses;
+    std::array<LinkSpec, N_LINKS> links;
+};
+
+namespace detail {
+// Compile-time helpers of StaticFactory
+// Senders are indexed ramps first, then workers; receivers workers first,
+// then storehouses
+
+constexpr std::size_t NONE = static_cast<std::size_t>(-1);
+
+template <typename NodeSpec, std::size_t N>
+constexpr std::size_t index_of(const std::array<NodeSpec, N> &nodes,
+                               ElementID id) {
+    for (std::size_t i = 0; i < N; ++i) {
+        if (nodes[i].id == id) {
+            return i;
+        }
+    }
+    return NONE;
+}
+
+template <const auto &Spec> constexpr std::size_t sender_index(NodeRef node) {
+    if (node.type == NodeType::RAMP) {
+        return index_of(Spec.ramps, node.id);
+    }
+    if (node.type == NodeType::WORKER) {
+        std::size_t w = index_of(Spec.workers, node.id);
+        return w == NONE ? NONE : Spec.n_ramps + w;
+    }
+    return NONE;
+}
+
+template <const auto &Spec>
+constexpr std::size_t receiver_index(NodeRef node) {
+    if (node.type == NodeType::WORKER) {
+        return index_of(Spec.workers, node.id);
+    }
+    if (node.type == NodeType::STOREHOUSE) {
+        std::size_t s = index_of(Spec.storehouses, node.id);
+        return s == NONE ? NONE : Spec.n_workers + s;
+    }
+    return NONE;
+}
+
+// Same order as ReceiverOrder - by type, then by ID
+template <const auto &Spec>
+constexpr bool receiver_before(std::size_t a, std::size_t b) {
+    constexpr std::size_t n_workers = Spec.n_workers;
+    bool a_worker = a < n_workers, b_worker = b < n_workers;
+    if (a_worker != b_worker) {
+        return a_worker;
+    }
+    ElementID a_id =
+        a_worker ? Spec.workers[a].id : Spec.storehouses[a - n_workers].id;
+    ElementID b_id =
+        b_worker ? Spec.workers[b].id : Spec.storehouses[b - n_workers].id;
+    return a_id < b_id;
+}
+
+template <typename NodeSpec, std::size_t N>
+constexpr bool unique_ids(const std::array<NodeSpec, N> &nodes) {
+    for (std::size_t i = 0; i < N; ++i) {
+        if (index_of(nodes, nodes[i].id) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <const auto &Spec> constexpr bool is_valid() {
+    if (!unique_ids(Spec.ramps) || !unique_ids(Spec.workers) ||
+        !unique_ids(Spec.storehouses)) {
+        return false;
+    }
+    for (const auto &ramp : Spec.ramps) {
+        if (ramp.delivery_interval <= 0) {
+            return false;
+        }
+    }
+    for (const auto &worker : Spec.workers) {
+        if (worker.processing_duration <= 0) {
+            return false;
+        }
+    }
+    for (const auto &link : Spec.links) {
+        if (sender_index<Spec>(link.sender) == NONE ||
+            receiver_index<Spec>(link.receiver) == NONE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Receivers of one sender with cumulative probabilities
+ * Summed in the same order as ReceiverPreferences::choose_receiver does,
+ * so the same drawn probability selects the same receiver
+ */
+template <std::size_t N_RECEIVERS> struct Route {
+    std::size_t n_receivers = 0;
+    std::array<std::size_t, N_RECEIVERS> receivers{};
+    std::array<double, N_RECEIVERS> thresholds{};
+};
+
+template <const auto &Spec> constexpr auto make_routes() {
+    constexpr std::size_t n_senders = Spec.n_ramps + Spec.n_workers;
+    constexpr std::size_t n_receivers = Spec.n_workers + Spec.n_storehouses;
+    std::array<Route<n_receivers>, n_senders> routes{};
+
+    for (const auto &link : Spec.links) {
+        std::size_t sender = sender_index<Spec>(link.sender);
+        std::size_t receiver = receiver_index<Spec>(link.receiver);
+        if (sender == NONE || receiver == NONE) {
+            continue; // reported by is_valid
+        }
+        auto &route = routes[sender];
+
+        bool duplicate = false; // map in ReceiverPreferences keeps one
+        for (std::size_t j = 0; j < route.n_receivers; ++j) {
+            duplicate = duplicate || route.receivers[j] == receiver;
+        }
+        if (duplicate) {
+            continue;
+        }
+        // Insertion sort step
+        std::size_t j = route.n_receivers++;
+        while (j > 0 &&
+               receiver_before<Spec>(receiver, route.receivers[j - 1])) {
+            route.receivers[j] = route.receivers[j - 1];
+            --j;
+        }
+        route.receivers[j] = receiver;
+    }
+    for (auto &route : routes) {
+        double distribution = 0.0;
+        for (std::size_t j = 0; j < route.n_receivers; ++j) {
+            distribution += 1.0 / route.n_receivers;
+            route.thresholds[j] = distribution;
+        }
+    }
+    return routes;
+}
+
+/**
+ * @brief Every sender fed by a ramp has receivers and reaches a storehouse
+ */
+template <const auto &Spec> constexpr bool is_consistent() {
+    constexpr std::size_t n_ramps = Spec.n_ramps;
+    constexpr std::size_t n_workers = Spec.n_workers;
+    constexpr std::size_t n_senders = n_ramps + n_workers;
+    constexpr auto routes = make_routes<Spec>();
+
+    std::array<bool, n_senders> fed{};    // reachable from a ramp
+    std::array<bool, n_senders> drains{}; // path to a storehouse
+    for (std::size_t r = 0; r < n_ramps; ++r) {
+        fed[r] = true;
+    }
+    for (std::size_t pass = 0; pass < n_senders; ++pass) {
+        for (std::size_t s = 0; s < n_senders; ++s) {
+            for (std::size_t j = 0; j < routes[s].n_receivers; ++j) {
+                std::size_t receiver = routes[s].receivers[j];
+                if (receiver >= n_workers) {
+                    drains[s] = true;
+                } else {
+                    drains[s] = drains[s] || drains[n_ramps + receiver];
+                    fed[n_ramps + receiver] = fed[n_ramps + receiver] || fed[s];
+                }
+            }
+        }
+    }
+    for (std::size_t s = 0; s < n_senders; ++s) {
+        if (fed[s] && !drains[s]) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace detail
+
+/**
+ * @brief Net generated by the compiler from a constexpr TopologySpec
+ * Same rounds as Factory::do_deliveries/do_package_passing/do_work, but
+ * nodes live in fixed-size arrays, every node's parameters are constants,
+ * routing tables (cumulative probabilities in ReceiverOrder) are computed
+ * at compile time and there are no virtual calls.
+ * Differences: packages are handles into the factory's own PackageTable
+ * (released when they reach a storehouse), storehouses only count
+ * packages (and keep a digest of them) and the global hooks
+ * (trace_sink, routing_hook) are not called.
+ * Invalid or inconsistent specs don't compile
+ */
+template <const auto &Spec> class StaticFactory {
+    using spec_t = std::decay_t<decltype(Spec)>;
+
+  public:
+    static constexpr std::size_t N_RAMPS = spec_t::n_ramps;
+    static constexpr std::size_t N_WORKERS = spec_t::n_workers;
+    static constexpr std::size_t N_STOREHOUSES = spec_t::n_storehouses;
+    static constexpr std::size_t N_SENDERS = N_RAMPS + N_WORKERS;
+    static constexpr std::size_t N_RECEIVERS = N_WORKERS + N_STOREHOUSES;
+
+    void do_deliveries(Time t) {
+        for_each_index(std::make_index_sequence<N_RAMPS>{}, [&](auto i) {
+            constexpr std::size_t r = decltype(i)::value;
+            constexpr TimeOffset di = Spec.ramps[r].delivery_interval;
+            if ((t - 1) % di == 0) {
+                buffers_[r] = {true, packages_.create()};
+            }
+        });
+    }
+
+    /**
+     * @brief Ramps then workers send their buffers
+     * @param pg any callable returning a probability, called once per
+     * sending node like ReceiverPreferences::choose_receiver does
+     */
+    template <typename Generator> void do_package_passing(Generator &pg) {
+        for_each_index(std::make_index_sequence<N_SENDERS>{}, [&](auto i) {
+            constexpr std::size_t s = decltype(i)::value;
+            if (!buffers_[s].full) {
+                return;
+            }
+            std::size_t receiver = choose_receiver<s>(pg);
+            if (receiver == NONE) {
+                return;
+            }
+            if (receiver < N_WORKERS) {
+                workers_[receiver].queue.push(buffers_[s].package);
+            } else {
+                std::size_t h = receiver - N_WORKERS;
+                stock_digest_[h] = fold_package_number(
+                    stock_digest_[h],
+                    packages_.get_serial(buffers_[s].package));
+                packages_.release(buffers_[s].package); // final delivery
+                ++stock_[h];
+            }
+            buffers_[s].full = false;
+        });
+    }
+
+    void do_work(Time t) {
+        for_each_index(std::make_index_sequence<N_WORKERS>{}, [&](auto i) {
+            constexpr std::size_t w = decltype(i)::value;
+            constexpr WorkerSpec spec = Spec.workers[w];
+            WorkerState &worker = workers_[w];
+
+            if (!worker.busy && !worker.queue.empty()) {
+                if constexpr (spec.queue_type == PackageQueueType::FIFO) {
+                    worker.package = worker.queue.pop_front();
+                } else {
+                    worker.package = worker.queue.pop_back();
+                }
+                worker.busy = true;
+                worker.start = t;
+            }
+            if (worker.busy && t - worker.start >= spec.processing_duration - 1) {
+                buffers_[N_RAMPS + w] = {true, worker.package};
+                worker.busy = false;
+            }
+        });
+    }
+
+    template <typename Generator> void do_round(Time t, Generator &pg) {
+        do_deliveries(t);
+        do_package_passing(pg);
+        do_work(t);
+    }
+
+    /**
+     * @brief Runs rounds 1..d (like simulate() without the report function)
+     */
+    template <typename Generator> void simulate(TimeOffset d, Generator &pg) {
+        for (Time t = 1; t <= d; ++t) {
+            do_round(t, pg);
+        }
+    }
+
+    /**
+     * @brief Node state in the same form as collect_node_counts(Factory)
+     */
+    NodeCounts collect_node_counts() const {
+        NodeCounts counts;
+        for (std::size_t w = 0; w < N_WORKERS; ++w) {
+            ElementID id = Spec.workers[w].id;
+            counts.worker_queues[id] = workers_[w].queue.size();
+            counts.worker_busy[id] = workers_[w].busy ? 1 : 0;
+            counts.worker_sending[id] = buffers_[N_RAMPS + w].full ? 1 : 0;
+        }
+        for (std::size_t s = 0; s < N_STOREHOUSES; ++s) {
+            counts.storehouse_stock[Spec.storehouses[s].id] = stock_[s];
+        }
+        return counts;
+    }
+
+    /**
+     * @brief Package in the output buffer of sender s (ramps, then
+     * workers, in the spec order), nullptr if it is empty
+     */
+    const PackageHandle *get_sending_package(std::size_t s) const {
+        return buffers_[s].full ? &buffers_[s].package : nullptr;
+    }
+
+    const PackageHandleQueue &get_queue(std::size_t w) const {
+        return workers_[w].queue;
+    }
+
+    /**
+     * @brief Package worker w is processing, nullptr if none
+     */
+    const PackageHandle *get_processing_package(std::size_t w) const {
+        return workers_[w].busy ? &workers_[w].package : nullptr;
+    }
+
+    std::size_t get_stock(std::size_t s) const { return stock_[s]; }
+
+    /**
+     * @brief Serials of the packages storehouse s received, folded in
+     * arrival order (fold_package_number)
+     */
+    std::uint64_t get_stock_digest(std::size_t s) const {
+        return stock_digest_[s];
+    }
+
+    /**
+     * @brief Packages in the Net (on ramps and workers)
+     */
+    const PackageTable &get_package_table() const { return packages_; }
+
+    /**
+     * @brief Builds the same Net as a regular (dynamic) Factory
+     */
+    static void populate_factory(Factory &f) {
+        for (const auto &ramp : Spec.ramps) {
+            f.add_ramp(Ramp(ramp.id, ramp.delivery_interval));
+        }
+        for (const auto &worker : Spec.workers) {
+            f.add_worker(
+                Worker(worker.id, worker.processing_duration,
+                       std::make_unique<PackageQueue>(
+                           worker.queue_type,
+                           f.get_memory_resource(MemoryCategory::QUEUES))));
+        }
+        for (const auto &storehouse : Spec.storehouses) {
+            f.add_storehouse(Storehouse(
+                storehouse.id,
+                std::make_unique<PackageQueue>(
+                    PackageQueueType::FIFO,
+                    f.get_memory_resource(MemoryCategory::STOCKPILES))));
+        }
+        for (const auto &link : Spec.links) {
+            ReceiverPreferences &prefs =
+                link.sender.type == NodeType::RAMP
+                    ? f.find_ramp_by_id(link.sender.id)->get_receiver_preferences()
+                    : f.find_worker_by_id(link.sender.id)
+                          ->get_receiver_preferences();
+            if (link.receiver.type == NodeType::WORKER) {
+                prefs.add_receiver(&*f.find_worker_by_id(link.receiver.id));
+            } else {
+                prefs.add_receiver(&*f.find_storehouse_by_id(link.receiver.id));
+            }
+        }
+    }
+
+  private:
+    static constexpr std::size_t NONE = detail::NONE;
+    using Route = detail::Route<N_RECEIVERS>;
+
+    static_assert(detail::is_valid<Spec>(),
+                  "TopologySpec has duplicate IDs, non-positive intervals or "
+                  "links between missing nodes.");
+    static constexpr std::array<Route, N_SENDERS> routes_ =
+        detail::make_routes<Spec>();
+    static_assert(detail::is_consistent<Spec>(),
+                  "TopologySpec has a sender with no reachable storehouse.");
+
+    template <std::size_t S, typename Generator>
+    static std::size_t choose_receiver(Generator &pg) {
+        constexpr Route route = routes_[S];
+        double p = pg(); // drawn even without receivers, like Factory does
+        for (std::size_t j = 0; j < route.n_receivers; ++j) {
+            if (p <= route.thresholds[j]) {
+                return route.receivers[j];
+            }
+        }
+        if constexpr (route.n_receivers > 0) {
+            return route.receivers[route.n_receivers - 1];
+        } else {
+            return NONE;
+        }
+    }
+
+    template <std::size_t... I, typename F>
+    static void for_each_index(std::index_sequence<I...>, F &&f) {
+        (f(std::integral_constant<std::size_t, I>{}), ...);
+    }
+
+    struct SendingBuffer {
+        bool full = false;
+        PackageHandle package;
+    };
+
+    struct WorkerState {
+        PackageHandleQueue queue; // popped by the type from the spec
+        bool busy = false;
+        PackageHandle package;
+        Time start = 0;
+    };
+
+    std::array<SendingBuffer, N_SENDERS> buffers_{};
+    std::array<WorkerState, N_WORKERS> workers_{};
+    std::array<std::size_t, N_STOREHOUSES> stock_{};
+    std::array<std::uint64_t, N_STOREHOUSES> stock_digest_{};
+    PackageTable packages_;
+};
+
+} // namespace NetSim
@@ -1,14 +1,91 @@
 #pragma once
 
 #include "package.hpp"
-#include <deque>
+#include "package_table.hpp"
+#include <cstddef>
+#include <iterator>
 #include <list>
+#include <memory>
+#include <memory_resource>
 
 namespace NetSim {
 /**
- * @brief Enumeration type defining a quque type
+ * @brief Read-only iterator over the packages of a stockpile: positions in
+ * a queue of handles, each looked up in the package table
+ * Default constructed - empty range (begin == end)
  */
-enum class PackageQueueType { FIFO, LIFO };
+class PackageIterator {
+public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = Package;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const Package *;
+  using reference = const Package &;
+
+  PackageIterator() = default;
+  PackageIterator(const PackageTable *table, const PackageHandleQueue *handles,
+                  std::size_t i)
+      : table_(table), handles_(handles), i_(i) {}
+
+  reference operator*() const { return table_->get((*handles_)[i_]); }
+  pointer operator->() const { return &**this; }
+
+  PackageIterator &operator++() {
+    ++i_;
+    return *this;
+  }
+  PackageIterator operator++(int) {
+    PackageIterator old = *this;
+    ++i_;
+    return old;
+  }
+  PackageIterator &operator--() {
+    --i_;
+    return *this;
+  }
+  PackageIterator operator--(int) {
+    PackageIterator old = *this;
+    --i_;
+    return old;
+  }
+
+  PackageIterator &operator+=(difference_type n) {
+    i_ += static_cast<std::size_t>(n);
+    return *this;
+  }
+  PackageIterator &operator-=(difference_type n) { return *this += -n; }
+  PackageIterator operator+(difference_type n) const {
+    return PackageIterator(*this) += n;
+  }
+  PackageIterator operator-(difference_type n) const {
+    return PackageIterator(*this) -= n;
+  }
+  difference_type operator-(const PackageIterator &other) const {
+    return static_cast<difference_type>(i_) -
+           static_cast<difference_type>(other.i_);
+  }
+  reference operator[](difference_type n) const { return *(*this + n); }
+
+  bool operator==(const PackageIterator &other) const {
+    return handles_ == other.handles_ && i_ == other.i_;
+  }
+  bool operator!=(const PackageIterator &other) const {
+    return !(*this == other);
+  }
+  bool operator<(const PackageIterator &other) const { return i_ < other.i_; }
+  bool operator>(const PackageIterator &other) const { return other < *this; }
+  bool operator<=(const PackageIterator &other) const {
+    return !(other < *this);
+  }
+  bool operator>=(const PackageIterator &other) const {
+    return !(*this < other);
+  }
+
+private:
+  const PackageTable *table_ = nullptr;
+  const PackageHandleQueue *handles_ = nullptr;
+  std::size_t i_ = 0;
+};
 
 /**
  * @brief Interface for any product container
@@ -20,9 +97,10 @@ enum class PackageQueueType { FIFO, LIFO };
 class IPackageStockpile {
 
 public:
-  // Defining iterator alias based on deque - decision argumented in
-  // 'docs/adr/00-deque.md'
-  using const_iterator = std::deque<Package>::const_iterator;
+  // Packages are kept in a PackageTable, stockpiles hold handles -
+  // 'docs/adr/03-package-table.md', allocator in
+  // 'docs/adr/01-memory-resources.md'
+  using const_iterator = PackageIterator;
 
   // Constructor is not needed for the interface as it's purely virual and never
   // initialized
@@ -36,10 +114,27 @@ public:
   virtual ~IPackageStockpile() {}
 
   /**
-   * @brief Add a product to the container
+   * @brief Add a product to the container (it goes to the package table)
    */
   virtual void push(Package &&package) = 0;
 
+  /**
+   * @brief Add a package already in get_package_table(), only the handle
+   * is stored
+   */
+  virtual void push(PackageHandle handle) = 0;
+
+  /**
+   * @brief Table holding the packages of the container
+   */
+  virtual PackageTable &get_package_table() const = 0;
+
+  /**
+   * @brief Moves the packages to another table (order kept), e.g. when the
+   * owner is added to a Factory
+   */
+  virtual void set_package_table(PackageTable &table) = 0;
+
   /**
    * @brief Check if container is empty
    */
@@ -76,12 +171,25 @@ public:
    */
   virtual Package pop() = 0;
 
+  /**
+   * @brief Like pop, but the package stays in the table - the caller owns
+   * the handle
+   */
+  virtual PackageHandle pop_handle() = 0;
+
   /**
    * @brief Returns Queue type
    * @return Enumerate type PackageQueueType
    */
   virtual PackageQueueType get_queue_type() const = 0;
 
+  /**
+   * @brief Moves the queue and its packages to newly allocated memory (same
+   * resource), e.g. after the nodes were laid out again
+   * @return the new queue, nullptr if not supported
+   */
+  virtual std::unique_ptr<IPackageQueue> relocate() { return nullptr; }
+
   virtual ~IPackageQueue() = default;
 };
 
@@ -93,18 +201,33 @@ public:
   /**
    * @brief Constructor
    * @param type PackageQueueType (FIFO or LIFO)
+   * @param resource memory for the handle buffer, e.g.
+   * Factory::get_memory_resource()
+   * Packages go to default_package_table() until the owner is added to a
+   * Factory
    */
   explicit PackageQueue(
-      PackageQueueType
-          type); // explicit block type conversion, so that constructor allows
-                 // only PackageQueueType as an argument
+      PackageQueueType type,
+      std::pmr::memory_resource *resource =
+          std::pmr::get_default_resource()); // explicit block type conversion,
+                                             // so that constructor allows only
+                                             // PackageQueueType as an argument
+
+  // Handles refer to the table - one owner of the packages
+  PackageQueue(const PackageQueue &) = delete;
+  PackageQueue &operator=(const PackageQueue &) = delete;
 
   void push(Package &&package) override; // Package&& so content of the package
                                          // is fully moved, not just coppied
+  void push(PackageHandle handle) override;
   bool empty() const override;
   size_t size() const override;
   Package pop() override;
+  PackageHandle pop_handle() override;
   PackageQueueType get_queue_type() const override;
+  PackageTable &get_package_table() const override;
+  void set_package_table(PackageTable &table) override;
+  std::unique_ptr<IPackageQueue> relocate() override;
 
   // Iterator methods implementation
 
@@ -113,13 +236,15 @@ public:
   const_iterator cbegin() const override;
   const_iterator cend() const override;
 
-  ~PackageQueue() override =
-      default; // Name is different form IPackageQueue but
+  /**
+   * @brief Releases the packages still queued
+   */
+  ~PackageQueue() override;
 
 private:
-  PackageQueueType queue_type_;
-  std::deque<Package> deque_; // std::deque is ideal because it allows for fast
-                              // access both from front and back side
+  PackageTable *table_;
+  PackageHandleQueue handles_; // ring buffer - pops from both ends are O(1)
+                               // and moving a handle is a plain copy
 };
 
 } // namespace NetSim
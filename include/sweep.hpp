@@ -0,0 +1,114 @@
+// Parallel parameter sweeps over one shared, read-only topology
+
+#pragma once
+
+#include "factory.hpp"
+#include "node_counts.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Immutable copy of a Net: nodes, links and preference weights
+ * Built once and only read afterwards, so any number of threads can share
+ * it. Senders are the ramps, then the workers (Factory order); receivers
+ * are the workers, then the storehouses. Links are stored in CSR form:
+ * links of sender s are link_offsets[s]..link_offsets[s + 1] - 1, in
+ * ReceiverPreferences order, with cumulative probabilities
+ */
+struct Topology {
+    std::vector<ElementID> ramp_ids;
+    std::vector<TimeOffset> delivery_intervals;
+    std::vector<ElementID> worker_ids;
+    std::vector<TimeOffset> processing_durations;
+    std::vector<ElementID> storehouse_ids;
+
+    std::vector<std::size_t> link_offsets;      // senders + 1
+    std::vector<std::uint32_t> link_receivers;  // receiver index
+    std::vector<double> link_thresholds;        // cumulative probability
+    std::vector<std::uint64_t> routing_streams; // per sender
+
+    std::size_t get_sender_count() const {
+        return ramp_ids.size() + worker_ids.size();
+    }
+};
+
+/**
+ * @brief Copies the structure of a Factory
+ * Throws std::logic_error for bounded worker queues, routing policies or
+ * worker behaviours (not modelled)
+ */
+Topology make_topology(const Factory &f);
+
+/**
+ * @brief Parameters of one sweep point
+ * Nodes not listed keep the values of the topology
+ */
+struct SweepPoint {
+    std::map<ElementID, TimeOffset> delivery_intervals;   // ramp ID -> value
+    std::map<ElementID, TimeOffset> processing_durations; // worker ID -> value
+    std::uint64_t seed = 0; // routing streams as in seed_routing_streams
+};
+
+/**
+ * @brief Values swept for one node
+ */
+struct SweepAxis {
+    NodeType type; // RAMP (delivery interval) or WORKER (processing duration)
+    ElementID id;
+    std::vector<TimeOffset> values;
+};
+
+/**
+ * @brief Every combination of the axes' values (cartesian product)
+ */
+std::vector<SweepPoint> make_sweep_grid(const std::vector<SweepAxis> &axes,
+                                        std::uint64_t seed);
+
+/**
+ * @brief One row of the sweep table
+ */
+struct SweepResult {
+    std::size_t delivered = 0;   // packages in storehouses
+    std::size_t in_progress = 0; // queued, processed or waiting to be sent
+    double mean_queue = 0.0;     // all queues together, average per round
+    std::size_t max_queue = 0;   // longest queue seen
+    ElementID max_queue_worker = 0;
+    double mean_utilization = 0.0; // busy fraction, averaged over workers
+};
+
+/**
+ * @brief Runs one point for d rounds (same rounds as simulate())
+ * Throws std::logic_error for overrides of unknown nodes or non-positive
+ * values
+ */
+SweepResult run_sweep_point(const Topology &topology, const SweepPoint &point,
+                            TimeOffset d);
+
+/**
+ * @brief Final node state of one point, comparable with
+ * collect_node_counts() of a Factory seeded with seed_routing_streams()
+ */
+NodeCounts sweep_point_counts(const Topology &topology,
+                              const SweepPoint &point, TimeOffset d);
+
+/**
+ * @brief Runs all points on n_threads threads (0 - one per core)
+ * Threads share the topology and take points one by one, each thread
+ * reuses one mutable state (queues, buffers, timers, random engines)
+ * @return results in the order of points
+ */
+std::vector<SweepResult> run_sweep(const Topology &topology,
+                                   const std::vector<SweepPoint> &points,
+                                   TimeOffset d, unsigned n_threads = 0);
+
+void print_sweep_table(std::ostream &os, const std::vector<SweepPoint> &points,
+                       const std::vector<SweepResult> &results);
+
+} // namespace NetSim
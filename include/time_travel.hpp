@@ -0,0 +1,137 @@
+// Past states of a run: periodic checkpoints and a log of package moves
+
+#pragma once
+
+#include "factory.hpp"
+#include "nodes.hpp"
+#include "reports.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Extension point told about every change of where a package is
+ * Nodes call it like trace_sink; simulate() calls on_round at the start of
+ * every round (loops of their own must do the same)
+ */
+class IPackageMoveListener {
+  public:
+    virtual ~IPackageMoveListener() = default;
+
+    virtual void on_round(Time t) = 0;
+
+    /**
+     * @brief New package in the output buffer of a ramp
+     */
+    virtual void on_delivery(ElementID ramp_id, ElementID package_id) = 0;
+
+    /**
+     * @brief Package moved from a sender's output buffer to a receiver
+     */
+    virtual void on_receive(ReceiverType type, ElementID receiver_id,
+                            ElementID package_id) = 0;
+
+    /**
+     * @brief Worker took the package from its queue (in the current round)
+     */
+    virtual void on_start(ElementID worker_id, ElementID package_id) = 0;
+
+    /**
+     * @brief Worker moved the processed package to its output buffer
+     */
+    virtual void on_finish(ElementID worker_id) = 0;
+};
+
+/**
+ * @brief Active listener, nullptr (default) - nothing is reported
+ */
+extern IPackageMoveListener *package_move_listener;
+
+/**
+ * @brief Records a run so the state after any past round can be rebuilt
+ * A checkpoint (TurnSnapshot) is taken every checkpoint_interval rounds,
+ * package moves go to a compact in-memory log (varints). A query loads the
+ * nearest earlier checkpoint and replays at most checkpoint_interval rounds
+ * of the log, so its cost doesn't depend on the length of the run
+ * Storehouse stock only grows, so it is kept once (every package in the
+ * order received) and checkpoints only store its size; queued packages are
+ * copied into every checkpoint, so an overloaded Net costs more memory
+ * The structure of the Net must not change while recording
+ */
+class TimeTravelRecorder : public IPackageMoveListener {
+  public:
+    /**
+     * @param f the recorded Factory, read when a checkpoint is taken
+     */
+    explicit TimeTravelRecorder(const Factory &f,
+                                Time checkpoint_interval = 1000);
+
+    // Detaches itself from package_move_listener
+    ~TimeTravelRecorder() override;
+
+    TimeTravelRecorder(const TimeTravelRecorder &) = delete;
+    TimeTravelRecorder &operator=(const TimeTravelRecorder &) = delete;
+
+    /**
+     * @brief Takes a checkpoint of the state after round t - 1 when due
+     * (and at the first round recorded). Throws std::logic_error when the
+     * rounds don't increase
+     */
+    void on_round(Time t) override;
+
+    void on_delivery(ElementID ramp_id, ElementID package_id) override;
+    /**
+     * @brief Throws std::logic_error for a storehouse added while recording
+     */
+    void on_receive(ReceiverType type, ElementID receiver_id,
+                    ElementID package_id) override;
+
+    void on_start(ElementID worker_id, ElementID package_id) override;
+    void on_finish(ElementID worker_id) override;
+
+    /**
+     * @brief Rebuilds the state after round t, as take_snapshot(f, t) would
+     * have seen it then
+     * Throws std::out_of_range for rounds before the first checkpoint or
+     * after the last recorded round, std::runtime_error if the log names a
+     * node the checkpoint doesn't have
+     */
+    void reconstruct(Time t, TurnSnapshot &snapshot) const;
+
+    /**
+     * @brief Earliest round that can be rebuilt (first checkpoint)
+     */
+    Time get_first_round() const;
+
+    Time get_last_round() const { return round_; }
+
+    std::size_t get_checkpoint_count() const { return checkpoints_.size(); }
+
+    std::size_t get_log_bytes() const { return log_.size(); }
+
+  private:
+    struct Checkpoint {
+        TurnSnapshot state; // after round state.t, stock ranges empty
+        std::vector<std::size_t> stock_sizes; // prefixes of stock_history_
+        std::size_t log_offset; // first event after the checkpoint
+    };
+
+    void take_checkpoint(Time t);
+    void put_event(unsigned op, std::uint64_t value);
+
+    const Factory &f_;
+    Time interval_;
+    Time round_ = 0;
+    std::string log_;
+    std::vector<Checkpoint> checkpoints_;
+    std::vector<std::vector<ElementID>> stock_history_; // per storehouse
+    std::unordered_map<ElementID, std::size_t> storehouse_index_;
+};
+
+} // namespace NetSim
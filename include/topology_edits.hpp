@@ -0,0 +1,157 @@
+// Structural changes of the Net staged while the simulation is running
+
+#pragma once
+
+#include "factory.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Group of structural changes applied all together or not at all
+ * Filled privately by one planner thread, then submitted
+ */
+class TopologyEditBatch {
+  public:
+    void add_ramp(ElementID id, TimeOffset delivery_interval);
+    void remove_ramp(ElementID id);
+    void add_worker(ElementID id, TimeOffset processing_duration,
+                    PackageQueueType queue_type);
+    void remove_worker(ElementID id);
+    void add_storehouse(ElementID id);
+    void remove_storehouse(ElementID id);
+
+    /**
+     * @brief Links sender (ramp/worker) to receiver (worker/storehouse)
+     */
+    void add_link(NodeRef sender, NodeRef receiver);
+    void remove_link(NodeRef sender, NodeRef receiver);
+
+    bool empty() const { return edits_.empty(); }
+
+  private:
+    friend class TopologyEditQueue;
+
+    enum class EditType { ADD_NODE, REMOVE_NODE, ADD_LINK, REMOVE_LINK };
+
+    struct Edit {
+        EditType type;
+        NodeRef node;   // node, or link sender
+        NodeRef target; // link receiver
+        TimeOffset offset;
+        PackageQueueType queue_type;
+    };
+
+    std::vector<Edit> edits_;
+};
+
+/**
+ * @brief Stages edits from any thread and publishes them between rounds
+ * Planners only append to a staging list under a short lock. The
+ * simulation thread calls publish() at a round boundary: staged batches are
+ * validated against the Net and applied as a whole, then the epoch grows.
+ * Removed nodes are unlinked from all senders and retired instead of
+ * destroyed; they are freed once every registered reader has entered a
+ * newer epoch, so a pointer taken before the removal stays valid until the
+ * reader leaves. Other threads traverse the structure (node lists,
+ * receiver maps) only under a ReadLock, which publish() waits for. Retired
+ * nodes live in the Factory memory - the queue must not outlive the Factory
+ */
+class TopologyEditQueue {
+  public:
+    static constexpr std::size_t MAX_READERS = 64;
+
+    /**
+     * @brief Queues a batch (any thread, never waits for the simulation)
+     */
+    void submit(TopologyEditBatch batch);
+
+    /**
+     * @brief Applies staged batches (simulation thread, between rounds)
+     * Changes the structure only while no ReadLock is held
+     * @return number of applied batches
+     */
+    std::size_t publish(Factory &f);
+
+    std::uint64_t get_epoch() const { return epoch_.load(); }
+
+    /**
+     * @brief Batches skipped because they referenced missing nodes, added
+     * existing ones or linked incompatible node types
+     */
+    std::size_t get_rejected_batches() const { return rejected_; }
+
+    /**
+     * @brief Retired nodes not freed yet
+     */
+    std::size_t get_retired_nodes() const;
+
+    /**
+     * @brief Keeps nodes removed while the guard lives from being freed
+     * (RAII), so node pointers taken earlier stay valid
+     * It doesn't make traversal safe - take a ReadLock for that
+     */
+    class ReaderGuard {
+      public:
+        explicit ReaderGuard(TopologyEditQueue &queue);
+        ~ReaderGuard();
+
+        ReaderGuard(const ReaderGuard &) = delete;
+        ReaderGuard &operator=(const ReaderGuard &) = delete;
+
+      private:
+        TopologyEditQueue &queue_;
+        std::size_t slot_;
+    };
+
+    /**
+     * @brief Lets another thread traverse the node lists and receiver maps
+     * (RAII, shared with other readers); publish() waits for it before
+     * changing them. Hold it only for one traversal - pointers kept after
+     * it need a ReaderGuard. Node state (queues, buffers) still changes
+     * with every round
+     */
+    class ReadLock {
+      public:
+        explicit ReadLock(TopologyEditQueue &queue)
+            : lock_(queue.structure_mutex_) {}
+
+      private:
+        std::shared_lock<std::shared_mutex> lock_;
+    };
+
+  private:
+    /**
+     * @brief Nodes removed in one epoch
+     */
+    struct Retired {
+        std::uint64_t epoch;
+        NodeCollection<Ramp>::container_t ramps;
+        NodeCollection<Worker>::container_t workers;
+        NodeCollection<Storehouse>::container_t storehouses;
+    };
+
+    bool validate(const Factory &f, const TopologyEditBatch &batch) const;
+    void apply(Factory &f, TopologyEditBatch &batch, Retired &retired);
+    void reclaim();
+
+    std::mutex staging_mutex_;
+    std::vector<TopologyEditBatch> staged_;
+    std::shared_mutex structure_mutex_; // publish() vs ReadLock
+
+    std::atomic<std::uint64_t> epoch_{1};
+    std::array<std::atomic<std::uint64_t>, MAX_READERS> reader_epochs_{};
+    std::deque<Retired> retired_;
+    std::size_t rejected_ = 0;
+};
+
+} // namespace NetSim
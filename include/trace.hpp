@@ -0,0 +1,148 @@
+// Chrome trace-event / Perfetto JSON export of the package flow
+
+#pragma once
+
+#include "types.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace NetSim {
+
+/**
+ * @brief Kind of a recorded event
+ */
+enum class TraceEventType : std::uint8_t { DELIVERY, PROCESSING, RECEIVE };
+
+/**
+ * @brief Single trace event, plain data so the ring buffer copies it cheaply
+ * node_kind uses the values of ReceiverType (0 - worker, 1 - storehouse),
+ * ramps are identified by the DELIVERY type
+ */
+struct TraceEvent {
+    TraceEventType type;
+    std::uint8_t node_kind;
+    ElementID node_id;
+    ElementID package_id;
+    Time start;
+    Time end;
+};
+
+/**
+ * @brief Tracing settings
+ */
+struct TraceOptions {
+    std::size_t ring_capacity = 1 << 16; // events per thread, power of two
+    ElementID sample_every = 1;          // trace packages with id % n == 0
+    int round_duration_us = 1000;        // trace time of a single round
+    std::size_t write_buffer_size = 1 << 20; // bytes formatted before write
+};
+
+/**
+ * @brief Trace sink writing events through per-thread ring buffers
+ * Simulation threads only copy an event into their own ring (no locks, no
+ * I/O). A background thread drains the rings, formats JSON and writes it in
+ * large blocks. When a ring is full the event is dropped and counted, so
+ * memory use is fixed by ring_capacity and the number of threads
+ */
+class TraceSink {
+  public:
+    explicit TraceSink(const std::string &path,
+                       const TraceOptions &options = {});
+
+    // Rings are handed to threads by pointer - sink cannot be moved
+    TraceSink(const TraceSink &) = delete;
+    TraceSink &operator=(const TraceSink &) = delete;
+
+    /**
+     * @brief Closes the sink (flushes everything)
+     */
+    ~TraceSink();
+
+    /**
+     * @brief Stops the writer thread, writes remaining events and the footer
+     */
+    void close();
+
+    /**
+     * @brief Tells if events of a given package are recorded
+     */
+    bool is_sampled(ElementID package_id) const {
+        return package_id % options_.sample_every == 0;
+    }
+
+    /**
+     * @brief Sets current round of the calling thread (used by receive events)
+     */
+    void set_round(Time t);
+
+    void record_delivery(ElementID ramp_id, ElementID package_id, Time t);
+    void record_processing(ElementID worker_id, ElementID package_id,
+                           Time start, Time end);
+    void record_receive(std::uint8_t receiver_kind, ElementID receiver_id,
+                        ElementID package_id);
+
+    std::size_t get_dropped_events() const;
+    std::size_t get_written_events() const { return written_; }
+
+    /**
+     * @brief Rings allocated so far, one per thread that recorded events
+     */
+    std::size_t get_ring_count() const;
+
+  private:
+    /**
+     * @brief Single-producer single-consumer ring of one thread
+     */
+    struct Ring {
+        explicit Ring(std::size_t capacity) : events(capacity) {}
+
+        std::vector<TraceEvent> events;
+        std::atomic<std::size_t> head{0}; // written by the producer
+        std::atomic<std::size_t> tail{0}; // written by the writer thread
+        std::atomic<std::size_t> dropped{0};
+        Time round = 0;
+    };
+
+    Ring &thread_ring();
+    void push(const TraceEvent &event);
+    void writer_loop();
+    void drain();
+    void format(const TraceEvent &event);
+    void flush_buffer();
+
+    TraceOptions options_;
+    std::uint64_t instance_; // distinguishes sinks for the thread_local cache
+    std::ofstream out_;
+    std::string buffer_;
+    std::atomic<std::size_t> written_{0};
+    bool closed_ = false;
+
+    mutable std::mutex rings_mutex_;
+    std::vector<std::unique_ptr<Ring>> rings_;
+    // A thread switching between sinks gets its ring back from here (an
+    // ID reused by a new thread takes over the ring of the finished one)
+    std::unordered_map<std::thread::id, Ring *> thread_rings_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> stop_{false};
+    std::thread writer_;
+};
+
+/**
+ * @brief Active trace sink, nodes report events to it
+ * nullptr (default) - tracing disabled, costs one check per event
+ */
+extern TraceSink *trace_sink;
+
+} // namespace NetSim
@@ -0,0 +1,189 @@
+// Custom worker behaviour written as C++20 coroutines
+// Empty below C++20 (no coroutine support), the rest of NetSim is C++17
+
+#pragma once
+
+#include "nodes.hpp"
+#include "types.hpp"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+
+namespace NetSim {
+
+/**
+ * @brief Coroutine running the work of one station, see CoroutineBehaviour
+ */
+class WorkerTask {
+  public:
+    struct promise_type {
+        WorkerTask get_return_object() {
+            return WorkerTask(handle_type::from_promise(*this));
+        }
+        // Started by the first do_work, not when created
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+
+        std::exception_ptr error; // rethrown by do_work
+    };
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    WorkerTask(WorkerTask &&other) noexcept;
+    WorkerTask &operator=(WorkerTask &&other) noexcept;
+    ~WorkerTask();
+
+  private:
+    friend class CoroutineBehaviour;
+
+    explicit WorkerTask(handle_type handle) : handle_(handle) {}
+
+    handle_type handle_;
+};
+
+/**
+ * @brief What a behaviour coroutine sees of its worker: the current round
+ * and awaitable steps. The coroutine is resumed (in the work phase) only
+ * once the condition it waits for holds, a round of waiting costs one check
+ */
+class WorkerContext {
+  public:
+    /**
+     * @brief What the suspended coroutine waits for
+     */
+    enum class Wait { START, ROUND, PACKAGES, RELEASE, DONE };
+
+    struct RoundsAwaiter {
+        WorkerContext &ctx;
+        TimeOffset n;
+
+        bool await_ready() const { return n <= 0; }
+        void await_suspend(std::coroutine_handle<>);
+        void await_resume() const {}
+    };
+
+    struct PackagesAwaiter {
+        WorkerContext &ctx;
+        std::size_t n;
+        bool take; // into hand when resumed
+
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<>);
+        void await_resume();
+    };
+
+    struct ReleaseAwaiter {
+        WorkerContext &ctx;
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<>);
+        void await_resume() const {}
+    };
+
+    Time now() const { return t_; }
+
+    Worker &worker() const { return *worker_; }
+
+    /**
+     * @brief Waits n rounds, resumes in round now() + n (n <= 0 - no wait)
+     */
+    RoundsAwaiter wait_rounds(TimeOffset n) { return {*this, n}; }
+
+    /**
+     * @brief Waits until at least n packages are queued
+     */
+    PackagesAwaiter wait_packages(std::size_t n) { return {*this, n, false}; }
+
+    /**
+     * @brief Waits for a package and takes it from the queue into hand
+     * (processing starts now()). Throws std::logic_error with a package
+     * already in hand
+     */
+    PackagesAwaiter take_package() { return {*this, 1, true}; }
+
+    /**
+     * @brief Moves the package in hand to the output buffer, waiting while
+     * the buffer is blocked. Throws std::logic_error with nothing in hand
+     */
+    ReleaseAwaiter release_package() { return {*this}; }
+
+  private:
+    friend class CoroutineBehaviour;
+
+    Worker *worker_ = nullptr; // set by every do_work (nodes can be moved)
+    Time t_ = 0;
+    Wait wait_ = Wait::START;
+    Time wake_round_ = 0;      // Wait::ROUND
+    std::size_t packages_ = 0; // Wait::PACKAGES
+};
+
+/**
+ * @brief Coroutine of a behaviour: takes the context of its worker
+ * It runs as long as the behaviour, so a lambda may keep its captures
+ */
+using WorkerBody = std::function<WorkerTask(WorkerContext &)>;
+
+/**
+ * @brief Worker behaviour running a coroutine: do_work checks the awaited
+ * condition and resumes the coroutine only when it holds, until it
+ * suspends again. Exceptions of the coroutine are rethrown by do_work,
+ * after the coroutine returns the worker does nothing
+ */
+class CoroutineBehaviour : public IWorkerBehaviour {
+  public:
+    explicit CoroutineBehaviour(WorkerBody body);
+
+    // The coroutine keeps a reference to the context
+    CoroutineBehaviour(const CoroutineBehaviour &) = delete;
+    CoroutineBehaviour &operator=(const CoroutineBehaviour &) = delete;
+
+    void do_work(Worker &worker, Time t) override;
+
+    Time get_wake_round() const override;
+
+    WorkerContext::Wait get_wait() const { return ctx_.wait_; }
+
+  private:
+    void resume();
+
+    WorkerBody body_;
+    WorkerContext ctx_;
+    WorkerTask task_;
+};
+
+/**
+ * @brief Sets a coroutine behaviour on the worker
+ */
+void set_coroutine_behaviour(Worker &worker, WorkerBody body);
+
+// STATIONS
+
+/**
+ * @brief Same work as the fixed-duration step of Worker::do_work
+ */
+WorkerTask fixed_duration_station(WorkerContext &ctx, TimeOffset pd);
+
+/**
+ * @brief Fixed-duration work, stopping for downtime rounds after every
+ * packages_between packages (setup or maintenance)
+ */
+WorkerTask maintenance_station(WorkerContext &ctx, TimeOffset pd,
+                               std::size_t packages_between,
+                               TimeOffset downtime);
+
+/**
+ * @brief Waits for batch_size queued packages, processes them together for
+ * pd rounds (they stay in the queue), then releases one per round
+ */
+WorkerTask batch_station(WorkerContext &ctx, std::size_t batch_size,
+                         TimeOffset pd);
+
+} // namespace NetSim
+
+#endif // __cpp_impl_coroutine
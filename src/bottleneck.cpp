@@ -0,0 +1,164 @@
+#include "../include/bottleneck.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <queue>
+#include <set>
+
+namespace NetSim {
+
+void BottleneckAnalyzer::observe(const Factory &f, Time t) {
+    std::size_t n_workers = static_cast<std::size_t>(
+        std::distance(f.worker_cbegin(), f.worker_cend()));
+
+    // Structure has changed - statistics start over
+    if (workers_.size() != n_workers) {
+        workers_.assign(n_workers, Accumulator{});
+        samples_ = 0;
+        sum_t_ = 0.0;
+        sum_tt_ = 0.0;
+    }
+
+    double time = static_cast<double>(t);
+    ++samples_;
+    sum_t_ += time;
+    sum_tt_ += time * time;
+
+    std::size_t i = 0;
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it, ++i) {
+        Accumulator &acc = workers_[i];
+        acc.id = it->get_id();
+
+        // Busy: package in hand or just finished (waiting in output buffer)
+        if (it->get_processing_buffer() || it->get_sending_buffer()) {
+            ++acc.busy_rounds;
+        }
+
+        std::size_t q = it->get_queue()->size();
+        acc.last_queue = q;
+        acc.max_queue = std::max(acc.max_queue, q);
+        acc.sum_q += static_cast<double>(q);
+        acc.sum_tq += time * static_cast<double>(q);
+    }
+}
+
+BottleneckReport BottleneckAnalyzer::make_report(const Factory &f) const {
+    BottleneckReport report;
+    report.rounds_observed = static_cast<Time>(samples_);
+    if (samples_ == 0) {
+        return report;
+    }
+
+    double n = static_cast<double>(samples_);
+    double denominator = n * sum_tt_ - sum_t_ * sum_t_;
+
+    for (const auto &acc : workers_) {
+        WorkerLoad load;
+        load.id = acc.id;
+        load.utilization = static_cast<double>(acc.busy_rounds) / n;
+        load.mean_queue_length = acc.sum_q / n;
+        load.max_queue_length = acc.max_queue;
+        load.final_queue_length = acc.last_queue;
+        if (denominator > 0.0) {
+            load.queue_growth =
+                (n * acc.sum_tq - sum_t_ * acc.sum_q) / denominator;
+        }
+        report.ranking.push_back(load);
+    }
+
+    std::stable_sort(report.ranking.begin(), report.ranking.end(),
+                     [](const WorkerLoad &a, const WorkerLoad &b) {
+                         if (a.queue_growth != b.queue_growth) {
+                             return a.queue_growth > b.queue_growth;
+                         }
+                         return a.utilization > b.utilization;
+                     });
+
+    if (report.ranking.empty()) {
+        return report;
+    }
+
+    // Reverse links: receiver -> senders (ramps and workers)
+    std::map<const IPackageReceiver *, std::vector<const Ramp *>> ramp_links;
+    std::map<const IPackageReceiver *, std::vector<const Worker *>>
+        worker_links;
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        for (const auto &pair : it->get_receiver_preferences()) {
+            ramp_links[pair.first].push_back(&*it);
+        }
+    }
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        for (const auto &pair : it->get_receiver_preferences()) {
+            worker_links[pair.first].push_back(&*it);
+        }
+    }
+
+    // BFS upstream from the bottleneck
+    auto bottleneck = f.find_worker_by_id(report.ranking.front().id);
+    if (bottleneck == f.worker_cend()) {
+        return report;
+    }
+    std::set<ElementID> ramps;
+    std::set<const Worker *> visited = {&*bottleneck};
+    std::queue<const Worker *> to_visit;
+    to_visit.push(&*bottleneck);
+
+    while (!to_visit.empty()) {
+        const IPackageReceiver *receiver = to_visit.front();
+        to_visit.pop();
+
+        for (const Ramp *ramp : ramp_links[receiver]) {
+            ramps.insert(ramp->get_id());
+        }
+        for (const Worker *worker : worker_links[receiver]) {
+            if (visited.insert(worker).second) {
+                report.feeding_workers.push_back(worker->get_id());
+                to_visit.push(worker);
+            }
+        }
+    }
+    report.feeding_ramps.assign(ramps.begin(), ramps.end());
+    std::sort(report.feeding_workers.begin(), report.feeding_workers.end());
+
+    return report;
+}
+
+void print_bottleneck_report(const BottleneckReport &report,
+                             std::ostream &os) {
+    os << "== BOTTLENECK REPORT ==\n";
+    os << "Rounds observed: " << report.rounds_observed << "\n";
+    if (report.ranking.empty()) {
+        os << "No workers.\n";
+        return;
+    }
+
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+    std::size_t rank = 1;
+    for (const auto &load : report.ranking) {
+        os << rank++ << ". WORKER #" << load.id
+           << " utilization=" << load.utilization
+           << " queue(mean/max/final)=" << load.mean_queue_length << "/"
+           << load.max_queue_length << "/" << load.final_queue_length
+           << " growth=" << load.queue_growth << "/round\n";
+    }
+
+    os << "Bottleneck: WORKER #" << report.ranking.front().id << "\n";
+    os << "Fed by ramps:";
+    for (ElementID id : report.feeding_ramps) {
+        os << " #" << id;
+    }
+    os << "\nVia workers:";
+    for (ElementID id : report.feeding_workers) {
+        os << " #" << id;
+    }
+    os << "\n";
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+} // namespace NetSim
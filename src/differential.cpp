@@ -0,0 +1,298 @@
+#include "../include/differential.hpp"
+
+#include <map>
+#include <memory>
+#include <random>
+
+namespace NetSim {
+
+// HASHES
+
+namespace {
+const std::uint64_t FNV_OFFSET = 0xCBF29CE484222325ULL;
+
+void hash_value(std::uint64_t &hash, std::uint64_t value) {
+    for (int byte = 0; byte < 8; ++byte) {
+        hash ^= (value >> (8 * byte)) & 0xFF;
+        hash *= 0x100000001B3ULL; // FNV prime
+    }
+}
+} // namespace
+
+NodeHash::NodeHash(NodeType type, ElementID id)
+    : type_(type), id_(id), hash_(FNV_OFFSET) {
+    hash_value(hash_, static_cast<std::uint64_t>(type));
+    hash_value(hash_, static_cast<std::uint64_t>(id));
+}
+
+void NodeHash::add(std::uint64_t value) { hash_value(hash_, value); }
+
+void StateHash::add(const NodeHash &node) {
+    sum_ += node.get();
+    if (keep_nodes_) {
+        nodes_.push_back(node);
+    }
+}
+
+// ENGINES
+
+void FactoryEngine::do_round(Time t) {
+    ramp_was_empty_.clear();
+    for (auto it = f_.ramp_cbegin(); it != f_.ramp_cend(); ++it) {
+        ramp_was_empty_.push_back(!it->get_sending_buffer());
+    }
+    f_.do_deliveries(t);
+    std::size_t r = 0;
+    for (auto it = f_.ramp_cbegin(); it != f_.ramp_cend(); ++it, ++r) {
+        if (ramp_was_empty_[r] && it->get_sending_buffer()) { // delivered
+            numbers_[it->get_sending_buffer()->get_id()] = delivered_++;
+        }
+    }
+    f_.do_package_passing();
+    f_.do_work(t);
+}
+
+NodeCounts FactoryEngine::get_node_counts() const {
+    return collect_node_counts(f_);
+}
+
+std::uint64_t FactoryEngine::number_of(const Package &p) const {
+    auto it = numbers_.find(p.get_id());
+    return it == numbers_.end() ? NodeHash::UNNUMBERED : it->second;
+}
+
+void FactoryEngine::hash_state(StateHash &hash) const {
+    auto number = [this](const Package *buffer) {
+        return buffer ? number_of(*buffer) : NodeHash::NO_PACKAGE;
+    };
+    for (auto it = f_.ramp_cbegin(); it != f_.ramp_cend(); ++it) {
+        NodeHash node(NodeType::RAMP, it->get_id());
+        node.add(number(it->get_sending_buffer()));
+        hash.add(node);
+    }
+    for (auto it = f_.worker_cbegin(); it != f_.worker_cend(); ++it) {
+        NodeHash node(NodeType::WORKER, it->get_id());
+        node.add(it->get_queue()->size());
+        for (const auto &package : *it->get_queue()) {
+            node.add(number_of(package));
+        }
+        node.add(number(it->get_processing_buffer()));
+        node.add(number(it->get_sending_buffer()));
+        hash.add(node);
+    }
+    for (auto it = f_.storehouse_cbegin(); it != f_.storehouse_cend(); ++it) {
+        const IPackageStockpile &stock = *it->get_stockpile();
+        StockDigest &cached = stock_[it->get_id()];
+        if (stock.size() < cached.size) {
+            cached = StockDigest(); // another storehouse with this ID
+        }
+        auto p = stock.cbegin() + static_cast<std::ptrdiff_t>(cached.size);
+        for (; p != stock.cend(); ++p) {
+            cached.digest = fold_package_number(cached.digest, number_of(*p));
+        }
+        cached.size = stock.size();
+        NodeHash node(NodeType::STOREHOUSE, it->get_id());
+        node.add(cached.size);
+        node.add(cached.digest);
+        hash.add(node);
+    }
+}
+
+// HELPERS
+
+namespace {
+/**
+ * @brief Finds the first different entry of one field (by node ID)
+ * @return true if the field differs
+ */
+bool diff_map(const std::map<ElementID, std::size_t> &reference,
+              const std::map<ElementID, std::size_t> &candidate,
+              NodeType type, const char *field, DifferentialReport &report) {
+    auto ref_it = reference.begin();
+    auto cand_it = candidate.begin();
+    while (ref_it != reference.end() || cand_it != candidate.end()) {
+        report.node_type = type;
+        if (cand_it == candidate.end() ||
+            (ref_it != reference.end() && ref_it->first < cand_it->first)) {
+            report.node_id = ref_it->first; // node only in the reference
+            report.field = "missing";
+            report.reference_value = ref_it->second;
+            report.candidate_value = 0;
+            return true;
+        }
+        if (ref_it == reference.end() || cand_it->first < ref_it->first) {
+            report.node_id = cand_it->first; // node only in the candidate
+            report.field = "missing";
+            report.reference_value = 0;
+            report.candidate_value = cand_it->second;
+            return true;
+        }
+        if (ref_it->second != cand_it->second) {
+            report.node_id = ref_it->first;
+            report.field = field;
+            report.reference_value = ref_it->second;
+            report.candidate_value = cand_it->second;
+            return true;
+        }
+        ++ref_it;
+        ++cand_it;
+    }
+    return false;
+}
+
+/**
+ * @brief Node hashes by (type, ID)
+ */
+std::map<std::pair<NodeType, ElementID>, std::uint64_t>
+node_hashes(const ISteppingEngine &engine) {
+    StateHash hash(true);
+    engine.hash_state(hash);
+    std::map<std::pair<NodeType, ElementID>, std::uint64_t> nodes;
+    for (const NodeHash &node : hash.get_nodes()) {
+        nodes[{node.get_type(), node.get_id()}] = node.get();
+    }
+    return nodes;
+}
+} // namespace
+
+void set_routing_generator(Factory &f, const ProbabilityGenerator &pg) {
+    for (auto it = f.ramp_begin(); it != f.ramp_end(); ++it) {
+        it->get_receiver_preferences().set_probability_generator(pg);
+    }
+    for (auto it = f.worker_begin(); it != f.worker_end(); ++it) {
+        it->get_receiver_preferences().set_probability_generator(pg);
+    }
+}
+
+void build_random_factory(Factory &f, const RandomFactoryOptions &options) {
+    std::mt19937_64 gen(options.seed);
+    auto pick = [&gen](int from, int to) {
+        return std::uniform_int_distribution<int>(from, to)(gen);
+    };
+
+    for (int id = 1; id <= options.n_ramps; ++id) {
+        f.add_ramp(Ramp(id, pick(1, options.max_interval)));
+    }
+    for (int id = 1; id <= options.n_workers; ++id) {
+        PackageQueueType type =
+            pick(0, 1) ? PackageQueueType::FIFO : PackageQueueType::LIFO;
+        f.add_worker(Worker(id, pick(1, options.max_duration),
+                            std::make_unique<PackageQueue>(
+                                type, f.get_memory_resource(
+                                          MemoryCategory::QUEUES))));
+    }
+    for (int id = 1; id <= options.n_storehouses; ++id) {
+        f.add_storehouse(Storehouse(
+            id, std::make_unique<PackageQueue>(
+                    PackageQueueType::FIFO,
+                    f.get_memory_resource(MemoryCategory::STOCKPILES))));
+    }
+
+    for (int id = 1; id <= options.n_ramps; ++id) {
+        auto &prefs = f.find_ramp_by_id(id)->get_receiver_preferences();
+        for (int link = pick(1, options.max_links); link > 0; --link) {
+            prefs.add_receiver(&*f.find_worker_by_id(pick(1, options.n_workers)));
+        }
+    }
+    for (int id = 1; id <= options.n_workers; ++id) {
+        auto &prefs = f.find_worker_by_id(id)->get_receiver_preferences();
+        prefs.add_receiver(
+            &*f.find_storehouse_by_id(pick(1, options.n_storehouses)));
+        if (id == options.n_workers) {
+            continue;
+        }
+        for (int link = pick(0, options.max_links - 1); link > 0; --link) {
+            // forward links only - no cycles
+            prefs.add_receiver(
+                &*f.find_worker_by_id(pick(id + 1, options.n_workers)));
+        }
+    }
+}
+
+// HARNESS
+
+DifferentialReport run_differential(ISteppingEngine &reference,
+                                    ISteppingEngine &candidate,
+                                    TimeOffset d) {
+    DifferentialReport report;
+    for (Time t = 1; t <= d; ++t) {
+        reference.do_round(t);
+        candidate.do_round(t);
+        report.rounds_compared = t;
+
+        StateHash ref_hash, cand_hash;
+        reference.hash_state(ref_hash);
+        candidate.hash_state(cand_hash);
+        if (ref_hash.get() == cand_hash.get()) {
+            continue;
+        }
+
+        // Full comparison only once something differs
+        NodeCounts ref = reference.get_node_counts();
+        NodeCounts cand = candidate.get_node_counts();
+        report.diverged = true;
+        report.round = t;
+        if (diff_map(ref.worker_queues, cand.worker_queues, NodeType::WORKER,
+                     "queue", report) ||
+            diff_map(ref.worker_busy, cand.worker_busy, NodeType::WORKER,
+                     "busy", report) ||
+            diff_map(ref.worker_sending, cand.worker_sending, NodeType::WORKER,
+                     "sending", report) ||
+            diff_map(ref.storehouse_stock, cand.storehouse_stock,
+                     NodeType::STOREHOUSE, "stock", report)) {
+            return report;
+        }
+        // Same counts - the first node holding other packages
+        auto ref_nodes = node_hashes(reference);
+        auto cand_nodes = node_hashes(candidate);
+        report.field = "packages";
+        for (const auto &pair : ref_nodes) {
+            auto it = cand_nodes.find(pair.first);
+            if (it == cand_nodes.end() || it->second != pair.second) {
+                report.node_type = pair.first.first;
+                report.node_id = pair.first.second;
+                return report;
+            }
+        }
+        for (const auto &pair : cand_nodes) {
+            if (!ref_nodes.count(pair.first)) { // a ramp only it has
+                report.node_type = pair.first.first;
+                report.node_id = pair.first.second;
+                report.field = "missing";
+                return report;
+            }
+        }
+        return report;
+    }
+    return report;
+}
+
+void print_differential_report(std::ostream &os,
+                               const DifferentialReport &report) {
+    if (!report.diverged) {
+        os << "Engines match for " << report.rounds_compared << " rounds"
+           << std::endl;
+        return;
+    }
+    os << "Engines diverge in round " << report.round << ": ";
+    switch (report.node_type) {
+    case NodeType::RAMP:
+        os << "ramp";
+        break;
+    case NodeType::WORKER:
+        os << "worker";
+        break;
+    case NodeType::STOREHOUSE:
+        os << "storehouse";
+        break;
+    }
+    os << " #" << report.node_id << " " << report.field;
+    if (report.field == "packages") {
+        os << " differ" << std::endl;
+        return;
+    }
+    os << " (reference: " << report.reference_value
+       << ", candidate: " << report.candidate_value << ")" << std::endl;
+}
+
+} // namespace NetSim
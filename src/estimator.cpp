@@ -0,0 +1,127 @@
+#include "../include/estimator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+namespace NetSim {
+
+bool NetworkEstimate::has_saturated_worker() const {
+    return std::any_of(workers.begin(), workers.end(),
+                       [](const WorkerEstimate &w) { return w.saturated; });
+}
+
+NetworkEstimate estimate_network(const Factory &f,
+                                 const EstimatorOptions &options) {
+    NetworkEstimate estimate;
+
+    // Indexing receivers, so the equations work on plain arrays
+    std::map<const IPackageReceiver *, std::size_t> worker_index;
+    std::map<const IPackageReceiver *, std::size_t> storehouse_index;
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        worker_index[&*it] = estimate.workers.size();
+        WorkerEstimate w;
+        w.id = it->get_id();
+        // Worker takes a new package at most once per round
+        w.service_rate =
+            1.0 / std::max<TimeOffset>(it->get_processing_duration(), 1);
+        estimate.workers.push_back(w);
+    }
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        storehouse_index[&*it] = estimate.storehouses.size();
+        estimate.storehouses.push_back(StorehouseEstimate{it->get_id(), 0.0});
+    }
+
+    std::size_t n = estimate.workers.size();
+
+    // External arrivals from ramps
+    std::vector<double> external(n, 0.0);
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        double rate = 1.0 / std::max<TimeOffset>(it->get_delivery_interval(), 1);
+        for (const auto &pair : it->get_receiver_preferences()) {
+            auto found = worker_index.find(pair.first);
+            if (found != worker_index.end()) {
+                external[found->second] += rate * pair.second;
+            }
+        }
+    }
+
+    // Sparse incoming links between workers: (source worker, probability)
+    std::vector<std::vector<std::pair<std::size_t, double>>> incoming(n);
+    std::size_t k = 0;
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it, ++k) {
+        for (const auto &pair : it->get_receiver_preferences()) {
+            auto found = worker_index.find(pair.first);
+            if (found != worker_index.end()) {
+                incoming[found->second].emplace_back(k, pair.second);
+            }
+        }
+    }
+
+    // Gauss-Seidel iterations on the traffic equations
+    std::vector<double> lambda(external);
+    auto departure = [&](std::size_t i) {
+        return std::min(lambda[i], estimate.workers[i].service_rate);
+    };
+
+    for (std::size_t iter = 0; iter < options.max_iterations; ++iter) {
+        double max_change = 0.0;
+        for (std::size_t j = 0; j < n; ++j) {
+            double value = external[j];
+            for (const auto &link : incoming[j]) {
+                value += departure(link.first) * link.second;
+            }
+            max_change = std::max(max_change, std::fabs(value - lambda[j]));
+            lambda[j] = value;
+        }
+        estimate.iterations = iter + 1;
+        if (max_change <= options.tolerance) {
+            estimate.converged = true;
+            break;
+        }
+    }
+
+    // Per-worker metrics (M/D/1 approximation of the queue)
+    for (std::size_t i = 0; i < n; ++i) {
+        WorkerEstimate &w = estimate.workers[i];
+        w.arrival_rate = lambda[i];
+        w.utilization = w.arrival_rate / w.service_rate;
+        w.saturated = w.utilization >= 1.0;
+        if (w.saturated) {
+            w.mean_queue_length = std::numeric_limits<double>::infinity();
+            w.mean_waiting_time = std::numeric_limits<double>::infinity();
+            w.queue_growth_rate = w.arrival_rate - w.service_rate;
+        } else if (w.arrival_rate > 0.0) {
+            double rho = w.utilization;
+            w.mean_queue_length = rho * rho / (2.0 * (1.0 - rho));
+            w.mean_waiting_time = w.mean_queue_length / w.arrival_rate;
+        }
+    }
+
+    // Storehouse inflow from ramps and workers
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        double rate = 1.0 / std::max<TimeOffset>(it->get_delivery_interval(), 1);
+        for (const auto &pair : it->get_receiver_preferences()) {
+            auto found = storehouse_index.find(pair.first);
+            if (found != storehouse_index.end()) {
+                estimate.storehouses[found->second].arrival_rate +=
+                    rate * pair.second;
+            }
+        }
+    }
+    k = 0;
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it, ++k) {
+        for (const auto &pair : it->get_receiver_preferences()) {
+            auto found = storehouse_index.find(pair.first);
+            if (found != storehouse_index.end()) {
+                estimate.storehouses[found->second].arrival_rate +=
+                    departure(k) * pair.second;
+            }
+        }
+    }
+
+    return estimate;
+}
+
+} // namespace NetSim
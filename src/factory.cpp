@@ -1,4 +1,5 @@
 #include "../include/factory.hpp"
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 
@@ -7,28 +8,347 @@ enum class NodeColor { UNVISITED, VISITED, VERIFIED };
 
 // FACTORY IMPLEMENTATION
 
-// bool has_reachable_storehouse() {}
+Factory::Factory()
+    : pool_(std::make_unique<std::pmr::unsynchronized_pool_resource>()),
+      resource_(pool_.get()),
+      memory_(std::make_unique<MemoryAccounts>(resource_)),
+      packages_(std::make_unique<PackageTable>(get_memory_resource())),
+      ramps_(get_memory_resource(MemoryCategory::NODE_LISTS)),
+      workers_(get_memory_resource(MemoryCategory::NODE_LISTS)),
+      storehouses_(get_memory_resource(MemoryCategory::NODE_LISTS)) {}
 
-// bool Factory::is_consistent() {
-//     std::map<PackageSender *, NodeColor> node_colors;
+Factory::Factory(std::pmr::memory_resource *resource)
+    : resource_(resource), memory_(std::make_unique<MemoryAccounts>(resource_)),
+      packages_(std::make_unique<PackageTable>(get_memory_resource())),
+      ramps_(get_memory_resource(MemoryCategory::NODE_LISTS)),
+      workers_(get_memory_resource(MemoryCategory::NODE_LISTS)),
+      storehouses_(get_memory_resource(MemoryCategory::NODE_LISTS)) {}
 
-//     // Initializing colors for Workers and Ramps - all sending nodes
-//     for (const auto &ramp : ramps_) {
-//         node_colors[&ramp] = NodeColor::UNVISITED;
-//     }
-//     for (const auto &worker : workers_) {
-//         node_colors[&worker] = NodeColor::UNVISITED;
-//     }
+namespace {
 
-//     try {
-//         for (const auto &ramp : ramps_) {
-//             has_reachable_storehouse(&ramp, node_colors);
-//         }
-//     } catch (const std::logic_error &e) {
-//         return false;
-//     }
+/**
+ * @brief DFS step of the consistency check
+ * Throws std::logic_error when the sender cannot reach any storehouse
+ */
+bool has_reachable_storehouse(
+    const PackageSender *sender,
+    std::map<const PackageSender *, NodeColor> &node_colors) {
+    if (node_colors[sender] == NodeColor::VERIFIED) {
+        return true;
+    }
+    node_colors[sender] = NodeColor::VISITED;
 
-//     return true;
-// }
+    if (sender->get_receiver_preferences().get_preferences().empty()) {
+        throw std::logic_error("Sender has no receivers.");
+    }
 
-} // namespace NetSim
\ No newline at end of file
+    bool has_other_receiver = false;
+    for (const auto &pair : sender->get_receiver_preferences()) {
+        IPackageReceiver *receiver = pair.first;
+        if (receiver->get_receiver_type() == ReceiverType::STOREHOUSE) {
+            has_other_receiver = true;
+        } else if (receiver->get_receiver_type() == ReceiverType::WORKER) {
+            // Worker is both a receiver and a sender
+            const PackageSender *next_sender =
+                dynamic_cast<const PackageSender *>(receiver);
+            if (next_sender == sender) {
+                continue; // link to itself does not lead anywhere
+            }
+            has_other_receiver = true;
+            if (node_colors[next_sender] == NodeColor::UNVISITED) {
+                has_reachable_storehouse(next_sender, node_colors);
+            }
+        }
+    }
+
+    node_colors[sender] = NodeColor::VERIFIED;
+
+    if (!has_other_receiver) {
+        throw std::logic_error("Sender has no reachable storehouse.");
+    }
+    return true;
+}
+
+} // namespace
+
+bool Factory::is_consistent() {
+    std::map<const PackageSender *, NodeColor> node_colors;
+
+    // Initializing colors for Workers and Ramps - all sending nodes
+    for (const auto &ramp : ramps_) {
+        node_colors[&ramp] = NodeColor::UNVISITED;
+    }
+    for (const auto &worker : workers_) {
+        node_colors[&worker] = NodeColor::UNVISITED;
+    }
+
+    try {
+        for (const auto &ramp : ramps_) {
+            has_reachable_storehouse(&ramp, node_colors);
+        }
+    } catch (const std::logic_error &e) {
+        return false;
+    }
+
+    return true;
+}
+
+void Factory::do_deliveries(Time t) {
+    for (auto &ramp : ramps_) {
+        ramp.deliver_goods(t);
+    }
+}
+
+void Factory::do_package_passing() {
+    if (active_.enabled) {
+        if (active_.dirty) {
+            rebuild_active_sets();
+        }
+        for (auto &ramp : ramps_) {
+            ramp.send_package(); // receivers are told by the package table
+        }
+        // Buffers fill only in do_work, so the set doesn't grow meanwhile
+        std::sort(active_.sending.begin(), active_.sending.end());
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < active_.sending.size(); ++i) {
+            std::size_t slot = active_.sending[i];
+            Worker *worker = active_.workers[slot];
+            worker->send_package();
+            if (worker->get_sending_buffer()) {
+                active_.sending[kept++] = slot; // receiver full
+            } else {
+                active_.is_sending[slot] = 0;
+            }
+        }
+        active_.sending.resize(kept);
+        return;
+    }
+
+    for (auto &ramp : ramps_) {
+        ramp.send_package();
+    }
+    for (auto &worker : workers_) {
+        worker.send_package();
+    }
+}
+
+void Factory::do_work(Time t) {
+    if (active_.enabled) {
+        if (active_.dirty || t <= active_.last_work_round) {
+            rebuild_active_sets(); // round numbers started again
+        }
+        wake_received(); // passed on, or received from outside
+        active_.last_work_round = t;
+        while (!active_.wakeups.empty() && active_.wakeups.top().first <= t) {
+            auto [round, slot] = active_.wakeups.top();
+            active_.wakeups.pop();
+            if (active_.wake_round[slot] == round) {
+                active_.wake_round[slot] = 0;
+                mark_working(slot);
+            }
+        }
+
+        active_.stepped.swap(active_.working);
+        std::sort(active_.stepped.begin(), active_.stepped.end());
+        for (std::size_t slot : active_.stepped) {
+            Worker *worker = active_.workers[slot];
+            active_.is_working[slot] = 0;
+            worker->do_work(t);
+
+            if (worker->get_sending_buffer() && !active_.is_sending[slot]) {
+                active_.is_sending[slot] = 1;
+                active_.sending.push_back(slot);
+            }
+            if (const IWorkerBehaviour *behaviour = worker->get_behaviour()) {
+                Time wake = behaviour->get_wake_round(); // 0 - a package
+                if (wake != 0 && wake <= t + 1) {
+                    mark_working(slot);
+                } else if (wake > t + 1 && active_.wake_round[slot] != wake) {
+                    active_.wake_round[slot] = wake;
+                    active_.wakeups.emplace(wake, slot);
+                }
+            } else if (worker->get_processing_buffer()) {
+                Time done = worker->get_product_processing_start_time() +
+                            worker->get_processing_duration() - 1;
+                if (done <= t + 1) {
+                    mark_working(slot); // finishes next round (or blocked)
+                } else if (active_.wake_round[slot] != done) {
+                    active_.wake_round[slot] = done;
+                    active_.wakeups.emplace(done, slot);
+                }
+            } else if (!worker->get_queue()->empty()) {
+                mark_working(slot);
+            }
+        }
+        active_.stepped.clear();
+        return;
+    }
+
+    for (auto &worker : workers_) {
+        worker.do_work(t);
+    }
+}
+
+void Factory::set_active_stepping(bool enabled) {
+    active_ = ActiveSets();
+    active_.enabled = enabled;
+    if (enabled && !received_) {
+        received_ = std::make_unique<ReceivedWorkers>();
+    }
+    packages_->set_receive_listener(enabled ? received_.get() : nullptr);
+}
+
+void Factory::rebuild_active_sets() {
+    active_ = ActiveSets();
+    active_.enabled = true;
+    active_.dirty = false;
+    received_->workers.clear(); // the node state has them already
+
+    for (auto &worker : workers_) {
+        active_.slots.emplace(&worker, active_.workers.size());
+        active_.workers.push_back(&worker);
+    }
+    std::size_t n = active_.workers.size();
+    active_.is_sending.assign(n, 0);
+    active_.is_working.assign(n, 0);
+    active_.wake_round.assign(n, 0);
+
+    for (std::size_t slot = 0; slot < n; ++slot) {
+        const Worker *worker = active_.workers[slot];
+        if (worker->get_sending_buffer()) {
+            active_.is_sending[slot] = 1;
+            active_.sending.push_back(slot);
+        }
+        if (worker->get_processing_buffer() || !worker->get_queue()->empty() ||
+            worker->get_behaviour()) {
+            mark_working(slot); // the first do_work schedules busy ones
+        }
+    }
+}
+
+void Factory::mark_working(std::size_t slot) {
+    if (!active_.is_working[slot]) {
+        active_.is_working[slot] = 1;
+        active_.working.push_back(slot);
+    }
+}
+
+void Factory::wake_received() {
+    for (const IPackageReceiver *receiver : received_->workers) {
+        auto it = active_.slots.find(receiver);
+        if (it != active_.slots.end()) {
+            mark_working(it->second);
+        }
+    }
+    received_->workers.clear();
+}
+
+template <typename Node>
+void Factory::remove_receiver(NodeCollection<Node> &collection, ElementID id) {
+    auto it = collection.find_by_id(id);
+    if (it == collection.end()) {
+        return;
+    }
+    IPackageReceiver *receiver = &(*it);
+
+    // Both ramps and workers may point at the removed receiver
+    for (auto &ramp : ramps_) {
+        ramp.get_receiver_preferences().remove_receiver(receiver);
+    }
+    for (auto &worker : workers_) {
+        worker.get_receiver_preferences().remove_receiver(receiver);
+    }
+}
+
+void Factory::remove_worker(ElementID id) {
+    remove_receiver(workers_, id);
+    workers_.remove_by_id(id);
+    active_.dirty = true;
+}
+
+void Factory::remove_storehouse(ElementID id) {
+    remove_receiver(storehouses_, id);
+    storehouses_.remove_by_id(id);
+}
+
+NodeCollection<Ramp>::container_t Factory::extract_ramp(ElementID id) {
+    auto extracted = ramps_.extract_by_id(id);
+    for (auto &ramp : extracted) { // may outlive the Factory
+        ramp.set_package_table(default_package_table());
+    }
+    return extracted;
+}
+
+NodeCollection<Worker>::container_t Factory::extract_worker(ElementID id) {
+    remove_receiver(workers_, id);
+    active_.dirty = true;
+    auto extracted = workers_.extract_by_id(id);
+    for (auto &worker : extracted) {
+        worker.set_package_table(default_package_table());
+    }
+    return extracted;
+}
+
+NodeCollection<Storehouse>::container_t
+Factory::extract_storehouse(ElementID id) {
+    remove_receiver(storehouses_, id);
+    auto extracted = storehouses_.extract_by_id(id);
+    for (auto &storehouse : extracted) {
+        storehouse.set_package_table(default_package_table());
+    }
+    return extracted;
+}
+
+void Factory::reorder_nodes(const std::vector<ElementID> &workers,
+                            const std::vector<ElementID> &storehouses) {
+    workers_.check_unique_ids(); // before either list is moved
+    storehouses_.check_unique_ids();
+    auto old_workers = workers_.relocate(workers);
+    auto old_storehouses = storehouses_.relocate(storehouses);
+    active_.dirty = true;
+    for (auto &worker : workers_) { // queues in the same order as workers
+        worker.relocate_queue();
+    }
+
+    // Old node -> its new place (IDs are unique within a type)
+    std::map<const IPackageReceiver *, IPackageReceiver *> moved;
+    std::map<ElementID, IPackageReceiver *> by_id;
+    for (auto &worker : workers_) {
+        by_id[worker.get_id()] = &worker;
+    }
+    for (auto &worker : old_workers) {
+        moved[&worker] = by_id.at(worker.get_id());
+    }
+    by_id.clear();
+    for (auto &storehouse : storehouses_) {
+        by_id[storehouse.get_id()] = &storehouse;
+    }
+    for (auto &storehouse : old_storehouses) {
+        moved[&storehouse] = by_id.at(storehouse.get_id());
+    }
+
+    // Old nodes are still alive, so the maps can compare them while the
+    // links are replaced
+    std::vector<IPackageReceiver *> receivers;
+    auto update_links = [&](PackageSender &sender) {
+        ReceiverPreferences &prefs = sender.get_receiver_preferences();
+        receivers.clear();
+        for (const auto &pair : prefs) {
+            receivers.push_back(pair.first);
+        }
+        for (IPackageReceiver *receiver : receivers) {
+            auto it = moved.find(receiver);
+            if (it != moved.end()) {
+                prefs.replace_receiver(receiver, it->second);
+            }
+        }
+    };
+    for (auto &ramp : ramps_) {
+        update_links(ramp);
+    }
+    for (auto &worker : workers_) {
+        update_links(worker);
+    }
+}
+
+} // namespace NetSim
@@ -0,0 +1,279 @@
+#include "../include/factory_image.hpp"
+#include "../include/routing_policies.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace NetSim {
+
+namespace {
+const char IMAGE_MAGIC[8] = {'N', 'E', 'T', 'S', 'I', 'M', 'I', 'M'};
+const std::uint32_t IMAGE_VERSION = 1;
+const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+std::uint64_t align8(std::uint64_t offset) { return (offset + 7) & ~7ULL; }
+
+void write_section(std::ofstream &out, const void *data, std::size_t bytes) {
+    out.write(static_cast<const char *>(data),
+              static_cast<std::streamsize>(bytes));
+    static const char padding[8] = {};
+    out.write(padding, static_cast<std::streamsize>(align8(bytes) - bytes));
+}
+} // namespace
+
+// WRITING
+
+void write_factory_image(Factory &f, const std::string &path) {
+    if (!f.is_consistent()) {
+        throw std::logic_error("Net is not consistent.");
+    }
+    if (uses_routing_policies(f)) { // policies are code, not data
+        throw std::logic_error("Factory image can't store routing policies.");
+    }
+
+    std::vector<RampRecord> ramps;
+    std::vector<WorkerRecord> workers;
+    std::vector<StorehouseRecord> storehouses;
+    std::map<const IPackageReceiver *, std::uint32_t> receiver_index;
+
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        if (it->get_behaviour()) {
+            throw std::logic_error("Factory image can't store behaviours.");
+        }
+        receiver_index[&*it] = static_cast<std::uint32_t>(workers.size());
+        workers.push_back(
+            {it->get_id(), it->get_processing_duration(),
+             static_cast<std::uint32_t>(it->get_queue()->get_queue_type()),
+             static_cast<std::uint32_t>(it->get_queue_capacity())});
+    }
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        receiver_index[&*it] =
+            static_cast<std::uint32_t>(workers.size() + storehouses.size());
+        storehouses.push_back({it->get_id()});
+    }
+
+    std::vector<std::uint64_t> link_offsets{0};
+    std::vector<std::uint32_t> link_receivers;
+    std::vector<double> link_weights;
+    auto add_links = [&](const PackageSender &sender) {
+        for (const auto &pair : sender.get_receiver_preferences()) {
+            link_receivers.push_back(receiver_index.at(pair.first));
+            link_weights.push_back(pair.second);
+        }
+        link_offsets.push_back(link_receivers.size());
+    };
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        ramps.push_back({it->get_id(), it->get_delivery_interval()});
+        add_links(*it);
+    }
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        add_links(*it);
+    }
+
+    FactoryImageHeader header{};
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.n_ramps = ramps.size();
+    header.n_workers = workers.size();
+    header.n_storehouses = storehouses.size();
+    header.n_links = link_receivers.size();
+
+    std::uint64_t offset = align8(sizeof(FactoryImageHeader));
+    auto place = [&offset](std::uint64_t bytes) {
+        std::uint64_t start = offset;
+        offset += align8(bytes);
+        return start;
+    };
+    header.ramps_offset = place(ramps.size() * sizeof(RampRecord));
+    header.workers_offset = place(workers.size() * sizeof(WorkerRecord));
+    header.storehouses_offset =
+        place(storehouses.size() * sizeof(StorehouseRecord));
+    header.link_offsets_offset =
+        place(link_offsets.size() * sizeof(std::uint64_t));
+    header.link_receivers_offset =
+        place(link_receivers.size() * sizeof(std::uint32_t));
+    header.link_weights_offset = place(link_weights.size() * sizeof(double));
+    header.file_size = offset;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot write factory image: " + path);
+    }
+    write_section(out, &header, sizeof(header));
+    write_section(out, ramps.data(), ramps.size() * sizeof(RampRecord));
+    write_section(out, workers.data(), workers.size() * sizeof(WorkerRecord));
+    write_section(out, storehouses.data(),
+                  storehouses.size() * sizeof(StorehouseRecord));
+    write_section(out, link_offsets.data(),
+                  link_offsets.size() * sizeof(std::uint64_t));
+    write_section(out, link_receivers.data(),
+                  link_receivers.size() * sizeof(std::uint32_t));
+    write_section(out, link_weights.data(),
+                  link_weights.size() * sizeof(double));
+    if (!out) {
+        throw std::runtime_error("Cannot write factory image: " + path);
+    }
+}
+
+// MAPPING
+
+FactoryImage::FactoryImage(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open factory image: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(FactoryImageHeader)) {
+        close(fd);
+        throw std::runtime_error("Not a factory image: " + path);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // mapping stays valid
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Cannot map factory image: " + path);
+    }
+    data_ = static_cast<const unsigned char *>(mapped);
+    header_ = section<FactoryImageHeader>(0);
+
+    // Everything below only reads inside the mapping
+    const FactoryImageHeader &h = *header_;
+    std::uint64_t n_senders = h.n_ramps + h.n_workers;
+    std::uint64_t n_receivers = h.n_workers + h.n_storehouses;
+    auto fits = [this](std::uint64_t offset, std::uint64_t count,
+                       std::uint64_t item_size) {
+        return offset % 8 == 0 && offset <= size_ &&
+               count <= (size_ - offset) / item_size;
+    };
+    bool valid =
+        std::memcmp(h.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) == 0 &&
+        h.version == IMAGE_VERSION && h.byte_order == BYTE_ORDER_MARK &&
+        h.file_size == size_ &&
+        fits(h.ramps_offset, h.n_ramps, sizeof(RampRecord)) &&
+        fits(h.workers_offset, h.n_workers, sizeof(WorkerRecord)) &&
+        fits(h.storehouses_offset, h.n_storehouses, sizeof(StorehouseRecord)) &&
+        n_senders >= h.n_ramps &&
+        fits(h.link_offsets_offset, n_senders + 1, sizeof(std::uint64_t)) &&
+        fits(h.link_receivers_offset, h.n_links, sizeof(std::uint32_t)) &&
+        fits(h.link_weights_offset, h.n_links, sizeof(double));
+
+    if (valid) {
+        const std::uint64_t *offsets = link_offsets();
+        valid = offsets[0] == 0 && offsets[n_senders] == h.n_links;
+        for (std::uint64_t s = 0; valid && s < n_senders; ++s) {
+            valid = offsets[s] <= offsets[s + 1];
+        }
+        const std::uint32_t *receivers = link_receivers();
+        for (std::uint64_t l = 0; valid && l < h.n_links; ++l) {
+            valid = receivers[l] < n_receivers;
+        }
+    }
+    // Values the nodes divide by or cast to an enum
+    for (std::uint64_t r = 0; valid && r < h.n_ramps; ++r) {
+        valid = ramps()[r].delivery_interval > 0;
+    }
+    for (std::uint64_t w = 0; valid && w < h.n_workers; ++w) {
+        const WorkerRecord &record = workers()[w];
+        valid = record.processing_duration > 0 &&
+                (record.queue_type ==
+                     static_cast<std::uint32_t>(PackageQueueType::FIFO) ||
+                 record.queue_type ==
+                     static_cast<std::uint32_t>(PackageQueueType::LIFO));
+    }
+    if (!valid) {
+        munmap(const_cast<unsigned char *>(data_), size_);
+        throw std::runtime_error("Malformed factory image: " + path);
+    }
+}
+
+FactoryImage::~FactoryImage() {
+    munmap(const_cast<unsigned char *>(data_), size_);
+}
+
+const RampRecord *FactoryImage::ramps() const {
+    return section<RampRecord>(header_->ramps_offset);
+}
+const WorkerRecord *FactoryImage::workers() const {
+    return section<WorkerRecord>(header_->workers_offset);
+}
+const StorehouseRecord *FactoryImage::storehouses() const {
+    return section<StorehouseRecord>(header_->storehouses_offset);
+}
+const std::uint64_t *FactoryImage::link_offsets() const {
+    return section<std::uint64_t>(header_->link_offsets_offset);
+}
+const std::uint32_t *FactoryImage::link_receivers() const {
+    return section<std::uint32_t>(header_->link_receivers_offset);
+}
+const double *FactoryImage::link_weights() const {
+    return section<double>(header_->link_weights_offset);
+}
+
+// LOADING
+
+void load_factory_image(Factory &f, const FactoryImage &image) {
+    if (f.ramp_cbegin() != f.ramp_cend() ||
+        f.worker_cbegin() != f.worker_cend() ||
+        f.storehouse_cbegin() != f.storehouse_cend()) {
+        throw std::logic_error("Factory must be empty.");
+    }
+    const FactoryImageHeader &h = image.get_header();
+    std::pmr::memory_resource *queues =
+        f.get_memory_resource(MemoryCategory::QUEUES);
+    std::pmr::memory_resource *stockpiles =
+        f.get_memory_resource(MemoryCategory::STOCKPILES);
+
+    // Receiver index -> pointer (the fix-up table)
+    std::vector<IPackageReceiver *> receivers;
+    receivers.reserve(h.n_workers + h.n_storehouses);
+    std::vector<PackageSender *> senders;
+    senders.reserve(h.n_ramps + h.n_workers);
+
+    for (std::uint64_t r = 0; r < h.n_ramps; ++r) {
+        const RampRecord &record = image.ramps()[r];
+        f.add_ramp(Ramp(record.id, record.delivery_interval));
+        senders.push_back(&*std::prev(f.ramp_end()));
+    }
+    for (std::uint64_t w = 0; w < h.n_workers; ++w) {
+        const WorkerRecord &record = image.workers()[w];
+        f.add_worker(Worker(record.id, record.processing_duration,
+                            std::make_unique<PackageQueue>(
+                                static_cast<PackageQueueType>(record.queue_type),
+                                queues)));
+        Worker *worker = &*std::prev(f.worker_end());
+        worker->set_queue_capacity(record.queue_capacity);
+        receivers.push_back(worker);
+    }
+    for (std::uint64_t s = 0; s < h.n_storehouses; ++s) {
+        f.add_storehouse(Storehouse(
+            image.storehouses()[s].id,
+            std::make_unique<PackageQueue>(PackageQueueType::FIFO,
+                                           stockpiles)));
+        receivers.push_back(&*std::prev(f.storehouse_end()));
+    }
+    for (auto it = f.worker_begin(); it != f.worker_end(); ++it) {
+        senders.push_back(&*it);
+    }
+
+    const std::uint64_t *offsets = image.link_offsets();
+    for (std::size_t s = 0; s < senders.size(); ++s) {
+        ReceiverPreferences &prefs = senders[s]->get_receiver_preferences();
+        for (std::uint64_t l = offsets[s]; l < offsets[s + 1]; ++l) {
+            prefs.add_receiver(receivers[image.link_receivers()[l]],
+                               image.link_weights()[l]);
+        }
+    }
+}
+
+} // namespace NetSim
@@ -3,6 +3,7 @@
 #include "../include/helpers.hpp"
 
 #include <cstdlib>
+#include <memory>
 #include <random>
 
 namespace NetSim {
@@ -16,4 +17,24 @@ double default_probability_generator() {
 
 // Initializing global variable being a function
 ProbabilityGenerator probability_generator = default_probability_generator;
+
+std::uint64_t stream_seed(std::uint64_t seed, std::uint64_t stream) {
+  // splitmix64 step - decorrelates neighbouring stream numbers
+  std::uint64_t z = seed + 0x9E3779B97F4A7C15ULL * (stream + 1);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+ProbabilityGenerator make_stream_generator(std::uint64_t seed,
+                                           std::uint64_t stream,
+                                           bool antithetic) {
+  auto engine = std::make_shared<std::mt19937_64>(stream_seed(seed, stream));
+  if (antithetic) {
+    return [engine]() {
+      return 1.0 - std::generate_canonical<double, 10>(*engine);
+    };
+  }
+  return [engine]() { return std::generate_canonical<double, 10>(*engine); };
+}
 } // namespace NetSim
\ No newline at end of file
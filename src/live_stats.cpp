@@ -0,0 +1,189 @@
+#include "../include/live_stats.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+namespace NetSim {
+
+static_assert(std::atomic<std::int64_t>::is_always_lock_free &&
+                  std::atomic<std::uint64_t>::is_always_lock_free &&
+                  std::atomic<double>::is_always_lock_free,
+              "Shared memory counters must be lock-free atomics.");
+
+// PUBLISHER
+
+LiveStatsPublisher::LiveStatsPublisher(const std::string &name,
+                                       std::uint32_t capacity,
+                                       Time publish_every)
+    : name_(name), size_(LiveStatsSegment::size_for(capacity)),
+      publish_every_(publish_every > 0 ? publish_every : 1) {
+    int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create shared memory: " + name_);
+    }
+    if (ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+        close(fd);
+        shm_unlink(name_.c_str());
+        throw std::runtime_error("Cannot resize shared memory: " + name_);
+    }
+    void *memory =
+        mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // mapping stays valid
+    if (memory == MAP_FAILED) {
+        shm_unlink(name_.c_str());
+        throw std::runtime_error("Cannot map shared memory: " + name_);
+    }
+
+    segment_ = new (memory) LiveStatsSegment{};
+    segment_->capacity = capacity;
+    for (std::uint32_t i = 0; i < 2 * capacity; ++i) {
+        new (segment_->workers() + i) LiveStatsSegment::NodeCounter{};
+    }
+    // Magic written last - readers accept only a fully set up segment
+    std::atomic_thread_fence(std::memory_order_release);
+    segment_->magic = LiveStatsSegment::MAGIC;
+
+    last_time_ = std::chrono::steady_clock::now();
+}
+
+LiveStatsPublisher::~LiveStatsPublisher() {
+    munmap(segment_, size_);
+    shm_unlink(name_.c_str());
+}
+
+void LiveStatsPublisher::publish(const Factory &f, Time t) {
+    if (t % publish_every_ != 0) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - last_time_).count();
+
+    LiveStatsSegment &s = *segment_;
+    std::uint64_t seq = s.sequence.load(std::memory_order_relaxed);
+    s.sequence.store(seq + 1, std::memory_order_relaxed); // odd - writing
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s.round.store(t, std::memory_order_relaxed);
+    if (seconds > 0.0) {
+        s.rounds_per_second.store((t - last_round_) / seconds,
+                                  std::memory_order_relaxed);
+    }
+
+    std::uint32_t truncated = 0;
+    std::uint32_t n = 0;
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        if (n == s.capacity) {
+            truncated = 1;
+            break;
+        }
+        s.workers()[n].id.store(it->get_id(), std::memory_order_relaxed);
+        s.workers()[n].value.store(
+            static_cast<std::int64_t>(it->get_queue()->size()),
+            std::memory_order_relaxed);
+        ++n;
+    }
+    s.n_workers.store(n, std::memory_order_relaxed);
+
+    n = 0;
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        if (n == s.capacity) {
+            truncated = 1;
+            break;
+        }
+        s.storehouses()[n].id.store(it->get_id(), std::memory_order_relaxed);
+        s.storehouses()[n].value.store(
+            static_cast<std::int64_t>(it->get_stockpile()->size()),
+            std::memory_order_relaxed);
+        ++n;
+    }
+    s.n_storehouses.store(n, std::memory_order_relaxed);
+    s.truncated.store(truncated, std::memory_order_relaxed);
+
+    s.sequence.store(seq + 2, std::memory_order_release); // even - done
+
+    last_time_ = now;
+    last_round_ = t;
+}
+
+// READER
+
+LiveStatsReader::LiveStatsReader(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw std::runtime_error("No live statistics segment: " + name);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 ||
+        static_cast<std::size_t>(info.st_size) < sizeof(LiveStatsSegment)) {
+        close(fd);
+        throw std::runtime_error("Live statistics segment not ready: " + name);
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+
+    void *memory = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("Cannot map shared memory: " + name);
+    }
+    segment_ = static_cast<LiveStatsSegment *>(memory);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (segment_->magic != LiveStatsSegment::MAGIC ||
+        LiveStatsSegment::size_for(segment_->capacity) > size_) {
+        munmap(memory, size_);
+        throw std::runtime_error("Invalid live statistics segment: " + name);
+    }
+}
+
+LiveStatsReader::~LiveStatsReader() { munmap(segment_, size_); }
+
+bool LiveStatsReader::read(LiveStatsSnapshot &snapshot,
+                           int max_retries) const {
+    LiveStatsSegment &s = *segment_;
+
+    for (int attempt = 0; attempt < max_retries; ++attempt) {
+        std::uint64_t before = s.sequence.load(std::memory_order_acquire);
+        if (before % 2 == 1) {
+            continue; // writer in progress
+        }
+
+        snapshot.round = s.round.load(std::memory_order_relaxed);
+        snapshot.rounds_per_second =
+            s.rounds_per_second.load(std::memory_order_relaxed);
+        snapshot.truncated = s.truncated.load(std::memory_order_relaxed) != 0;
+
+        std::uint32_t n_workers =
+            std::min(s.n_workers.load(std::memory_order_relaxed), s.capacity);
+        snapshot.worker_queues.resize(n_workers);
+        for (std::uint32_t i = 0; i < n_workers; ++i) {
+            snapshot.worker_queues[i] = {
+                s.workers()[i].id.load(std::memory_order_relaxed),
+                s.workers()[i].value.load(std::memory_order_relaxed)};
+        }
+
+        std::uint32_t n_storehouses = std::min(
+            s.n_storehouses.load(std::memory_order_relaxed), s.capacity);
+        snapshot.storehouse_totals.resize(n_storehouses);
+        for (std::uint32_t i = 0; i < n_storehouses; ++i) {
+            snapshot.storehouse_totals[i] = {
+                s.storehouses()[i].id.load(std::memory_order_relaxed),
+                s.storehouses()[i].value.load(std::memory_order_relaxed)};
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.sequence.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace NetSim
@@ -0,0 +1,183 @@
+#include "../include/locality.hpp"
+
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <set>
+
+namespace NetSim {
+
+namespace {
+const Worker *as_worker(const IPackageReceiver *receiver) {
+    return receiver->get_receiver_type() == ReceiverType::WORKER
+               ? dynamic_cast<const Worker *>(receiver)
+               : nullptr;
+}
+
+/**
+ * @brief Workers in BFS order from the ramps, unreachable ones at the end
+ */
+std::vector<const Worker *> bfs_workers(const Factory &f) {
+    std::vector<const Worker *> order;
+    std::set<const IPackageReceiver *> visited;
+    std::queue<const Worker *> to_visit;
+
+    auto visit_links = [&](const PackageSender &sender) {
+        for (const auto &pair : sender.get_receiver_preferences()) {
+            const Worker *worker = as_worker(pair.first);
+            if (worker && visited.insert(worker).second) {
+                to_visit.push(worker);
+            }
+        }
+    };
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        visit_links(*it);
+        while (!to_visit.empty()) {
+            const Worker *worker = to_visit.front();
+            to_visit.pop();
+            order.push_back(worker);
+            visit_links(*worker);
+        }
+    }
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        if (!visited.count(&*it)) {
+            order.push_back(&*it);
+        }
+    }
+    return order;
+}
+
+/**
+ * @brief Workers depth-first from the ramps, the most probable receiver
+ * first, so every worker is followed by its main consumer (if not placed
+ * yet); unreachable ones at the end
+ */
+std::vector<const Worker *> chain_workers(const Factory &f) {
+    std::vector<const Worker *> order;
+    std::set<const IPackageReceiver *> visited;
+    std::vector<const Worker *> stack;
+    std::vector<std::pair<double, const Worker *>> next;
+
+    auto push_links = [&](const PackageSender &sender) {
+        next.clear();
+        for (const auto &pair : sender.get_receiver_preferences()) {
+            const Worker *worker = as_worker(pair.first);
+            if (worker && !visited.count(worker)) {
+                next.emplace_back(pair.second, worker);
+            }
+        }
+        // Least probable pushed first, so the main consumer is popped next
+        std::stable_sort(next.begin(), next.end(),
+                         [](const auto &a, const auto &b) {
+                             return a.first > b.first;
+                         });
+        for (auto it = next.rbegin(); it != next.rend(); ++it) {
+            stack.push_back(it->second);
+        }
+    };
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        push_links(*it);
+        while (!stack.empty()) {
+            const Worker *worker = stack.back();
+            stack.pop_back();
+            if (!visited.insert(worker).second) {
+                continue;
+            }
+            order.push_back(worker);
+            push_links(*worker);
+        }
+    }
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        if (!visited.count(&*it)) {
+            order.push_back(&*it);
+        }
+    }
+    return order;
+}
+
+/**
+ * @brief Kahn's algorithm over worker links, ready workers taken in BFS
+ * order; workers left in cycles follow in BFS order
+ */
+std::vector<const Worker *>
+topological_workers(const std::vector<const Worker *> &bfs) {
+    std::map<const IPackageReceiver *, std::size_t> in_degree;
+    for (const Worker *worker : bfs) {
+        in_degree.emplace(worker, 0);
+    }
+    for (const Worker *worker : bfs) {
+        for (const auto &pair : worker->get_receiver_preferences()) {
+            if (as_worker(pair.first)) {
+                ++in_degree[pair.first];
+            }
+        }
+    }
+
+    std::vector<const Worker *> order;
+    std::set<const Worker *> placed;
+    std::queue<const Worker *> ready;
+    for (const Worker *worker : bfs) {
+        if (in_degree[worker] == 0) {
+            ready.push(worker);
+        }
+    }
+    while (!ready.empty()) {
+        const Worker *worker = ready.front();
+        ready.pop();
+        order.push_back(worker);
+        placed.insert(worker);
+        for (const auto &pair : worker->get_receiver_preferences()) {
+            const Worker *next = as_worker(pair.first);
+            if (next && --in_degree[next] == 0) {
+                ready.push(next);
+            }
+        }
+    }
+    for (const Worker *worker : bfs) {
+        if (!placed.count(worker)) {
+            order.push_back(worker);
+        }
+    }
+    return order;
+}
+} // namespace
+
+NodeLayout make_node_layout(const Factory &f, NodeOrder order) {
+    std::vector<const Worker *> workers =
+        order == NodeOrder::CHAINS ? chain_workers(f) : bfs_workers(f);
+    if (order == NodeOrder::TOPOLOGICAL) {
+        workers = topological_workers(workers);
+    }
+
+    // Storehouses in the order their first producer is stepped
+    NodeLayout layout;
+    std::set<const IPackageReceiver *> placed;
+    auto place_storehouses = [&](const PackageSender &sender) {
+        for (const auto &pair : sender.get_receiver_preferences()) {
+            if (pair.first->get_receiver_type() == ReceiverType::STOREHOUSE &&
+                placed.insert(pair.first).second) {
+                layout.storehouses.push_back(pair.first->get_id());
+            }
+        }
+    };
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        place_storehouses(*it);
+    }
+    for (const Worker *worker : workers) {
+        layout.workers.push_back(worker->get_id());
+        place_storehouses(*worker);
+    }
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        if (!placed.count(&*it)) {
+            layout.storehouses.push_back(it->get_id());
+        }
+    }
+    return layout;
+}
+
+void reorder_for_locality(Factory &f, NodeOrder order) {
+    NodeLayout layout = make_node_layout(f, order);
+    f.reorder_nodes(layout.workers, layout.storehouses);
+}
+
+} // namespace NetSim
@@ -0,0 +1,107 @@
+#include "../include/memory_accounting.hpp"
+#include "../include/package.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace NetSim {
+
+const char *memory_category_name(MemoryCategory category) {
+    switch (category) {
+    case MemoryCategory::NODE_LISTS:
+        return "node lists";
+    case MemoryCategory::PREFERENCES:
+        return "receiver preferences";
+    case MemoryCategory::QUEUES:
+        return "worker queues";
+    case MemoryCategory::STOCKPILES:
+        return "storehouse stockpiles";
+    case MemoryCategory::PACKAGE_IDS:
+        return "package IDs";
+    case MemoryCategory::OTHER:
+        return "other";
+    }
+    return "unknown";
+}
+
+// COUNTING RESOURCE
+
+CountingMemoryResource::CountingMemoryResource(
+    std::pmr::memory_resource *upstream, std::pmr::memory_resource *nested)
+    : upstream_(upstream), nested_(nested) {}
+
+void *CountingMemoryResource::do_allocate(std::size_t bytes,
+                                          std::size_t alignment) {
+    void *p = upstream_->allocate(bytes, alignment);
+    usage_.bytes += bytes;
+    ++usage_.blocks;
+    ++usage_.allocations;
+    usage_.peak_bytes = std::max(usage_.peak_bytes, usage_.bytes);
+    return p;
+}
+
+void CountingMemoryResource::do_deallocate(void *p, std::size_t bytes,
+                                           std::size_t alignment) {
+    upstream_->deallocate(p, bytes, alignment);
+    usage_.bytes -= bytes;
+    --usage_.blocks;
+}
+
+bool CountingMemoryResource::do_is_equal(
+    const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
+
+std::pmr::memory_resource *
+nested_resource(std::pmr::memory_resource *resource) {
+    auto *counting = dynamic_cast<CountingMemoryResource *>(resource);
+    return counting && counting->get_nested() ? counting->get_nested()
+                                              : resource;
+}
+
+// REPORT
+
+std::size_t MemoryReport::total_bytes() const {
+    std::size_t total = 0;
+    for (const auto &usage : categories) {
+        total += usage.bytes;
+    }
+    return total;
+}
+
+// FACTORY ACCOUNTS
+
+MemoryAccounts::MemoryAccounts(std::pmr::memory_resource *upstream)
+    : preferences_(upstream), node_lists_(upstream, &preferences_),
+      queues_(upstream), stockpiles_(upstream), other_(upstream) {}
+
+CountingMemoryResource *MemoryAccounts::get_resource(MemoryCategory category) {
+    switch (category) {
+    case MemoryCategory::NODE_LISTS:
+        return &node_lists_;
+    case MemoryCategory::PREFERENCES:
+        return &preferences_;
+    case MemoryCategory::QUEUES:
+        return &queues_;
+    case MemoryCategory::STOCKPILES:
+        return &stockpiles_;
+    case MemoryCategory::OTHER:
+        return &other_;
+    case MemoryCategory::PACKAGE_IDS:
+        break;
+    }
+    throw std::logic_error("Package IDs are not kept in Factory memory.");
+}
+
+MemoryReport MemoryAccounts::get_report() const {
+    MemoryReport report;
+    report[MemoryCategory::NODE_LISTS] = node_lists_.get_usage();
+    report[MemoryCategory::PREFERENCES] = preferences_.get_usage();
+    report[MemoryCategory::QUEUES] = queues_.get_usage();
+    report[MemoryCategory::STOCKPILES] = stockpiles_.get_usage();
+    report[MemoryCategory::PACKAGE_IDS] = Package::get_id_memory_usage();
+    report[MemoryCategory::OTHER] = other_.get_usage();
+    return report;
+}
+
+} // namespace NetSim
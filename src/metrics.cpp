@@ -0,0 +1,260 @@
+#include "../include/metrics.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace NetSim {
+
+namespace {
+const char FILE_MAGIC[4] = {'N', 'S', 'M', 'F'};
+const char BLOCK_MAGIC[4] = {'N', 'S', 'M', 'B'};
+constexpr std::uint8_t FORMAT_VERSION = 1;
+
+void put_varint(std::string &out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+std::uint64_t get_varint(const std::string &in, std::size_t &pos) {
+    std::uint64_t value = 0;
+    int shift = 0;
+    while (true) {
+        if (pos >= in.size()) {
+            throw std::runtime_error("Truncated metrics file.");
+        }
+        auto byte = static_cast<std::uint8_t>(in[pos++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+        shift += 7;
+    }
+}
+
+// Zigzag maps small negative deltas to small unsigned numbers
+std::uint64_t zigzag(std::int64_t v) {
+    return (static_cast<std::uint64_t>(v) << 1) ^
+           static_cast<std::uint64_t>(v >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t v) {
+    return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+void write_u32(std::ostream &os, std::uint32_t value) {
+    char bytes[4];
+    for (int i = 0; i < 4; ++i) {
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+    os.write(bytes, 4);
+}
+
+bool read_u32(std::istream &is, std::uint32_t &value) {
+    unsigned char bytes[4];
+    if (!is.read(reinterpret_cast<char *>(bytes), 4)) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<std::uint32_t>(bytes[i]) << (8 * i);
+    }
+    return true;
+}
+} // namespace
+
+// RECORDER
+
+MetricsRecorder::MetricsRecorder(const std::string &path,
+                                 const MetricsOptions &options)
+    : options_(options), out_(path, std::ios::binary) {
+    if (!out_) {
+        throw std::runtime_error("Cannot open metrics file: " + path);
+    }
+    if (options_.sample_every <= 0 || options_.block_rows == 0 ||
+        options_.block_bytes == 0) {
+        throw std::invalid_argument("Invalid metrics options.");
+    }
+}
+
+MetricsRecorder::~MetricsRecorder() { close(); }
+
+void MetricsRecorder::write_header(const Factory &f) {
+    columns_.push_back({MetricType::ROUND, 0});
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        columns_.push_back({MetricType::QUEUE_SIZE, it->get_id()});
+        columns_.push_back({MetricType::BUSY, it->get_id()});
+        columns_.push_back({MetricType::BUFFER_OCCUPANCY, it->get_id()});
+    }
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        columns_.push_back({MetricType::STOCK_SIZE, it->get_id()});
+    }
+
+    out_.write(FILE_MAGIC, 4);
+    out_.put(static_cast<char>(FORMAT_VERSION));
+    write_u32(out_, static_cast<std::uint32_t>(options_.sample_every));
+    write_u32(out_, static_cast<std::uint32_t>(columns_.size()));
+    for (const auto &column : columns_) {
+        out_.put(static_cast<char>(column.type));
+        write_u32(out_, static_cast<std::uint32_t>(column.node_id));
+    }
+
+    streams_.assign(columns_.size(), {});
+    header_written_ = true;
+}
+
+void MetricsRecorder::record(const Factory &f, Time t) {
+    if (closed_ || t % options_.sample_every != 0) {
+        return;
+    }
+    if (!header_written_) {
+        write_header(f);
+    }
+
+    std::size_t n_workers = static_cast<std::size_t>(
+        std::distance(f.worker_cbegin(), f.worker_cend()));
+    std::size_t n_storehouses = static_cast<std::size_t>(
+        std::distance(f.storehouse_cbegin(), f.storehouse_cend()));
+    if (1 + 3 * n_workers + n_storehouses != columns_.size()) {
+        throw std::logic_error("Net structure changed during recording.");
+    }
+
+    std::size_t c = 0;
+    auto append = [this, &c](std::int64_t value) {
+        ColumnStream &stream = streams_[c++];
+        std::size_t before = stream.encoded.size();
+        put_varint(stream.encoded, zigzag(value - stream.previous));
+        stream.previous = value;
+        block_size_ += stream.encoded.size() - before;
+    };
+    append(t);
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        append(static_cast<std::int64_t>(it->get_queue()->size()));
+        // A package finished this round counts, pd = 1 never stays in hand
+        bool busy = it->get_processing_buffer() ||
+                    it->get_product_processing_finish_time() == t;
+        append(busy ? 1 : 0);
+        append(it->get_sending_buffer() ? 1 : 0);
+    }
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        append(static_cast<std::int64_t>(it->get_stockpile()->size()));
+    }
+
+    if (++rows_ == options_.block_rows || block_size_ >= options_.block_bytes) {
+        write_block();
+    }
+}
+
+void MetricsRecorder::write_block() {
+    if (rows_ == 0) {
+        return;
+    }
+    out_.write(BLOCK_MAGIC, 4);
+    write_u32(out_, static_cast<std::uint32_t>(rows_));
+
+    for (auto &stream : streams_) {
+        write_u32(out_, static_cast<std::uint32_t>(stream.encoded.size()));
+        out_.write(stream.encoded.data(),
+                   static_cast<std::streamsize>(stream.encoded.size()));
+        stream.encoded.clear();
+        stream.previous = 0;
+    }
+    rows_ = 0;
+    block_size_ = 0;
+}
+
+void MetricsRecorder::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    write_block();
+    out_.close();
+}
+
+// READER
+
+MetricsReader::MetricsReader(const std::string &path)
+    : in_(path, std::ios::binary) {
+    char magic[4];
+    if (!in_.read(magic, 4) || !std::equal(magic, magic + 4, FILE_MAGIC)) {
+        throw std::runtime_error("Not a metrics file: " + path);
+    }
+    if (in_.get() != FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported metrics file version.");
+    }
+
+    std::uint32_t sample_every = 0;
+    std::uint32_t n_columns = 0;
+    read_u32(in_, sample_every);
+    read_u32(in_, n_columns);
+    sample_every_ = static_cast<Time>(sample_every);
+
+    for (std::uint32_t i = 0; i < n_columns; ++i) {
+        MetricColumn column;
+        column.type = static_cast<MetricType>(in_.get());
+        std::uint32_t id = 0;
+        if (!read_u32(in_, id)) {
+            throw std::runtime_error("Truncated metrics file.");
+        }
+        column.node_id = static_cast<ElementID>(id);
+        columns_.push_back(column);
+    }
+    data_begin_ = in_.tellg();
+}
+
+std::size_t MetricsReader::find_column(MetricType type,
+                                       ElementID node_id) const {
+    for (std::size_t i = 0; i < columns_.size(); ++i) {
+        if (columns_[i].type == type && columns_[i].node_id == node_id) {
+            return i;
+        }
+    }
+    throw std::out_of_range("No such metrics column.");
+}
+
+std::vector<std::int64_t> MetricsReader::read_column(std::size_t index) {
+    if (index >= columns_.size()) {
+        throw std::out_of_range("No such metrics column.");
+    }
+
+    std::vector<std::int64_t> result;
+    std::string encoded;
+    in_.clear();
+    in_.seekg(data_begin_);
+
+    char magic[4];
+    while (in_.read(magic, 4)) {
+        if (!std::equal(magic, magic + 4, BLOCK_MAGIC)) {
+            throw std::runtime_error("Corrupted metrics block.");
+        }
+        std::uint32_t rows = 0;
+        read_u32(in_, rows);
+
+        for (std::size_t c = 0; c < columns_.size(); ++c) {
+            std::uint32_t length = 0;
+            if (!read_u32(in_, length)) {
+                throw std::runtime_error("Truncated metrics file.");
+            }
+            if (c != index) {
+                in_.seekg(length, std::ios::cur); // skip other columns
+                continue;
+            }
+            encoded.resize(length);
+            in_.read(&encoded[0], length);
+
+            std::size_t pos = 0;
+            std::int64_t value = 0;
+            for (std::uint32_t r = 0; r < rows; ++r) {
+                value += unzigzag(get_varint(encoded, pos));
+                result.push_back(value);
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace NetSim
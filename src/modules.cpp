@@ -0,0 +1,479 @@
+#include "../include/modules.hpp"
+#include "../include/helpers.hpp"
+#include "../include/routing_streams.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace NetSim {
+
+namespace {
+/**
+ * @brief Equal probabilities summed in order, as add_receiver sets them
+ */
+void append_thresholds(std::vector<double> &thresholds, std::size_t n) {
+    double distribution = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        distribution += 1.0 / static_cast<double>(n);
+        thresholds.push_back(distribution);
+    }
+}
+
+/**
+ * @brief Receiver in ReceiverOrder: workers before storehouses, then by ID
+ */
+struct RouteEntry {
+    bool storehouse;
+    ElementID id;
+    std::uint32_t receiver;
+
+    bool operator<(const RouteEntry &other) const {
+        return std::make_pair(storehouse, id) <
+               std::make_pair(other.storehouse, other.id);
+    }
+    bool operator==(const RouteEntry &other) const {
+        return storehouse == other.storehouse && id == other.id;
+    }
+};
+
+void append_route(std::vector<RouteEntry> &entries,
+                  std::vector<std::uint32_t> &receivers,
+                  std::vector<double> &thresholds) {
+    std::sort(entries.begin(), entries.end());
+    if (std::adjacent_find(entries.begin(), entries.end()) != entries.end()) {
+        throw std::logic_error("Duplicate link in modular factory.");
+    }
+    for (const auto &entry : entries) {
+        receivers.push_back(entry.receiver);
+    }
+    append_thresholds(thresholds, entries.size());
+}
+} // namespace
+
+// CELL BUILDER
+
+std::size_t CellBuilder::add_worker(TimeOffset pd) {
+    if (pd <= 0) {
+        throw std::logic_error("Processing duration must be positive.");
+    }
+    durations_.push_back(pd);
+    links_.emplace_back();
+    return durations_.size() - 1;
+}
+
+void CellBuilder::add_link(std::size_t from, std::size_t to) {
+    if (from >= durations_.size() || to >= durations_.size()) {
+        throw std::logic_error("Link to unknown worker of the cell.");
+    }
+    auto &links = links_[from];
+    if (from == to ||
+        std::find(links.begin(), links.end(), to) != links.end()) {
+        throw std::logic_error("Self or duplicate link in the cell.");
+    }
+    links.push_back(static_cast<std::uint32_t>(to));
+}
+
+std::size_t CellBuilder::add_input(std::size_t worker) {
+    if (worker >= durations_.size()) {
+        throw std::logic_error("Input port of unknown worker.");
+    }
+    inputs_.push_back(static_cast<std::uint32_t>(worker));
+    return inputs_.size() - 1;
+}
+
+std::size_t CellBuilder::add_output(std::size_t worker) {
+    if (worker >= durations_.size()) {
+        throw std::logic_error("Output port of unknown worker.");
+    }
+    outputs_.push_back(static_cast<std::uint32_t>(worker));
+    return outputs_.size() - 1;
+}
+
+std::shared_ptr<const CellType> CellBuilder::build() const {
+    auto cell = std::make_shared<CellType>();
+    std::size_t n = durations_.size();
+    cell->durations_ = durations_;
+    cell->inputs_ = inputs_;
+    cell->outputs_ = outputs_;
+
+    // Slots in worker order, as instances resolve them
+    cell->boundary_.assign(n, CellType::NO_SLOT);
+    for (std::size_t w = 0; w < n; ++w) {
+        for (std::size_t port = 0; port < outputs_.size(); ++port) {
+            if (outputs_[port] != w) {
+                continue;
+            }
+            std::uint32_t &slot = cell->boundary_[w];
+            if (slot == CellType::NO_SLOT) {
+                slot = static_cast<std::uint32_t>(cell->boundary_ports_.size());
+                cell->boundary_ports_.emplace_back();
+            }
+            cell->boundary_ports_[slot].push_back(
+                static_cast<std::uint32_t>(port));
+        }
+    }
+
+    // Local order is ID order inside an instance
+    cell->link_offsets_.push_back(0);
+    for (std::size_t w = 0; w < n; ++w) {
+        std::vector<std::uint32_t> links = links_[w];
+        std::sort(links.begin(), links.end());
+        cell->link_targets_.insert(cell->link_targets_.end(), links.begin(),
+                                   links.end());
+        append_thresholds(cell->link_thresholds_, links.size());
+        cell->link_offsets_.push_back(cell->link_targets_.size());
+    }
+    return cell;
+}
+
+// BUILDING THE PLANT
+
+void ModularFactory::add_ramp(ElementID id, TimeOffset di) {
+    if (di <= 0) {
+        throw std::logic_error("Delivery interval must be positive.");
+    }
+    ramps_.push_back(RampNode{id, di, {}, {}, {}});
+}
+
+void ModularFactory::add_storehouse(ElementID id) {
+    storehouse_ids_.push_back(id);
+}
+
+std::size_t ModularFactory::add_instance(std::shared_ptr<const CellType> cell,
+                                         ElementID first_worker_id) {
+    ElementID last_worker_id =
+        first_worker_id + static_cast<ElementID>(cell->get_worker_count()) - 1;
+    for (const auto &other : instances_) {
+        ElementID other_last =
+            other.first_worker_id +
+            static_cast<ElementID>(other.cell->get_worker_count()) - 1;
+        if (first_worker_id <= other_last &&
+            other.first_worker_id <= last_worker_id) {
+            throw std::logic_error("Worker IDs of instances overlap.");
+        }
+    }
+
+    Instance instance;
+    instance.first_worker_id = first_worker_id;
+    instance.first_worker = n_workers_;
+    instance.outputs.resize(cell->get_output_count());
+    n_workers_ += cell->get_worker_count();
+    instance.cell = std::move(cell);
+    instances_.push_back(std::move(instance));
+    return instances_.size() - 1;
+}
+
+ModularFactory::Instance &ModularFactory::get_instance(std::size_t instance) {
+    if (instance >= instances_.size()) {
+        throw std::logic_error("Unknown instance.");
+    }
+    return instances_[instance];
+}
+
+void ModularFactory::link_ramp(ElementID ramp, std::size_t instance,
+                               std::size_t input) {
+    auto it = std::find_if(ramps_.begin(), ramps_.end(),
+                           [ramp](const RampNode &r) { return r.id == ramp; });
+    Instance &to = get_instance(instance);
+    if (it == ramps_.end() || input >= to.cell->get_input_count()) {
+        throw std::logic_error("Unknown ramp or input port.");
+    }
+    it->workers.push_back(to.first_worker + to.cell->get_input_worker(input));
+}
+
+void ModularFactory::connect_output(std::size_t instance, std::size_t output,
+                                    std::size_t to_instance,
+                                    std::size_t to_input) {
+    Instance &from = get_instance(instance);
+    Instance &to = get_instance(to_instance);
+    if (output >= from.cell->get_output_count() ||
+        to_input >= to.cell->get_input_count()) {
+        throw std::logic_error("Unknown port.");
+    }
+    Target &target = from.outputs[output];
+    target.connected = true;
+    target.storehouse = false;
+    target.worker = to.first_worker + to.cell->get_input_worker(to_input);
+}
+
+void ModularFactory::connect_output_to_storehouse(std::size_t instance,
+                                                  std::size_t output,
+                                                  ElementID storehouse) {
+    Instance &from = get_instance(instance);
+    if (output >= from.cell->get_output_count()) {
+        throw std::logic_error("Unknown port.");
+    }
+    Target &target = from.outputs[output];
+    target.connected = true;
+    target.storehouse = true;
+    target.storehouse_id = storehouse;
+}
+
+// LOOKUPS
+
+std::size_t ModularFactory::instance_of(std::size_t global) const {
+    // Instances are numbered in global worker order
+    auto it = std::upper_bound(
+        instances_.begin(), instances_.end(), global,
+        [](std::size_t g, const Instance &i) { return g < i.first_worker; });
+    return static_cast<std::size_t>(it - instances_.begin()) - 1;
+}
+
+ElementID ModularFactory::worker_id(std::size_t global) const {
+    const Instance &instance = instances_[instance_of(global)];
+    return instance.first_worker_id +
+           static_cast<ElementID>(global - instance.first_worker);
+}
+
+std::size_t ModularFactory::storehouse_index(ElementID id) const {
+    auto it = std::find(storehouse_ids_.begin(), storehouse_ids_.end(), id);
+    if (it == storehouse_ids_.end()) {
+        throw std::logic_error("Output connected to unknown storehouse.");
+    }
+    return static_cast<std::size_t>(it - storehouse_ids_.begin());
+}
+
+void ModularFactory::resolve_routes() {
+    std::vector<RouteEntry> entries;
+    for (auto &ramp : ramps_) {
+        entries.clear();
+        for (std::size_t worker : ramp.workers) {
+            entries.push_back({false, worker_id(worker),
+                               static_cast<std::uint32_t>(worker)});
+        }
+        ramp.route_receivers.clear();
+        ramp.route_thresholds.clear();
+        append_route(entries, ramp.route_receivers, ramp.route_thresholds);
+    }
+
+    // Only boundary workers - the rest use the shared cell tables
+    for (auto &instance : instances_) {
+        const CellType &cell = *instance.cell;
+        instance.route_offsets.assign(1, 0);
+        instance.route_receivers.clear();
+        instance.route_thresholds.clear();
+        for (std::size_t w = 0; w < cell.get_worker_count(); ++w) {
+            std::uint32_t slot = cell.boundary_[w];
+            if (slot == CellType::NO_SLOT) {
+                continue;
+            }
+            entries.clear();
+            for (std::size_t l = cell.link_offsets_[w];
+                 l < cell.link_offsets_[w + 1]; ++l) {
+                std::size_t global = instance.first_worker + cell.link_targets_[l];
+                entries.push_back({false, worker_id(global),
+                                   static_cast<std::uint32_t>(global)});
+            }
+            for (std::uint32_t port : cell.boundary_ports_[slot]) {
+                const Target &target = instance.outputs[port];
+                if (!target.connected) {
+                    throw std::logic_error("Output port is not connected.");
+                }
+                if (target.storehouse) {
+                    entries.push_back(
+                        {true, target.storehouse_id,
+                         static_cast<std::uint32_t>(
+                             n_workers_ + storehouse_index(target.storehouse_id))});
+                } else {
+                    entries.push_back({false, worker_id(target.worker),
+                                       static_cast<std::uint32_t>(target.worker)});
+                }
+            }
+            append_route(entries, instance.route_receivers,
+                         instance.route_thresholds);
+            instance.route_offsets.push_back(instance.route_receivers.size());
+        }
+    }
+}
+
+// SIMULATION
+
+void ModularFactory::simulate(TimeOffset d, std::uint64_t seed) {
+    resolve_routes();
+
+    // A sender with one receiver (or none) routes the same whatever it
+    // draws, and its stream is its own - it needs no engine
+    std::size_t n_ramps = ramps_.size();
+    auto for_each_branching = [this, n_ramps](auto &&fn) {
+        for (std::size_t r = 0; r < n_ramps; ++r) {
+            if (ramps_[r].route_receivers.size() > 1) {
+                fn(r, NodeType::RAMP, ramps_[r].id);
+            }
+        }
+        for (const auto &instance : instances_) {
+            const CellType &cell = *instance.cell;
+            for (std::size_t w = 0; w < cell.get_worker_count(); ++w) {
+                std::uint32_t slot = cell.boundary_[w];
+                std::size_t n =
+                    slot != CellType::NO_SLOT
+                        ? instance.route_offsets[slot + 1] -
+                              instance.route_offsets[slot]
+                        : cell.link_offsets_[w + 1] - cell.link_offsets_[w];
+                if (n > 1) {
+                    fn(n_ramps + instance.first_worker + w, NodeType::WORKER,
+                       instance.first_worker_id + static_cast<ElementID>(w));
+                }
+            }
+        }
+    };
+    std::size_t n_engines = 0;
+    for_each_branching([&n_engines](std::size_t, NodeType, ElementID) {
+        ++n_engines;
+    });
+    engines_.clear();
+    engines_.reserve(n_engines);
+    engine_index_.assign(n_ramps + n_workers_, NO_ENGINE);
+    for_each_branching([this, seed](std::size_t sender, NodeType type,
+                                    ElementID id) {
+        engine_index_[sender] = static_cast<std::uint32_t>(engines_.size());
+        engines_.emplace_back(stream_seed(seed, routing_stream_id(type, id)));
+    });
+
+    // The plant as the counting engine reads it: cell tables shared by the
+    // instances, per-instance routes only for boundary workers
+    struct CellNet {
+        ModularFactory &plant;
+
+        std::size_t get_ramp_count() const { return plant.ramps_.size(); }
+        std::size_t get_worker_count() const { return plant.n_workers_; }
+        std::size_t get_storehouse_count() const {
+            return plant.storehouse_ids_.size();
+        }
+        TimeOffset get_delivery_interval(std::size_t r) const {
+            return plant.ramps_[r].delivery_interval;
+        }
+        TimeOffset get_processing_duration(std::size_t g) const {
+            const Instance &instance = plant.instances_[plant.instance_of(g)];
+            return instance.cell->durations_[g - instance.first_worker];
+        }
+
+        bool route(std::size_t sender, std::uint32_t &receiver) {
+            std::uint32_t engine = plant.engine_index_[sender];
+            double p = engine == NO_ENGINE ? 0.0
+                                           : std::generate_canonical<double, 10>(
+                                                 plant.engines_[engine]);
+            std::size_t n_ramps = plant.ramps_.size();
+            if (sender < n_ramps) {
+                const RampNode &ramp = plant.ramps_[sender];
+                std::size_t n = ramp.route_receivers.size();
+                if (n == 0) {
+                    return false;
+                }
+                receiver = ramp.route_receivers[choose_link(
+                    ramp.route_thresholds.data(), n, p)];
+                return true;
+            }
+
+            std::size_t g = sender - n_ramps;
+            const Instance &instance = plant.instances_[plant.instance_of(g)];
+            const CellType &cell = *instance.cell;
+            std::size_t w = g - instance.first_worker;
+            std::uint32_t slot = cell.boundary_[w];
+            if (slot != CellType::NO_SLOT) {
+                std::size_t first = instance.route_offsets[slot];
+                std::size_t n = instance.route_offsets[slot + 1] - first;
+                if (n == 0) {
+                    return false;
+                }
+                receiver = instance.route_receivers[
+                    first + choose_link(&instance.route_thresholds[first], n, p)];
+                return true;
+            }
+            std::size_t first = cell.link_offsets_[w];
+            std::size_t n = cell.link_offsets_[w + 1] - first;
+            if (n == 0) {
+                return false;
+            }
+            receiver = static_cast<std::uint32_t>(
+                instance.first_worker +
+                cell.link_targets_[first + choose_link(
+                                            &cell.link_thresholds_[first], n, p)]);
+            return true;
+        }
+    };
+    CellNet net{*this};
+    run_counting_rounds(net, state_, d);
+}
+
+NodeCounts ModularFactory::collect_node_counts() const {
+    NodeCounts counts;
+    std::size_t n_ramps = ramps_.size();
+    for (std::size_t w = 0; w < state_.queues.size(); ++w) {
+        ElementID id = worker_id(w);
+        counts.worker_queues[id] = state_.queues[w];
+        counts.worker_busy[id] = state_.busy[w];
+        counts.worker_sending[id] = state_.sending[n_ramps + w];
+    }
+    for (std::size_t s = 0; s < state_.stock.size(); ++s) {
+        counts.storehouse_stock[storehouse_ids_[s]] = state_.stock[s];
+    }
+    return counts;
+}
+
+// EXPANSION
+
+void ModularFactory::expand(Factory &f) const {
+    std::pmr::memory_resource *queues =
+        f.get_memory_resource(MemoryCategory::QUEUES);
+    std::pmr::memory_resource *stockpiles =
+        f.get_memory_resource(MemoryCategory::STOCKPILES);
+
+    std::vector<Ramp *> ramps;
+    for (const auto &ramp : ramps_) {
+        f.add_ramp(Ramp(ramp.id, ramp.delivery_interval));
+        ramps.push_back(&*std::prev(f.ramp_end()));
+    }
+    std::vector<Worker *> workers;
+    for (const auto &instance : instances_) {
+        for (std::size_t w = 0; w < instance.cell->get_worker_count(); ++w) {
+            f.add_worker(Worker(
+                instance.first_worker_id + static_cast<ElementID>(w),
+                instance.cell->durations_[w],
+                std::make_unique<PackageQueue>(PackageQueueType::FIFO,
+                                               queues)));
+            workers.push_back(&*std::prev(f.worker_end()));
+        }
+    }
+    std::vector<Storehouse *> storehouses;
+    for (ElementID id : storehouse_ids_) {
+        f.add_storehouse(Storehouse(
+            id, std::make_unique<PackageQueue>(PackageQueueType::FIFO,
+                                               stockpiles)));
+        storehouses.push_back(&*std::prev(f.storehouse_end()));
+    }
+
+    for (std::size_t r = 0; r < ramps_.size(); ++r) {
+        for (std::size_t worker : ramps_[r].workers) {
+            ramps[r]->get_receiver_preferences().add_receiver(workers[worker]);
+        }
+    }
+    for (const auto &instance : instances_) {
+        const CellType &cell = *instance.cell;
+        for (std::size_t w = 0; w < cell.get_worker_count(); ++w) {
+            auto &prefs =
+                workers[instance.first_worker + w]->get_receiver_preferences();
+            for (std::size_t l = cell.link_offsets_[w];
+                 l < cell.link_offsets_[w + 1]; ++l) {
+                prefs.add_receiver(
+                    workers[instance.first_worker + cell.link_targets_[l]]);
+            }
+        }
+        for (std::size_t port = 0; port < cell.get_output_count(); ++port) {
+            const Target &target = instance.outputs[port];
+            if (!target.connected) {
+                continue;
+            }
+            auto &prefs = workers[instance.first_worker + cell.outputs_[port]]
+                              ->get_receiver_preferences();
+            if (target.storehouse) {
+                prefs.add_receiver(
+                    storehouses[storehouse_index(target.storehouse_id)]);
+            } else {
+                prefs.add_receiver(workers[target.worker]);
+            }
+        }
+    }
+}
+
+} // namespace NetSim
@@ -0,0 +1,25 @@
+#include "../include/node_counts.hpp"
+
+namespace NetSim {
+
+bool NodeCounts::operator==(const NodeCounts &other) const {
+    return worker_queues == other.worker_queues &&
+           worker_busy == other.worker_busy &&
+           worker_sending == other.worker_sending &&
+           storehouse_stock == other.storehouse_stock;
+}
+
+NodeCounts collect_node_counts(const Factory &f) {
+    NodeCounts counts;
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        counts.worker_queues[it->get_id()] = it->get_queue()->size();
+        counts.worker_busy[it->get_id()] = it->get_processing_buffer() ? 1 : 0;
+        counts.worker_sending[it->get_id()] = it->get_sending_buffer() ? 1 : 0;
+    }
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        counts.storehouse_stock[it->get_id()] = it->get_stockpile()->size();
+    }
+    return counts;
+}
+
+} // namespace NetSim
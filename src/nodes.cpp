@@ -1,13 +1,50 @@
 #include "../include/nodes.hpp"
+#include "../include/memory_accounting.hpp"
+#include "../include/replay.hpp"
+#include "../include/time_travel.hpp"
+#include "../include/trace.hpp"
+
+#include <atomic>
+#include <utility>
 
 namespace NetSim {
 
 // RECEIVER PREFERENCES
 
-ReceiverPreferences::ReceiverPreferences(ProbabilityGenerator pg) : pg_(pg) {}
+namespace {
+std::atomic<std::size_t> next_revision{1};
+
+std::size_t new_revision() {
+    return next_revision.fetch_add(1, std::memory_order_relaxed);
+}
+} // namespace
+
+bool ReceiverOrder::operator()(const IPackageReceiver *a,
+                               const IPackageReceiver *b) const {
+    if (a->get_receiver_type() != b->get_receiver_type()) {
+        return a->get_receiver_type() < b->get_receiver_type();
+    }
+    return a->get_id() < b->get_id();
+}
+
+ReceiverPreferences::ReceiverPreferences(ProbabilityGenerator pg)
+    : pg_(pg), revision_(new_revision()) {}
+
+ReceiverPreferences::ReceiverPreferences(ReceiverPreferences &&other,
+                                         const allocator_type &alloc)
+    : preferences_(std::move(other.preferences_), alloc),
+      pg_(std::move(other.pg_)), policy_(std::move(other.policy_)),
+      revision_(new_revision()) {
+    other.revision_ = new_revision(); // its receivers are gone too
+}
+
+ReceiverPreferences::ReceiverPreferences(ReceiverPreferences &&other)
+    : ReceiverPreferences(std::move(other),
+                          other.preferences_.get_allocator()) {}
 
 void ReceiverPreferences::add_receiver(IPackageReceiver *receiver) {
     preferences_[receiver] = 1.0; // add with default probability and then scale
+    revision_ = new_revision();
 
     double new_prob = 1.0 / preferences_.size();
     for (auto &pair : preferences_) { // reference to the map of preferences
@@ -15,8 +52,15 @@ void ReceiverPreferences::add_receiver(IPackageReceiver *receiver) {
     }
 }
 
+void ReceiverPreferences::add_receiver(IPackageReceiver *receiver,
+                                       double probability) {
+    preferences_[receiver] = probability;
+    revision_ = new_revision();
+}
+
 void ReceiverPreferences::remove_receiver(IPackageReceiver *receiver) {
     preferences_.erase(receiver);
+    revision_ = new_revision();
 
     if (preferences_.empty())
         return; // return if there are no receivers left
@@ -27,7 +71,42 @@ void ReceiverPreferences::remove_receiver(IPackageReceiver *receiver) {
     }
 }
 
+void ReceiverPreferences::replace_receiver(IPackageReceiver *old_receiver,
+                                           IPackageReceiver *new_receiver) {
+    auto it = preferences_.find(old_receiver);
+    if (it == preferences_.end()) {
+        return;
+    }
+    double probability = it->second;
+    preferences_.erase(it);
+    preferences_[new_receiver] = probability;
+    revision_ = new_revision();
+}
+
+void ReceiverPreferences::set_probability_generator(ProbabilityGenerator pg) {
+    pg_ = std::move(pg);
+}
+
+const ProbabilityGenerator &
+ReceiverPreferences::get_probability_generator() const {
+    return pg_;
+}
+
+void ReceiverPreferences::set_routing_policy(
+    std::unique_ptr<IRoutingPolicy> policy) {
+    policy_ = std::move(policy);
+}
+
+const IRoutingPolicy *ReceiverPreferences::get_routing_policy() const {
+    return policy_.get();
+}
+
+std::size_t ReceiverPreferences::get_revision() const { return revision_; }
+
 IPackageReceiver *ReceiverPreferences::choose_receiver() {
+    if (policy_) {
+        return policy_->choose(*this, pg_);
+    }
     double p = pg_(); // Picks a number from [0,1]
     double distribution = 0.0;
 
@@ -67,19 +146,39 @@ ReceiverPreferences::const_iterator ReceiverPreferences::cend() const {
 
 // PACKAGE SENDER
 
-void PackageSender::send_package() {
+PackageSender::PackageSender(PackageSender &&other)
+    : buffer_(std::exchange(other.buffer_, PackageHandle{})),
+      blocked_rounds_(other.blocked_rounds_),
+      receiver_preferences_(std::move(other.receiver_preferences_)) {}
+
+PackageSender::PackageSender(PackageSender &&other,
+                             const allocator_type &alloc)
+    : buffer_(std::exchange(other.buffer_, PackageHandle{})),
+      blocked_rounds_(other.blocked_rounds_),
+      receiver_preferences_(std::move(other.receiver_preferences_),
+                            allocator_type(nested_resource(alloc.resource()))) {
+}
+
+IPackageReceiver *PackageSender::send_package(PackageTable &table) {
     if (buffer_) {
         IPackageReceiver *receiver =
-            receiver_preferences_
-                .choose_receiver(); // calling choose_receiver on the instance
-                                    // of RecerverPreferences
-        if (receiver) {             // When receiver is succesfully picked
-            receiver->receive_package(
-                std::move(*buffer_)); // call receive_package method to collect
-                                      // what's in the buffer
-            buffer_.reset();          // Empty the buffer
+            routing_hook // recorded or replayed routing
+                ? routing_hook->choose_receiver(receiver_preferences_)
+                : receiver_preferences_
+                      .choose_receiver(); // calling choose_receiver on the
+                                          // instance of RecerverPreferences
+        if (receiver && !receiver->can_receive()) {
+            ++blocked_rounds_; // receiver full - package waits, sender blocked
+            return nullptr;
+        }
+        if (receiver) { // When receiver is succesfully picked
+            receiver->receive_handle(table,
+                                     buffer_); // only the handle is passed on
+            buffer_ = PackageHandle{};         // Empty the buffer
+            return receiver;
         }
     }
+    return nullptr;
 }
 
 const ReceiverPreferences &PackageSender::get_receiver_preferences() const {
@@ -90,10 +189,18 @@ ReceiverPreferences &PackageSender::get_receiver_preferences() {
     return receiver_preferences_;
 }
 
-void PackageSender::push_package(Package &&package) {
-    buffer_.emplace(std::move(package));
+void PackageSender::move_buffer(PackageTable &from, PackageTable &to) {
+    if (buffer_ && &from != &to) {
+        buffer_ = to.create(from.take(buffer_));
+    }
+}
+
+std::size_t PackageSender::get_blocked_rounds() const {
+    return blocked_rounds_;
 }
 
+void PackageSender::push_package(PackageHandle handle) { buffer_ = handle; }
+
 // No implementation of IPackageReceiver since it's an abstract class - purely
 // virtual, an interface
 
@@ -101,12 +208,45 @@ void PackageSender::push_package(Package &&package) {
 
 Ramp::Ramp(ElementID id, TimeOffset di) : id_(id), delivery_interval_(di) {};
 
+Ramp::Ramp(Ramp &&other, const allocator_type &alloc)
+    : PackageSender(std::move(other), alloc), id_(other.id_),
+      delivery_interval_(other.delivery_interval_),
+      packages_(other.packages_) {}
+
+Ramp::Ramp(Ramp &&other)
+    : PackageSender(std::move(other)), id_(other.id_),
+      delivery_interval_(other.delivery_interval_),
+      packages_(other.packages_) {}
+
+Ramp::~Ramp() {
+    if (buffer_) {
+        packages_->release(buffer_);
+    }
+}
+
+void Ramp::set_package_table(PackageTable &table) {
+    move_buffer(*packages_, table);
+    packages_ = &table;
+}
+
+bool Ramp::is_delivery_round(Time t) const {
+    return (t - 1) % delivery_interval_ ==
+           0; // starting from time t=1, so it ALWAYS generates a package at
+              // the start round
+}
+
 void Ramp::deliver_goods(Time t) {
-    if ((t - 1) % delivery_interval_ ==
-        0) { // starting from time t=1, so it ALWAYS generates a package at the
-             // start round
+    bool deliver = routing_hook ? routing_hook->should_deliver(*this, t)
+                                : is_delivery_round(t);
+    if (deliver && !buffer_) {
         Package p;
-        push_package(std::move(p));
+        if (trace_sink) {
+            trace_sink->record_delivery(id_, p.get_id(), t);
+        }
+        if (package_move_listener) {
+            package_move_listener->on_delivery(id_, p.get_id());
+        }
+        push_package(packages_->create(std::move(p)));
     }
 }
 
@@ -120,31 +260,133 @@ Worker::Worker(ElementID id, TimeOffset pd, std::unique_ptr<IPackageQueue> q)
     : id_(id), processing_duration_(pd), q_(std::move(q)) {
       }; // q is a smart pointer, it cannot be coppied, must be moved
 
+Worker::Worker(Worker &&other, const allocator_type &alloc)
+    : PackageSender(std::move(other), alloc), id_(other.id_),
+      processing_duration_(other.processing_duration_),
+      package_processing_start_time_(other.package_processing_start_time_),
+      package_processing_finish_time_(other.package_processing_finish_time_),
+      queue_capacity_(other.queue_capacity_), q_(std::move(other.q_)),
+      processing_buffer_(
+          std::exchange(other.processing_buffer_, PackageHandle{})),
+      behaviour_(std::move(other.behaviour_)) {}
+
+Worker::~Worker() {
+    if (processing_buffer_) { // moved-from workers hold nothing
+        get_package_table().release(processing_buffer_);
+    }
+    if (buffer_) {
+        get_package_table().release(buffer_);
+    }
+}
+
+void Worker::set_package_table(PackageTable &table) {
+    PackageTable &current = get_package_table();
+    if (processing_buffer_ && &table != &current) {
+        processing_buffer_ = table.create(current.take(processing_buffer_));
+    }
+    move_buffer(current, table);
+    q_->set_package_table(table);
+}
+
 void Worker::receive_package(Package &&p) {
-    q_->push(std::move(p)); // Insert incoming package to the queue, not
-                            // disturbing current work
+    PackageTable &table = get_package_table();
+    receive_handle(table, table.create(std::move(p)));
+}
+
+void Worker::receive_handle(PackageTable &table, PackageHandle handle) {
+    if (trace_sink) {
+        trace_sink->record_receive(
+            static_cast<std::uint8_t>(ReceiverType::WORKER), id_,
+            table.get(handle).get_id());
+    }
+    if (package_move_listener) {
+        package_move_listener->on_receive(ReceiverType::WORKER, id_,
+                                          table.get(handle).get_id());
+    }
+    PackageTable &own = get_package_table();
+    if (&table == &own) {
+        q_->push(handle); // Insert incoming package to the queue, not
+                          // disturbing current work
+    } else {
+        q_->push(table.take(handle)); // sender outside this table
+    }
+    if (IReceiveListener *listener = own.get_receive_listener()) {
+        listener->on_receive(this); // e.g. the Factory wakes the worker
+    }
 }
 
 void Worker::do_work(Time t) {
-    if (!processing_buffer_ &&
-        !q_->empty()) { // if currently not working and buffer not empty
-        processing_buffer_.emplace(q_->pop()); // take package from input queue
-        package_processing_start_time_ = t;
+    if (behaviour_) {
+        behaviour_->do_work(*this, t);
+        return;
     }
+    start_processing(t); // if currently not working and queue not empty
 
-    if (processing_buffer_) { // if currently working
-        if (t - package_processing_start_time_ >=
-            processing_duration_ - 1) // if all processing has been done, sends
-                                      // package in the next round
-        {
-            push_package(std::move(*processing_buffer_));
-            processing_buffer_.reset();
+    if (processing_buffer_ &&
+        t - package_processing_start_time_ >=
+            processing_duration_ - 1) { // if all processing has been done
+        finish_processing(t); // kept in hand while the buffer is blocked
+        // it cannot take another package till the next round
+    }
+}
 
-            // it cannot take another package till the next round
-        }
+void Worker::set_behaviour(std::unique_ptr<IWorkerBehaviour> behaviour) {
+    behaviour_ = std::move(behaviour);
+}
+
+IWorkerBehaviour *Worker::get_behaviour() const { return behaviour_.get(); }
+
+bool Worker::start_processing(Time t) {
+    if (processing_buffer_ || q_->empty()) {
+        return false;
+    }
+    processing_buffer_ = q_->pop_handle(); // take package from input queue
+    package_processing_start_time_ = t;
+    if (package_move_listener) {
+        package_move_listener->on_start(
+            id_, get_package_table().get(processing_buffer_).get_id());
+    }
+    return true;
+}
+
+bool Worker::finish_processing(Time t) {
+    if (!processing_buffer_ || buffer_) {
+        return false; // previous product still blocked, keep this one
+    }
+    if (trace_sink) {
+        trace_sink->record_processing(
+            id_, get_package_table().get(processing_buffer_).get_id(),
+            package_processing_start_time_, t);
+    }
+    if (package_move_listener) {
+        package_move_listener->on_finish(id_);
+    }
+    push_package(processing_buffer_);
+    processing_buffer_ = PackageHandle{};
+    package_processing_finish_time_ = t;
+    return true;
+}
+
+bool Worker::can_receive() const {
+    return queue_capacity_ == 0 || q_->size() < queue_capacity_;
+}
+
+void Worker::set_queue_capacity(std::size_t capacity) {
+    queue_capacity_ = capacity;
+}
+
+std::size_t Worker::get_queue_capacity() const { return queue_capacity_; }
+
+void Worker::relocate_queue() {
+    if (auto q = q_->relocate()) {
+        q_ = std::move(q);
     }
 }
 
+std::size_t Worker::get_load() const {
+    return q_->size() + (processing_buffer_ ? 1 : 0);
+}
+
 ReceiverType Worker::get_receiver_type() const { return ReceiverType::WORKER; }
 
 ElementID Worker::get_id() const { return id_; }
@@ -157,6 +399,12 @@ Time Worker::get_product_processing_start_time() const {
     return package_processing_start_time_;
 }
 
+Time Worker::get_product_processing_finish_time() const {
+    return package_processing_finish_time_;
+}
+
+const IPackageQueue *Worker::get_queue() const { return q_.get(); }
+
 Worker::const_iterator Worker::begin() const { return q_->begin(); }
 Worker::const_iterator Worker::end() const { return q_->end(); }
 Worker::const_iterator Worker::cbegin() const { return q_->cbegin(); }
@@ -174,10 +422,36 @@ ReceiverType Storehouse::get_receiver_type() const {
     return ReceiverType::STOREHOUSE;
 }
 
-void Storehouse::receive_package(Package &&p) { d_->push(std::move(p)); }
+void Storehouse::receive_package(Package &&p) {
+    PackageTable &table = d_->get_package_table();
+    receive_handle(table, table.create(std::move(p)));
+}
+
+void Storehouse::receive_handle(PackageTable &table, PackageHandle handle) {
+    if (trace_sink) {
+        trace_sink->record_receive(
+            static_cast<std::uint8_t>(ReceiverType::STOREHOUSE), id_,
+            table.get(handle).get_id());
+    }
+    if (package_move_listener) {
+        package_move_listener->on_receive(ReceiverType::STOREHOUSE, id_,
+                                          table.get(handle).get_id());
+    }
+    if (&table == &d_->get_package_table()) {
+        d_->push(handle); // stays in the table, nothing is moved
+    } else {
+        d_->push(table.take(handle));
+    }
+}
+
+void Storehouse::set_package_table(PackageTable &table) {
+    d_->set_package_table(table);
+}
 
 ElementID Storehouse::get_id() const { return id_; }
 
+const IPackageStockpile *Storehouse::get_stockpile() const { return d_.get(); }
+
 Storehouse::const_iterator Storehouse::begin() const { return d_->begin(); }
 Storehouse::const_iterator Storehouse::end() const { return d_->end(); }
 Storehouse::const_iterator Storehouse::cbegin() const { return d_->cbegin(); }
@@ -2,8 +2,13 @@
 
 namespace NetSim {
 
-std::set<ElementID> Package::assigned_ids_ = {};
-std::set<ElementID> Package::freed_ids_ = {};
+namespace {
+// Defined before the sets, so it is destroyed after them
+CountingMemoryResource package_id_memory(std::pmr::new_delete_resource());
+} // namespace
+
+std::pmr::set<ElementID> Package::assigned_ids_(&package_id_memory);
+std::pmr::set<ElementID> Package::freed_ids_(&package_id_memory);
 
 Package::Package() {
   if (!freed_ids_.empty()) {
@@ -46,6 +51,10 @@ Package &Package::operator=(Package &&other) noexcept {
 
 ElementID Package::get_id() const { return id_; }
 
+const MemoryUsage &Package::get_id_memory_usage() {
+  return package_id_memory.get_usage();
+}
+
 Package::~Package() {
   if (id_ != -1) {
     assigned_ids_.erase(id_);
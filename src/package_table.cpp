@@ -0,0 +1,123 @@
+#include "../include/package_table.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace NetSim {
+
+// PACKAGE TABLE
+
+PackageTable::PackageTable(std::pmr::memory_resource *resource)
+    : slots_(resource),
+      free_slots_(std::greater<std::uint32_t>(),
+                  std::pmr::vector<std::uint32_t>(resource)) {}
+
+std::uint32_t PackageTable::allocate_slot() {
+    std::uint32_t index;
+    if (!free_slots_.empty()) {
+        index = free_slots_.top();
+        free_slots_.pop();
+    } else {
+        index = static_cast<std::uint32_t>(slots_.size());
+        slots_.emplace_back();
+    }
+    slots_[index].live = true;
+    slots_[index].serial = created_++;
+    ++live_;
+    return index;
+}
+
+PackageHandle PackageTable::create() {
+    std::uint32_t index = allocate_slot();
+    return {index, slots_[index].generation};
+}
+
+PackageHandle PackageTable::create(Package &&package) {
+    std::uint32_t index = allocate_slot();
+    slots_[index].package.emplace(std::move(package));
+    return {index, slots_[index].generation};
+}
+
+void PackageTable::release(PackageHandle handle) {
+    if (!is_live(handle)) {
+        throw std::logic_error("Package handle is not live.");
+    }
+    Slot &slot = slots_[handle.index];
+    slot.live = false;
+    slot.package.reset(); // a kept Package gives its ID back
+    if (++slot.generation == 0) { // old handles become stale
+        slot.generation = 1;
+    }
+    free_slots_.push(handle.index);
+    --live_;
+}
+
+Package PackageTable::take(PackageHandle handle) {
+    if (!is_live(handle) || !slots_[handle.index].package) {
+        throw std::logic_error("Package handle is not live.");
+    }
+    Package package = std::move(*slots_[handle.index].package);
+    release(handle);
+    return package;
+}
+
+PackageTable &default_package_table() {
+    static PackageTable table;
+    return table;
+}
+
+bool PackageTable::is_live(PackageHandle handle) const {
+    return handle.index < slots_.size() && slots_[handle.index].live &&
+           slots_[handle.index].generation == handle.generation;
+}
+
+// HANDLE QUEUE
+
+void PackageHandleQueue::grow(std::size_t min_capacity) {
+    std::size_t capacity = std::max<std::size_t>(buffer_.size(), 8);
+    while (capacity < min_capacity) {
+        capacity *= 2;
+    }
+    if (capacity == buffer_.size()) {
+        return;
+    }
+
+    std::pmr::vector<PackageHandle> bigger(capacity, buffer_.get_allocator());
+    // At most two segments: head..end of buffer, then the wrapped part
+    std::size_t first = std::min(size_, buffer_.size() - head_);
+    if (size_ > 0) {
+        std::memcpy(bigger.data(), buffer_.data() + head_,
+                    first * sizeof(PackageHandle));
+        std::memcpy(bigger.data() + first, buffer_.data(),
+                    (size_ - first) * sizeof(PackageHandle));
+    }
+    buffer_.swap(bigger);
+    mask_ = capacity - 1;
+    head_ = 0;
+}
+
+void PackageHandleQueue::copy_in(const PackageHandle *handles, std::size_t n) {
+    std::size_t tail = (head_ + size_) & mask_;
+    std::size_t first = std::min(n, buffer_.size() - tail);
+    std::memcpy(buffer_.data() + tail, handles, first * sizeof(PackageHandle));
+    std::memcpy(buffer_.data(), handles + first,
+                (n - first) * sizeof(PackageHandle));
+    size_ += n;
+}
+
+void PackageHandleQueue::take_all(PackageHandleQueue &other) {
+    if (&other == this || other.size_ == 0) {
+        return; // nothing to move
+    }
+    if (size_ + other.size_ > buffer_.size()) {
+        grow(size_ + other.size_);
+    }
+    std::size_t first = std::min(other.size_, other.buffer_.size() - other.head_);
+    copy_in(other.buffer_.data() + other.head_, first);
+    copy_in(other.buffer_.data(), other.size_ - first);
+
+    other.head_ = 0;
+    other.size_ = 0;
+}
+
+} // namespace NetSim
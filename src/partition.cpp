@@ -0,0 +1,562 @@
+#include "../include/partition.hpp"
+#include "../include/routing_policies.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace NetSim {
+
+namespace {
+enum NodeKind : std::uint32_t {
+    RAMP_NODE = 0,
+    WORKER_NODE = 1,
+    STOREHOUSE_NODE = 2
+};
+
+/**
+ * @brief Receiver encoded as (is_storehouse << 31) | ID for messages
+ */
+std::uint32_t encode_receiver(ReceiverType type, ElementID id) {
+    return (type == ReceiverType::STOREHOUSE ? 0x80000000u : 0u) |
+           (static_cast<std::uint32_t>(id) & 0x7FFFFFFFu);
+}
+
+void append_u32(std::string &s, std::uint32_t value) {
+    char bytes[4];
+    std::memcpy(bytes, &value, 4); // both ends are local processes
+    s.append(bytes, 4);
+}
+
+std::uint32_t read_u32(const std::string &s, std::size_t pos) {
+    std::uint32_t value;
+    std::memcpy(&value, s.data() + pos, 4);
+    return value;
+}
+
+/**
+ * @brief Stand-in for a receiver owned by another partition
+ * Received packages are only counted into the outbox of the owner
+ */
+class RemoteReceiver : public IPackageReceiver {
+  public:
+    RemoteReceiver(ReceiverType type, ElementID id, std::string &outbox)
+        : type_(type), id_(id), outbox_(outbox) {}
+
+    void receive_package(Package &&) override {
+        append_u32(outbox_, encode_receiver(type_, id_));
+    }
+
+    ElementID get_id() const override { return id_; }
+    ReceiverType get_receiver_type() const override { return type_; }
+
+    // Proxy stores nothing - empty range
+    const_iterator begin() const override { return {}; }
+    const_iterator end() const override { return {}; }
+    const_iterator cbegin() const override { return {}; }
+    const_iterator cend() const override { return {}; }
+
+  private:
+    ReceiverType type_;
+    ElementID id_;
+    std::string &outbox_;
+};
+
+/**
+ * @brief Connection to one peer partition
+ */
+struct PeerLink {
+    int fd = -1;
+    std::string outbox;       // receiver codes collected this round
+    std::string out;          // message being sent
+    std::size_t out_pos = 0;
+    std::string in;           // bytes received (may hold the next round)
+};
+
+/**
+ * @brief Tells if a complete message is at the front of the buffer
+ */
+bool has_message(const std::string &in) {
+    return in.size() >= 4 && in.size() >= 4 + 4 * std::size_t{read_u32(in, 0)};
+}
+
+/**
+ * @brief Sends this round's message to every peer and waits for theirs
+ * Non-blocking in both directions (poll), so big messages cannot deadlock
+ */
+void exchange_round(std::vector<PeerLink> &peers,
+                    std::vector<std::uint32_t> &incoming) {
+    for (auto &peer : peers) {
+        if (peer.fd < 0) {
+            continue;
+        }
+        peer.out.clear();
+        append_u32(peer.out,
+                   static_cast<std::uint32_t>(peer.outbox.size() / 4));
+        peer.out += peer.outbox; // empty - null message
+        peer.outbox.clear();
+        peer.out_pos = 0;
+    }
+
+    while (true) {
+        std::vector<pollfd> fds;
+        std::vector<PeerLink *> owners;
+        for (auto &peer : peers) {
+            if (peer.fd < 0) {
+                continue;
+            }
+            short events = 0;
+            if (peer.out_pos < peer.out.size()) {
+                events |= POLLOUT;
+            }
+            if (!has_message(peer.in)) {
+                events |= POLLIN;
+            }
+            if (events != 0) {
+                fds.push_back(pollfd{peer.fd, events, 0});
+                owners.push_back(&peer);
+            }
+        }
+        if (fds.empty()) {
+            break; // everything sent and every peer's message is here
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("poll failed");
+        }
+
+        for (std::size_t i = 0; i < fds.size(); ++i) {
+            PeerLink &peer = *owners[i];
+            if (fds[i].revents & POLLOUT) {
+                ssize_t n = write(peer.fd, peer.out.data() + peer.out_pos,
+                                  peer.out.size() - peer.out_pos);
+                if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    throw std::runtime_error("Partition link broken.");
+                }
+                if (n > 0) {
+                    peer.out_pos += static_cast<std::size_t>(n);
+                }
+            }
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                char chunk[1 << 16];
+                ssize_t n = read(peer.fd, chunk, sizeof(chunk));
+                if (n == 0) {
+                    throw std::runtime_error("Partition peer exited.");
+                }
+                if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    throw std::runtime_error("Partition link broken.");
+                }
+                if (n > 0) {
+                    peer.in.append(chunk, static_cast<std::size_t>(n));
+                }
+            }
+        }
+    }
+
+    for (auto &peer : peers) {
+        if (peer.fd < 0) {
+            continue;
+        }
+        std::uint32_t count = read_u32(peer.in, 0);
+        for (std::uint32_t k = 0; k < count; ++k) {
+            incoming.push_back(read_u32(peer.in, 4 + 4 * k));
+        }
+        peer.in.erase(0, 4 + 4 * std::size_t{count});
+    }
+}
+
+void write_all(int fd, const std::string &data) {
+    std::size_t pos = 0;
+    while (pos < data.size()) {
+        ssize_t n = write(fd, data.data() + pos, data.size() - pos);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Cannot write partition result.");
+        }
+        pos += static_cast<std::size_t>(n);
+    }
+}
+
+/**
+ * @brief Body of a child process - simulates one partition
+ */
+void run_partition(Factory &f, TimeOffset d, const PartitionPlan &plan,
+                   int me, std::vector<PeerLink> &peers, int result_fd) {
+    auto owner = [&plan](ReceiverType type, ElementID id) {
+        const auto &nodes = type == ReceiverType::WORKER ? plan.workers
+                                                         : plan.storehouses;
+        return nodes.at(id);
+    };
+
+    std::vector<Ramp *> ramps;
+    std::vector<Worker *> workers;
+    std::map<std::uint32_t, IPackageReceiver *> local_receivers;
+    for (auto it = f.ramp_begin(); it != f.ramp_end(); ++it) {
+        if (plan.ramps.at(it->get_id()) == me) {
+            ramps.push_back(&*it);
+        }
+    }
+    for (auto it = f.worker_begin(); it != f.worker_end(); ++it) {
+        if (plan.workers.at(it->get_id()) == me) {
+            workers.push_back(&*it);
+            local_receivers[encode_receiver(ReceiverType::WORKER,
+                                            it->get_id())] = &*it;
+        }
+    }
+    for (auto it = f.storehouse_begin(); it != f.storehouse_end(); ++it) {
+        if (plan.storehouses.at(it->get_id()) == me) {
+            local_receivers[encode_receiver(ReceiverType::STOREHOUSE,
+                                            it->get_id())] = &*it;
+        }
+    }
+
+    // Remote receivers in owned senders are replaced by proxies
+    std::map<std::uint32_t, std::unique_ptr<RemoteReceiver>> proxies;
+    auto install_proxies = [&](PackageSender &sender) {
+        std::vector<IPackageReceiver *> remote;
+        for (const auto &pair : sender.get_receiver_preferences()) {
+            if (owner(pair.first->get_receiver_type(), pair.first->get_id()) !=
+                me) {
+                remote.push_back(pair.first);
+            }
+        }
+        for (IPackageReceiver *receiver : remote) {
+            ReceiverType type = receiver->get_receiver_type();
+            std::uint32_t code = encode_receiver(type, receiver->get_id());
+            auto &proxy = proxies[code];
+            if (!proxy) {
+                proxy = std::make_unique<RemoteReceiver>(
+                    type, receiver->get_id(),
+                    peers[owner(type, receiver->get_id())].outbox);
+            }
+            sender.get_receiver_preferences().replace_receiver(receiver,
+                                                               proxy.get());
+        }
+    };
+    for (Ramp *ramp : ramps) {
+        install_proxies(*ramp);
+    }
+    for (Worker *worker : workers) {
+        install_proxies(*worker);
+    }
+
+    std::vector<std::uint32_t> incoming;
+    for (Time t = 1; t <= d; ++t) {
+        for (Ramp *ramp : ramps) {
+            ramp->deliver_goods(t);
+        }
+        for (Ramp *ramp : ramps) {
+            ramp->send_package();
+        }
+        for (Worker *worker : workers) {
+            worker->send_package();
+        }
+
+        incoming.clear();
+        exchange_round(peers, incoming);
+        for (std::uint32_t code : incoming) {
+            local_receivers.at(code)->receive_package(Package());
+        }
+
+        for (Worker *worker : workers) {
+            worker->do_work(t);
+        }
+    }
+
+    // Result: records (kind, ID, queue, busy, sending)
+    std::string result;
+    for (Worker *worker : workers) {
+        append_u32(result, WORKER_NODE);
+        append_u32(result, static_cast<std::uint32_t>(worker->get_id()));
+        append_u32(result,
+                   static_cast<std::uint32_t>(worker->get_queue()->size()));
+        append_u32(result, worker->get_processing_buffer() ? 1 : 0);
+        append_u32(result, worker->get_sending_buffer() ? 1 : 0);
+    }
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        if (plan.storehouses.at(it->get_id()) == me) {
+            append_u32(result, STOREHOUSE_NODE);
+            append_u32(result, static_cast<std::uint32_t>(it->get_id()));
+            append_u32(result,
+                       static_cast<std::uint32_t>(it->get_stockpile()->size()));
+            append_u32(result, 0);
+            append_u32(result, 0);
+        }
+    }
+    write_all(result_fd, result);
+}
+} // namespace
+
+// PLAN
+
+PartitionPlan make_partition_plan(const Factory &f, int n_partitions) {
+    if (n_partitions < 1) {
+        throw std::invalid_argument("At least one partition is required.");
+    }
+
+    // BFS order of all nodes, starting from the ramps
+    std::vector<std::pair<NodeKind, ElementID>> order;
+    std::set<const IPackageReceiver *> visited;
+    std::queue<const IPackageReceiver *> to_visit;
+
+    auto visit_links = [&](const PackageSender &sender) {
+        for (const auto &pair : sender.get_receiver_preferences()) {
+            if (visited.insert(pair.first).second) {
+                to_visit.push(pair.first);
+            }
+        }
+    };
+
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        order.emplace_back(RAMP_NODE, it->get_id());
+        visit_links(*it);
+        while (!to_visit.empty()) {
+            const IPackageReceiver *receiver = to_visit.front();
+            to_visit.pop();
+            if (receiver->get_receiver_type() == ReceiverType::WORKER) {
+                order.emplace_back(WORKER_NODE, receiver->get_id());
+                visit_links(*dynamic_cast<const Worker *>(receiver));
+            } else {
+                order.emplace_back(STOREHOUSE_NODE, receiver->get_id());
+            }
+        }
+    }
+    // Nodes not reachable from any ramp
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        if (!visited.count(&*it)) {
+            order.emplace_back(WORKER_NODE, it->get_id());
+        }
+    }
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        if (!visited.count(&*it)) {
+            order.emplace_back(STOREHOUSE_NODE, it->get_id());
+        }
+    }
+
+    PartitionPlan plan;
+    plan.n_partitions = n_partitions;
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        int partition = static_cast<int>(i * n_partitions / order.size());
+        switch (order[i].first) {
+        case RAMP_NODE:
+            plan.ramps[order[i].second] = partition;
+            break;
+        case WORKER_NODE:
+            plan.workers[order[i].second] = partition;
+            break;
+        case STOREHOUSE_NODE:
+            plan.storehouses[order[i].second] = partition;
+            break;
+        }
+    }
+    return plan;
+}
+
+// PARTITIONED SIMULATION
+
+namespace {
+/**
+ * @brief Puts the senders' probability generators back when destroyed
+ */
+class SavedGenerators {
+  public:
+    explicit SavedGenerators(Factory &f) : f_(f) {
+        for (auto it = f_.ramp_cbegin(); it != f_.ramp_cend(); ++it) {
+            generators_.push_back(
+                it->get_receiver_preferences().get_probability_generator());
+        }
+        for (auto it = f_.worker_cbegin(); it != f_.worker_cend(); ++it) {
+            generators_.push_back(
+                it->get_receiver_preferences().get_probability_generator());
+        }
+    }
+
+    ~SavedGenerators() {
+        auto pg = generators_.begin();
+        for (auto it = f_.ramp_begin(); it != f_.ramp_end(); ++it) {
+            it->get_receiver_preferences().set_probability_generator(*pg++);
+        }
+        for (auto it = f_.worker_begin(); it != f_.worker_end(); ++it) {
+            it->get_receiver_preferences().set_probability_generator(*pg++);
+        }
+    }
+
+  private:
+    Factory &f_;
+    std::vector<ProbabilityGenerator> generators_;
+};
+} // namespace
+
+NodeCounts simulate_partitioned(Factory &f, TimeOffset d,
+                                const PartitionPlan &plan,
+                                std::uint64_t seed) {
+    if (!f.is_consistent()) {
+        throw std::logic_error("Net is not consistent.");
+    }
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        if (it->get_queue_capacity() != 0) { // proxies can't refuse packages
+            throw std::logic_error(
+                "Partitioned simulation needs unbounded queues.");
+        }
+    }
+    if (uses_routing_policies(f)) { // proxies don't know remote loads
+        throw std::logic_error(
+            "Partitioned simulation needs probability routing.");
+    }
+    SavedGenerators saved(f); // the children route with the seeded streams
+    seed_routing_streams(f, seed);
+
+    int n = plan.n_partitions;
+
+    // Full mesh of local sockets: links[i][j] is the end used by i
+    std::vector<std::vector<int>> links(n, std::vector<int>(n, -1));
+    std::vector<int> result_read(n, -1), result_write(n, -1);
+    auto close_all = [&]() {
+        for (auto &row : links) {
+            for (int &fd : row) {
+                if (fd >= 0) {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            for (int *fd : {&result_read[i], &result_write[i]}) {
+                if (*fd >= 0) {
+                    close(*fd);
+                    *fd = -1;
+                }
+            }
+        }
+    };
+
+    for (int i = 0; i < n; ++i) {
+        for (int j = i + 1; j < n; ++j) {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                close_all();
+                throw std::runtime_error("Cannot create partition link.");
+            }
+            links[i][j] = pair[0];
+            links[j][i] = pair[1];
+        }
+        int pipe_fds[2];
+        if (pipe(pipe_fds) != 0) {
+            close_all();
+            throw std::runtime_error("Cannot create result pipe.");
+        }
+        result_read[i] = pipe_fds[0];
+        result_write[i] = pipe_fds[1];
+    }
+
+    std::cout.flush(); // buffered output would be duplicated by fork
+    std::vector<pid_t> children;
+    for (int me = 0; me < n; ++me) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            close_all();
+            throw std::runtime_error("Cannot start partition process.");
+        }
+        if (pid == 0) {
+            int status = 0;
+            try {
+                std::vector<PeerLink> peers(n);
+                for (int i = 0; i < n; ++i) {
+                    for (int j = 0; j < n; ++j) {
+                        if (i == me && j != me) {
+                            peers[j].fd = links[i][j];
+                            // partial writes instead of blocking (see poll)
+                            fcntl(peers[j].fd, F_SETFL,
+                                  fcntl(peers[j].fd, F_GETFL) | O_NONBLOCK);
+                        } else if (links[i][j] >= 0) {
+                            close(links[i][j]);
+                        }
+                    }
+                    close(result_read[i]);
+                    if (i != me) {
+                        close(result_write[i]);
+                    }
+                }
+                run_partition(f, d, plan, me, peers, result_write[me]);
+            } catch (...) {
+                status = 1;
+            }
+            _exit(status); // never return into the parent's code
+        }
+        children.push_back(pid);
+    }
+
+    // Parent keeps only the read ends of result pipes
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            if (links[i][j] >= 0) {
+                close(links[i][j]);
+                links[i][j] = -1;
+            }
+        }
+        close(result_write[i]);
+        result_write[i] = -1;
+    }
+
+    NodeCounts counts;
+    for (int i = 0; i < n; ++i) {
+        std::string data;
+        char chunk[1 << 16];
+        ssize_t got;
+        while ((got = read(result_read[i], chunk, sizeof(chunk))) != 0) {
+            if (got < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            data.append(chunk, static_cast<std::size_t>(got));
+        }
+        for (std::size_t pos = 0; pos + 20 <= data.size(); pos += 20) {
+            std::uint32_t kind = read_u32(data, pos);
+            auto id = static_cast<ElementID>(read_u32(data, pos + 4));
+            std::size_t value = read_u32(data, pos + 8);
+            if (kind == WORKER_NODE) {
+                counts.worker_queues[id] = value;
+                counts.worker_busy[id] = read_u32(data, pos + 12);
+                counts.worker_sending[id] = read_u32(data, pos + 16);
+            } else {
+                counts.storehouse_stock[id] = value;
+            }
+        }
+    }
+    close_all();
+
+    bool failed = false;
+    for (pid_t pid : children) {
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+            failed = true;
+        }
+    }
+    if (failed) {
+        throw std::runtime_error("Partition process failed.");
+    }
+    return counts;
+}
+
+} // namespace NetSim
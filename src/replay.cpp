@@ -0,0 +1,151 @@
+#include "../include/replay.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace NetSim {
+
+IRoutingHook *routing_hook = nullptr;
+
+namespace {
+const std::string LOG_MAGIC = "NSRL1";
+constexpr std::size_t FLUSH_THRESHOLD = 1 << 20;
+
+void put_varint(std::string &out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+/**
+ * @brief Receiver encoded as ((ID << 1) | is_storehouse) + 1, 0 - no receiver
+ */
+std::uint64_t encode_receiver(const IPackageReceiver *receiver) {
+    if (!receiver) {
+        return 0;
+    }
+    std::uint64_t id = static_cast<std::uint32_t>(receiver->get_id());
+    std::uint64_t is_storehouse =
+        receiver->get_receiver_type() == ReceiverType::STOREHOUSE ? 1 : 0;
+    return ((id << 1) | is_storehouse) + 1;
+}
+} // namespace
+
+// RECORDER
+
+RoutingRecorder::RoutingRecorder(const std::string &path) : path_(path) {
+    buffer_ = LOG_MAGIC;
+    flush(); // fail early if the file cannot be created
+}
+
+RoutingRecorder::~RoutingRecorder() { close(); }
+
+IPackageReceiver *RoutingRecorder::choose_receiver(ReceiverPreferences &prefs) {
+    IPackageReceiver *receiver = prefs.choose_receiver();
+    put_varint(buffer_, encode_receiver(receiver));
+    ++events_;
+    if (buffer_.size() >= FLUSH_THRESHOLD) {
+        flush();
+    }
+    return receiver;
+}
+
+bool RoutingRecorder::should_deliver(const Ramp &ramp, Time t) {
+    bool deliver = ramp.is_delivery_round(t);
+    buffer_ += deliver ? '\1' : '\0';
+    ++events_;
+    return deliver;
+}
+
+void RoutingRecorder::flush() {
+    std::ofstream out(path_, truncate_ ? std::ios::binary | std::ios::trunc
+                                       : std::ios::binary | std::ios::app);
+    if (!out) {
+        throw std::runtime_error("Cannot write routing log: " + path_);
+    }
+    out.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+    truncate_ = false;
+}
+
+void RoutingRecorder::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    flush();
+    if (routing_hook == this) {
+        routing_hook = nullptr;
+    }
+}
+
+// REPLAYER
+
+RoutingReplayer::RoutingReplayer(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot read routing log: " + path);
+    }
+    log_.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+    if (log_.compare(0, LOG_MAGIC.size(), LOG_MAGIC) != 0) {
+        throw std::runtime_error("Not a routing log: " + path);
+    }
+    pos_ = LOG_MAGIC.size();
+}
+
+RoutingReplayer::~RoutingReplayer() {
+    if (routing_hook == this) {
+        routing_hook = nullptr;
+    }
+}
+
+std::uint64_t RoutingReplayer::next_event() {
+    std::uint64_t value = 0;
+    int shift = 0;
+    while (true) {
+        if (pos_ >= log_.size()) {
+            throw std::runtime_error("Routing log exhausted.");
+        }
+        auto byte = static_cast<std::uint8_t>(log_[pos_++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+        shift += 7;
+    }
+}
+
+IPackageReceiver *RoutingReplayer::choose_receiver(ReceiverPreferences &prefs) {
+    std::uint64_t code = next_event();
+    if (code == 0) {
+        return nullptr;
+    }
+    auto [it, added] = lookups_.try_emplace(&prefs);
+    ReceiverLookup &lookup = it->second;
+    if (added || lookup.revision != prefs.get_revision()) {
+        lookup.revision = prefs.get_revision();
+        lookup.receivers.clear();
+        for (const auto &pair : prefs) {
+            lookup.receivers.emplace(encode_receiver(pair.first), pair.first);
+        }
+    }
+    auto found = lookup.receivers.find(code);
+    if (found == lookup.receivers.end()) {
+        throw std::runtime_error("Routing log does not match the Net.");
+    }
+    return found->second;
+}
+
+bool RoutingReplayer::should_deliver(const Ramp &, Time) {
+    std::uint64_t code = next_event();
+    if (code > 1) {
+        throw std::runtime_error("Routing log does not match the Net.");
+    }
+    return code == 1;
+}
+
+} // namespace NetSim
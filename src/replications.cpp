@@ -0,0 +1,131 @@
+#include "../include/replications.hpp"
+#include "../include/helpers.hpp"
+#include "../include/routing_streams.hpp"
+#include "../include/simulation.hpp"
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace NetSim {
+
+double delivered_packages(const Factory &f) {
+    double delivered = 0.0;
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        delivered += static_cast<double>(it->get_stockpile()->size());
+    }
+    return delivered;
+}
+
+namespace {
+double run_replication(const FactoryBuilder &build, std::uint64_t seed,
+                       bool antithetic, TimeOffset rounds,
+                       const ReplicationMetric &metric) {
+    Factory f;
+    build(f);
+    seed_routing_streams(f, seed, antithetic);
+    simulate(f, rounds, [](Factory &, Time) {});
+    return metric(f);
+}
+
+double mean(const std::vector<double> &values) {
+    double sum = 0.0;
+    for (double value : values) {
+        sum += value;
+    }
+    return sum / static_cast<double>(values.size());
+}
+
+double sample_variance(const std::vector<double> &values) {
+    double m = mean(values);
+    double sum = 0.0;
+    for (double value : values) {
+        sum += (value - m) * (value - m);
+    }
+    return sum / static_cast<double>(values.size() - 1);
+}
+} // namespace
+
+ComparisonReport compare_configurations(const FactoryBuilder &build_a,
+                                        const FactoryBuilder &build_b,
+                                        const ReplicationOptions &options,
+                                        const ReplicationMetric &metric) {
+    std::size_t n = options.n_replications;
+    if (options.antithetic && n % 2 != 0) {
+        throw std::logic_error("Antithetic runs need an even count.");
+    }
+    std::size_t n_units = options.antithetic ? n / 2 : n;
+    if (n_units < 2) {
+        throw std::logic_error("Comparison needs at least 2 replications.");
+    }
+
+    ComparisonReport report;
+    report.n_replications = n;
+    for (std::size_t i = 0; i < n; ++i) {
+        std::uint64_t seed = options.base_seed + (options.antithetic ? i / 2 : i);
+        bool antithetic = options.antithetic && i % 2 == 1;
+        // Without common numbers B takes streams unrelated to A's
+        std::uint64_t seed_b = options.common_random_numbers
+                                   ? seed
+                                   : stream_seed(seed, 0x5EED0B);
+        report.metrics_a.push_back(
+            run_replication(build_a, seed, antithetic, options.rounds, metric));
+        report.metrics_b.push_back(run_replication(
+            build_b, seed_b, antithetic, options.rounds, metric));
+    }
+
+    // One difference per independent unit (an antithetic pair is averaged)
+    std::vector<double> differences;
+    for (std::size_t i = 0; i < n; i += (options.antithetic ? 2 : 1)) {
+        double difference = report.metrics_a[i] - report.metrics_b[i];
+        if (options.antithetic) {
+            difference =
+                (difference + report.metrics_a[i + 1] - report.metrics_b[i + 1]) /
+                2.0;
+        }
+        differences.push_back(difference);
+    }
+
+    report.mean_a = mean(report.metrics_a);
+    report.mean_b = mean(report.metrics_b);
+    report.mean_difference = mean(differences);
+    report.achieved_variance =
+        sample_variance(differences) / static_cast<double>(n_units);
+    report.independent_variance =
+        (sample_variance(report.metrics_a) + sample_variance(report.metrics_b)) /
+        static_cast<double>(n);
+    report.half_width = 1.96 * std::sqrt(report.achieved_variance);
+    if (report.achieved_variance > 0.0) {
+        report.variance_reduction =
+            report.independent_variance / report.achieved_variance;
+    } else if (report.independent_variance > 0.0) {
+        report.variance_reduction = std::numeric_limits<double>::infinity();
+    }
+    report.equivalent_replications =
+        static_cast<double>(n) * report.variance_reduction;
+    return report;
+}
+
+void print_comparison_report(std::ostream &os, const ComparisonReport &report) {
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+
+    os << "== COMPARISON ==" << std::endl;
+    os << std::fixed << std::setprecision(3);
+    os << "Replications: " << report.n_replications << std::endl;
+    os << "Mean A: " << report.mean_a << std::endl;
+    os << "Mean B: " << report.mean_b << std::endl;
+    os << "Difference A-B: " << report.mean_difference << " +/- "
+       << report.half_width << " (95%)" << std::endl;
+    os << "Variance of difference: " << report.achieved_variance
+       << " (independent: " << report.independent_variance << ")" << std::endl;
+    os << "Variance reduction: " << report.variance_reduction
+       << "x, equivalent to " << report.equivalent_replications
+       << " independent replications" << std::endl;
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+} // namespace NetSim
@@ -0,0 +1,292 @@
+#include "../include/reports.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <utility>
+
+namespace NetSim {
+
+namespace {
+void append_int(std::string &s, long long value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    s.append(digits, result.ptr);
+}
+
+void append_package(std::string &s, ElementID id) {
+    s += '#';
+    append_int(s, id);
+}
+
+void append_packages(std::string &s, const std::vector<ElementID> &ids,
+                     std::size_t begin, std::size_t end) {
+    if (begin == end) {
+        s += "(empty)";
+        return;
+    }
+    for (std::size_t i = begin; i < end; ++i) {
+        if (i != begin) {
+            s += ", ";
+        }
+        append_package(s, ids[i]);
+    }
+}
+
+/**
+ * @brief Writes receivers of a sender sorted by type (storehouses first),
+ * then by ID
+ */
+void write_receivers(const ReceiverPreferences &prefs, std::ostream &os) {
+    std::vector<std::pair<ReceiverType, ElementID>> receivers;
+    for (const auto &pair : prefs) {
+        receivers.emplace_back(pair.first->get_receiver_type(),
+                               pair.first->get_id());
+    }
+    std::sort(receivers.begin(), receivers.end(),
+              [](const auto &a, const auto &b) {
+                  if (a.first != b.first) {
+                      return a.first == ReceiverType::STOREHOUSE;
+                  }
+                  return a.second < b.second;
+              });
+
+    os << "  Receivers:\n";
+    for (const auto &receiver : receivers) {
+        os << "    "
+           << (receiver.first == ReceiverType::STOREHOUSE ? "storehouse"
+                                                          : "worker")
+           << " #" << receiver.second << "\n";
+    }
+}
+} // namespace
+
+// STRUCTURE REPORT
+
+void generate_structure_report(const Factory &f, std::ostream &os) {
+    os << "\n== LOADING RAMPS ==\n\n";
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        os << "LOADING RAMP #" << it->get_id() << "\n";
+        os << "  Delivery interval: " << it->get_delivery_interval() << "\n";
+        write_receivers(it->get_receiver_preferences(), os);
+        os << "\n";
+    }
+
+    os << "\n== WORKERS ==\n\n";
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        os << "WORKER #" << it->get_id() << "\n";
+        os << "  Processing time: " << it->get_processing_duration() << "\n";
+        os << "  Queue type: "
+           << (it->get_queue()->get_queue_type() == PackageQueueType::FIFO
+                   ? "FIFO"
+                   : "LIFO")
+           << "\n";
+        write_receivers(it->get_receiver_preferences(), os);
+        os << "\n";
+    }
+
+    os << "\n== STOREHOUSES ==\n\n";
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        os << "STOREHOUSE #" << it->get_id() << "\n\n";
+    }
+}
+
+// MEMORY REPORT
+
+void generate_memory_report(const MemoryReport &report, std::ostream &os) {
+    os << "\n== MEMORY ==\n\n";
+    for (std::size_t c = 0; c < N_MEMORY_CATEGORIES; ++c) {
+        const MemoryUsage &usage = report.categories[c];
+        os << memory_category_name(static_cast<MemoryCategory>(c)) << ": "
+           << usage.bytes << " B in " << usage.blocks << " blocks (peak "
+           << usage.peak_bytes << " B, " << usage.allocations
+           << " allocations)\n";
+    }
+    os << "total: " << report.total_bytes() << " B\n";
+}
+
+// TURN REPORT
+
+void take_snapshot(const Factory &f, Time t, TurnSnapshot &snapshot,
+                   bool with_stock) {
+    snapshot.t = t;
+    snapshot.ramps.clear(); // keeps capacity - no allocation on reuse
+    snapshot.workers.clear();
+    snapshot.storehouses.clear();
+    snapshot.package_ids.clear();
+
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        const auto &sending = it->get_sending_buffer();
+        snapshot.ramps.push_back(
+            {it->get_id(),
+             sending ? sending->get_id() : TurnSnapshot::NO_PACKAGE});
+    }
+
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        TurnSnapshot::WorkerState state;
+        state.id = it->get_id();
+
+        const auto &processing = it->get_processing_buffer();
+        state.processed_package =
+            processing ? processing->get_id() : TurnSnapshot::NO_PACKAGE;
+        state.processing_time = t - it->get_product_processing_start_time() + 1;
+
+        const auto &sending = it->get_sending_buffer();
+        state.sending_package =
+            sending ? sending->get_id() : TurnSnapshot::NO_PACKAGE;
+
+        state.queue_begin = snapshot.package_ids.size();
+        for (const auto &package : *it) {
+            snapshot.package_ids.push_back(package.get_id());
+        }
+        state.queue_end = snapshot.package_ids.size();
+
+        snapshot.workers.push_back(state);
+    }
+
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        TurnSnapshot::StorehouseState state;
+        state.id = it->get_id();
+        state.stock_begin = snapshot.package_ids.size();
+        if (with_stock) {
+            for (const auto &package : *it) {
+                snapshot.package_ids.push_back(package.get_id());
+            }
+        }
+        state.stock_end = snapshot.package_ids.size();
+        snapshot.storehouses.push_back(state);
+    }
+}
+
+void format_turn_report(const TurnSnapshot &snapshot, std::string &out) {
+    out += "=== [ Turn: ";
+    append_int(out, snapshot.t);
+    out += " ] ===\n\n== WORKERS ==\n\n";
+
+    for (const auto &worker : snapshot.workers) {
+        out += "WORKER #";
+        append_int(out, worker.id);
+        out += "\n  PBuffer: ";
+        if (worker.processed_package != TurnSnapshot::NO_PACKAGE) {
+            append_package(out, worker.processed_package);
+            out += " (pt = ";
+            append_int(out, worker.processing_time);
+            out += ")";
+        } else {
+            out += "(empty)";
+        }
+        out += "\n  Queue: ";
+        append_packages(out, snapshot.package_ids, worker.queue_begin,
+                        worker.queue_end);
+        out += "\n  SBuffer: ";
+        if (worker.sending_package != TurnSnapshot::NO_PACKAGE) {
+            append_package(out, worker.sending_package);
+        } else {
+            out += "(empty)";
+        }
+        out += "\n\n";
+    }
+
+    out += "\n== STOREHOUSES ==\n\n";
+    for (const auto &storehouse : snapshot.storehouses) {
+        out += "STOREHOUSE #";
+        append_int(out, storehouse.id);
+        out += "\n  Stock: ";
+        append_packages(out, snapshot.package_ids, storehouse.stock_begin,
+                        storehouse.stock_end);
+        out += "\n\n";
+    }
+}
+
+void generate_simulation_turn_report(const Factory &f, std::ostream &os,
+                                     Time t) {
+    TurnSnapshot snapshot;
+    take_snapshot(f, t, snapshot);
+    std::string out;
+    format_turn_report(snapshot, out);
+    os << out;
+}
+
+// ASYNCHRONOUS REPORT WRITER
+
+AsyncReportWriter::AsyncReportWriter(std::ostream &os,
+                                     std::size_t queue_capacity,
+                                     std::size_t write_buffer_size)
+    : os_(os), write_buffer_size_(write_buffer_size),
+      capacity_(std::max<std::size_t>(queue_capacity, 1)) {
+    writer_ = std::thread(&AsyncReportWriter::writer_loop, this);
+}
+
+AsyncReportWriter::~AsyncReportWriter() { close(); }
+
+void AsyncReportWriter::publish(const Factory &f, Time t) {
+    std::unique_ptr<TurnSnapshot> snapshot;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return pending_.size() < capacity_; });
+        if (!free_.empty()) {
+            snapshot = std::move(free_.back());
+            free_.pop_back();
+        }
+    }
+    if (!snapshot) {
+        snapshot = std::make_unique<TurnSnapshot>();
+    }
+
+    take_snapshot(f, t, *snapshot); // the only per-turn work of the caller
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(std::move(snapshot));
+    }
+    not_empty_.notify_one();
+}
+
+void AsyncReportWriter::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    not_empty_.notify_one();
+    writer_.join();
+    os_.flush();
+}
+
+void AsyncReportWriter::writer_loop() {
+    std::string buffer;
+    buffer.reserve(write_buffer_size_);
+
+    while (true) {
+        std::unique_ptr<TurnSnapshot> snapshot;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock,
+                            [this] { return stop_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                break; // stopped and nothing left
+            }
+            snapshot = std::move(pending_.front());
+            pending_.pop_front();
+        }
+        not_full_.notify_one();
+
+        format_turn_report(*snapshot, buffer);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(std::move(snapshot));
+        }
+
+        if (buffer.size() >= write_buffer_size_) {
+            os_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+
+    os_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+} // namespace NetSim
@@ -0,0 +1,74 @@
+#include "../include/routing_policies.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace NetSim {
+
+const std::vector<IPackageReceiver *> &
+IndexedRoutingPolicy::get_receivers(const ReceiverPreferences &prefs) {
+    if (cached_for_ != &prefs || revision_ != prefs.get_revision()) {
+        receivers_.clear();
+        for (const auto &pair : prefs) {
+            receivers_.push_back(pair.first);
+        }
+        cached_for_ = &prefs;
+        revision_ = prefs.get_revision();
+    }
+    return receivers_;
+}
+
+IPackageReceiver *RoundRobinPolicy::choose(const ReceiverPreferences &prefs,
+                                           ProbabilityGenerator &) {
+    const auto &receivers = get_receivers(prefs);
+    if (receivers.empty()) {
+        return nullptr;
+    }
+    if (next_ >= receivers.size()) {
+        next_ = 0; // receivers removed meanwhile
+    }
+    IPackageReceiver *receiver = receivers[next_];
+    next_ = (next_ + 1) % receivers.size();
+    return receiver;
+}
+
+PowerOfDPolicy::PowerOfDPolicy(std::size_t d) : d_(d) {
+    if (d == 0) {
+        throw std::logic_error("Power of d choices needs d > 0.");
+    }
+}
+
+IPackageReceiver *PowerOfDPolicy::choose(const ReceiverPreferences &prefs,
+                                         ProbabilityGenerator &pg) {
+    const auto &receivers = get_receivers(prefs);
+    std::size_t k = receivers.size();
+    if (k == 0) {
+        return nullptr;
+    }
+    IPackageReceiver *best = nullptr;
+    for (std::size_t i = 0; i < d_; ++i) {
+        std::size_t index = std::min(
+            static_cast<std::size_t>(pg() * static_cast<double>(k)), k - 1);
+        IPackageReceiver *candidate = receivers[index];
+        if (!best || candidate->get_load() < best->get_load()) {
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+bool uses_routing_policies(const Factory &f) {
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        if (it->get_receiver_preferences().get_routing_policy()) {
+            return true;
+        }
+    }
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        if (it->get_receiver_preferences().get_routing_policy()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace NetSim
@@ -0,0 +1,27 @@
+#include "../include/routing_streams.hpp"
+#include "../include/helpers.hpp"
+
+namespace NetSim {
+
+std::uint64_t routing_stream_id(NodeType type, ElementID id) {
+    // Node kind in the high half (ramp 0, worker 1), ID in the low half
+    std::uint64_t kind = type == NodeType::RAMP ? 0 : 1;
+    return (kind << 32) | static_cast<std::uint32_t>(id);
+}
+
+void seed_routing_streams(Factory &f, std::uint64_t seed, bool antithetic) {
+    for (auto it = f.ramp_begin(); it != f.ramp_end(); ++it) {
+        it->get_receiver_preferences().set_probability_generator(
+            make_stream_generator(
+                seed, routing_stream_id(NodeType::RAMP, it->get_id()),
+                antithetic));
+    }
+    for (auto it = f.worker_begin(); it != f.worker_end(); ++it) {
+        it->get_receiver_preferences().set_probability_generator(
+            make_stream_generator(
+                seed, routing_stream_id(NodeType::WORKER, it->get_id()),
+                antithetic));
+    }
+}
+
+} // namespace NetSim
@@ -0,0 +1,206 @@
+#include "../include/simulation.hpp"
+#include "../include/time_travel.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+
+namespace NetSim {
+
+// STEADY STATE DETECTOR
+
+SteadyStateDetector::SteadyStateDetector(const SteadyStateOptions &options)
+    : options_(options), batch_length_(options.batch_length) {
+    if (options_.batch_length <= 0) {
+        throw std::invalid_argument("Batch length must be positive.");
+    }
+    if (options_.max_batches % 2 != 0 ||
+        options_.max_batches < 2 * std::max<std::size_t>(options_.min_batches,
+                                                         2)) {
+        throw std::invalid_argument(
+            "Max batches must be even and at least twice min batches.");
+    }
+}
+
+void SteadyStateDetector::observe(const Factory &f, Time t) {
+    std::size_t n_workers = static_cast<std::size_t>(
+        std::distance(f.worker_cbegin(), f.worker_cend()));
+    std::size_t n_storehouses = static_cast<std::size_t>(
+        std::distance(f.storehouse_cbegin(), f.storehouse_cend()));
+
+    // Series layout: all workers first, then all storehouses
+    if (series_.size() != n_workers + n_storehouses) {
+        series_.assign(n_workers + n_storehouses, Series{});
+        for (auto &series : series_) {
+            series.batch_means.reserve(options_.max_batches);
+        }
+        n_batches_ = 0;
+        batch_length_ = options_.batch_length;
+        last_storehouse_sizes_.assign(n_storehouses, 0);
+        std::size_t i = 0;
+        for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+            last_storehouse_sizes_[i++] = it->get_stockpile()->size();
+        }
+        steady_ = false;
+    }
+
+    std::size_t i = 0;
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        series_[i++].batch_sum += static_cast<double>(it->get_queue()->size());
+    }
+    std::size_t j = 0;
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        std::size_t size = it->get_stockpile()->size();
+        series_[i++].batch_sum +=
+            static_cast<double>(size - last_storehouse_sizes_[j]);
+        last_storehouse_sizes_[j++] = size;
+    }
+
+    if (t % batch_length_ == 0) { // end of a batch
+        for (auto &series : series_) {
+            series.batch_means.push_back(series.batch_sum / batch_length_);
+            series.batch_sum = 0.0;
+        }
+        ++n_batches_;
+        evaluate();
+        if (n_batches_ == options_.max_batches) {
+            merge_batches();
+        }
+    }
+}
+
+void SteadyStateDetector::merge_batches() {
+    // max_batches is even, so batches stay aligned with t % batch_length_
+    for (auto &series : series_) {
+        std::vector<double> &means = series.batch_means;
+        for (std::size_t k = 0; k < n_batches_ / 2; ++k) {
+            means[k] = (means[2 * k] + means[2 * k + 1]) / 2.0;
+        }
+        means.resize(n_batches_ / 2);
+    }
+    n_batches_ /= 2;
+    batch_length_ *= 2;
+}
+
+std::size_t
+SteadyStateDetector::mser_truncation(const std::vector<double> &means) {
+    // MSER: pick d minimizing the variance of the remaining batch means
+    // divided by their count; only the first half is considered as warm-up
+    std::size_t n = means.size();
+    double suffix_sum = 0.0;
+    double suffix_sq_sum = 0.0;
+    std::size_t best_d = 0;
+    double best_score = -1.0;
+
+    for (std::size_t d = n; d-- > 0;) {
+        suffix_sum += means[d];
+        suffix_sq_sum += means[d] * means[d];
+        if (d > n / 2) {
+            continue;
+        }
+        double m = static_cast<double>(n - d);
+        double mean = suffix_sum / m;
+        double score = (suffix_sq_sum / m - mean * mean) / m;
+        if (best_score < 0.0 || score <= best_score) {
+            best_score = score;
+            best_d = d;
+        }
+    }
+    return best_d;
+}
+
+bool SteadyStateDetector::is_series_settled(const Series &series,
+                                            std::size_t truncation) const {
+    std::size_t m = series.batch_means.size() - truncation;
+    if (m < options_.min_batches || m < 2) {
+        return false;
+    }
+
+    double sum = 0.0;
+    for (std::size_t k = truncation; k < series.batch_means.size(); ++k) {
+        sum += series.batch_means[k];
+    }
+    double mean = sum / m;
+
+    double sq_dev = 0.0;
+    for (std::size_t k = truncation; k < series.batch_means.size(); ++k) {
+        double dev = series.batch_means[k] - mean;
+        sq_dev += dev * dev;
+    }
+    double std_error = std::sqrt(sq_dev / (m - 1) / m);
+    double half_width = options_.z * std_error;
+
+    return half_width <= std::max(options_.relative_half_width *
+                                      std::fabs(mean),
+                                  options_.absolute_half_width);
+}
+
+void SteadyStateDetector::evaluate() {
+    bool all_settled = true;
+    std::size_t longest_truncation = 0;
+
+    for (const auto &series : series_) {
+        std::size_t truncation = mser_truncation(series.batch_means);
+        longest_truncation = std::max(longest_truncation, truncation);
+        if (!is_series_settled(series, truncation)) {
+            all_settled = false;
+        }
+    }
+
+    warmup_length_ = static_cast<Time>(longest_truncation) * batch_length_;
+    steady_ = all_settled;
+}
+
+// SIMULATION
+
+void simulate(Factory &f, TimeOffset d,
+              std::function<void(Factory &, Time)> rf) {
+    simulate(f, d, std::move(rf), SteadyStateOptions{});
+}
+
+SimulationSummary simulate(Factory &f, TimeOffset d,
+                           std::function<void(Factory &, Time)> rf,
+                           const SteadyStateOptions &options) {
+    if (!f.is_consistent()) {
+        throw std::logic_error("Net is not consistent.");
+    }
+
+    SimulationSummary summary;
+    summary.horizon = d;
+
+    SteadyStateDetector detector(options);
+
+    for (Time t = 1; t <= d; ++t) {
+        if (trace_sink) {
+            trace_sink->set_round(t);
+        }
+        if (package_move_listener) {
+            package_move_listener->on_round(t);
+        }
+        f.do_deliveries(t);
+        f.do_package_passing();
+        f.do_work(t);
+
+        if (rf) {
+            rf(f, t);
+        }
+        summary.rounds_run = t;
+
+        if (options.enabled) {
+            detector.observe(f, t);
+            if (detector.is_steady()) {
+                summary.steady_state_reached = true;
+                break;
+            }
+        }
+    }
+
+    summary.warmup_length = detector.get_warmup_length();
+    summary.rounds_saved = summary.horizon - summary.rounds_run;
+    summary.memory = f.get_memory_report();
+    return summary;
+}
+
+} // namespace NetSim
@@ -2,50 +2,80 @@
 #include <stdexcept> // for throwing runtime_error
 namespace NetSim {
 
-PackageQueue::PackageQueue(PackageQueueType type) : queue_type_(type) {}
+PackageQueue::PackageQueue(PackageQueueType type,
+                           std::pmr::memory_resource *resource)
+    : table_(&default_package_table()), handles_(type, resource) {}
+
+PackageQueue::~PackageQueue() {
+  while (!handles_.empty()) {
+    table_->release(handles_.pop_back());
+  }
+}
 
 void PackageQueue::push(Package &&package) {
   // Element should always be places at the back
-  deque_.emplace_back(std::move(
-      package)); // std::move only moves the content of "package", "package"
-                 // remains empy and is removed at the end of scope
+  handles_.push(table_->create(std::move(
+      package))); // the package is moved into the table once, the queue
+                  // keeps only its handle
 }
 
-bool PackageQueue::empty() const { return deque_.empty(); }
+void PackageQueue::push(PackageHandle handle) { handles_.push(handle); }
 
-size_t PackageQueue::size() const { return deque_.size(); }
+bool PackageQueue::empty() const { return handles_.empty(); }
 
-PackageQueueType PackageQueue::get_queue_type() const { return queue_type_; }
+size_t PackageQueue::size() const { return handles_.size(); }
 
-Package PackageQueue::pop() {
-  switch (queue_type_) {
-  case PackageQueueType::FIFO: {
-    Package p = std::move(
-        deque_.front()); // Content of the deque_.front is now in "p" but
-                         // deque_.front still exist (as an empty container)
-    deque_.pop_front();  // Remove the empty container
-    return p;
+PackageQueueType PackageQueue::get_queue_type() const {
+  return handles_.get_queue_type();
+}
+
+PackageTable &PackageQueue::get_package_table() const { return *table_; }
+
+void PackageQueue::set_package_table(PackageTable &table) {
+  if (&table == table_) {
+    return;
   }
-  case PackageQueueType::LIFO: {
-    Package p = std::move(deque_.back());
-    deque_.pop_back();
-    return p;
+  PackageHandleQueue moved(handles_.get_queue_type(),
+                           handles_.get_memory_resource());
+  for (std::size_t i = 0; i < handles_.size(); ++i) { // order kept
+    moved.push(table.create(table_->take(handles_[i])));
   }
+  handles_.clear();
+  handles_.take_all(moved);
+  table_ = &table;
+}
+
+std::unique_ptr<IPackageQueue> PackageQueue::relocate() {
+  auto fresh = std::make_unique<PackageQueue>(handles_.get_queue_type(),
+                                              handles_.get_memory_resource());
+  fresh->table_ = table_;
+  fresh->handles_.take_all(handles_); // order kept for FIFO and LIFO
+  return fresh;
+}
+
+Package PackageQueue::pop() {
+  return table_->take(pop_handle()); // leaves the simulation as a Package
+}
+
+PackageHandle PackageQueue::pop_handle() {
+  switch (handles_.get_queue_type()) {
+  case PackageQueueType::FIFO:
+    return handles_.pop_front();
+  case PackageQueueType::LIFO:
+    return handles_.pop_back();
   default:
     throw std::runtime_error("Unknown queue type.");
   }
 }
 // Iterators implementation
 IPackageStockpile::const_iterator PackageQueue::begin() const {
-  return deque_.begin();
+  return {table_, &handles_, 0};
 }
 IPackageStockpile::const_iterator PackageQueue::end() const {
-  return deque_.end();
+  return {table_, &handles_, handles_.size()};
 }
 IPackageStockpile::const_iterator PackageQueue::cbegin() const {
-  return deque_.cbegin();
-}
-IPackageStockpile::const_iterator PackageQueue::cend() const {
-  return deque_.cend();
+  return begin();
 }
-} // namespace NetSim
\ No newline at end of file
+IPackageStockpile::const_iterator PackageQueue::cend() const { return end(); }
+} // namespace NetSim
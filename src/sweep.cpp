@@ -0,0 +1,318 @@
+#include "../include/sweep.hpp"
+#include "../include/counting_engine.hpp"
+#include "../include/helpers.hpp"
+#include "../include/routing_policies.hpp"
+#include "../include/routing_streams.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace NetSim {
+
+// TOPOLOGY
+
+Topology make_topology(const Factory &f) {
+    if (uses_routing_policies(f)) {
+        throw std::logic_error("Sweep topology needs probability routing.");
+    }
+    Topology topology;
+    std::map<const IPackageReceiver *, std::uint32_t> receiver_index;
+
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        if (it->get_queue_capacity() != 0) {
+            throw std::logic_error("Sweep topology needs unbounded queues.");
+        }
+        if (it->get_behaviour()) {
+            throw std::logic_error(
+                "Sweep topology needs fixed-duration workers.");
+        }
+        receiver_index[&*it] =
+            static_cast<std::uint32_t>(topology.worker_ids.size());
+        topology.worker_ids.push_back(it->get_id());
+        topology.processing_durations.push_back(it->get_processing_duration());
+    }
+    for (auto it = f.storehouse_cbegin(); it != f.storehouse_cend(); ++it) {
+        receiver_index[&*it] = static_cast<std::uint32_t>(
+            topology.worker_ids.size() + topology.storehouse_ids.size());
+        topology.storehouse_ids.push_back(it->get_id());
+    }
+
+    auto add_links = [&](const PackageSender &sender) {
+        double distribution = 0.0; // summed as in choose_receiver
+        for (const auto &pair : sender.get_receiver_preferences()) {
+            distribution += pair.second;
+            topology.link_receivers.push_back(receiver_index.at(pair.first));
+            topology.link_thresholds.push_back(distribution);
+        }
+        topology.link_offsets.push_back(topology.link_receivers.size());
+    };
+
+    topology.link_offsets.push_back(0);
+    for (auto it = f.ramp_cbegin(); it != f.ramp_cend(); ++it) {
+        topology.ramp_ids.push_back(it->get_id());
+        topology.delivery_intervals.push_back(it->get_delivery_interval());
+        topology.routing_streams.push_back(
+            routing_stream_id(NodeType::RAMP, it->get_id()));
+        add_links(*it);
+    }
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        topology.routing_streams.push_back(
+            routing_stream_id(NodeType::WORKER, it->get_id()));
+        add_links(*it);
+    }
+    return topology;
+}
+
+std::vector<SweepPoint> make_sweep_grid(const std::vector<SweepAxis> &axes,
+                                        std::uint64_t seed) {
+    std::vector<SweepPoint> points(1);
+    points[0].seed = seed;
+    for (const auto &axis : axes) {
+        std::vector<SweepPoint> extended;
+        extended.reserve(points.size() * axis.values.size());
+        for (const auto &point : points) {
+            for (TimeOffset value : axis.values) {
+                SweepPoint next = point;
+                if (axis.type == NodeType::RAMP) {
+                    next.delivery_intervals[axis.id] = value;
+                } else {
+                    next.processing_durations[axis.id] = value;
+                }
+                extended.push_back(std::move(next));
+            }
+        }
+        points.swap(extended);
+    }
+    return points;
+}
+
+// ONE POINT
+
+namespace {
+/**
+ * @brief Mutable state of one point - the only per-point memory
+ */
+struct PointState {
+    std::vector<TimeOffset> intervals;
+    std::vector<TimeOffset> durations;
+    std::vector<std::mt19937_64> engines; // one per sender
+    CountingState counts;
+};
+
+/**
+ * @brief The topology with the values of one point, as the counting
+ * engine reads it
+ */
+struct PointNet {
+    const Topology &topology;
+    PointState &state;
+
+    std::size_t get_ramp_count() const { return topology.ramp_ids.size(); }
+    std::size_t get_worker_count() const { return topology.worker_ids.size(); }
+    std::size_t get_storehouse_count() const {
+        return topology.storehouse_ids.size();
+    }
+    TimeOffset get_delivery_interval(std::size_t r) const {
+        return state.intervals[r];
+    }
+    TimeOffset get_processing_duration(std::size_t w) const {
+        return state.durations[w];
+    }
+
+    bool route(std::size_t s, std::uint32_t &receiver) {
+        std::size_t first = topology.link_offsets[s];
+        std::size_t n = topology.link_offsets[s + 1] - first;
+        double p = std::generate_canonical<double, 10>(state.engines[s]);
+        if (n == 0) {
+            return false;
+        }
+        receiver = topology.link_receivers[
+            first + choose_link(&topology.link_thresholds[first], n, p)];
+        return true;
+    }
+};
+
+std::size_t find_index(const std::vector<ElementID> &ids, ElementID id,
+                       const char *what) {
+    auto it = std::find(ids.begin(), ids.end(), id);
+    if (it == ids.end()) {
+        throw std::logic_error(std::string("Sweep point overrides unknown ") +
+                               what + ".");
+    }
+    return static_cast<std::size_t>(it - ids.begin());
+}
+
+void check_value(TimeOffset value) {
+    if (value <= 0) {
+        throw std::logic_error("Sweep point value must be positive.");
+    }
+}
+
+/**
+ * @brief Resets the state for a point, keeping the allocated memory
+ */
+void prepare(const Topology &topology, const SweepPoint &point,
+             PointState &state) {
+    state.intervals = topology.delivery_intervals;
+    for (const auto &pair : point.delivery_intervals) {
+        check_value(pair.second);
+        state.intervals[find_index(topology.ramp_ids, pair.first, "ramp")] =
+            pair.second;
+    }
+    state.durations = topology.processing_durations;
+    for (const auto &pair : point.processing_durations) {
+        check_value(pair.second);
+        state.durations[find_index(topology.worker_ids, pair.first,
+                                   "worker")] = pair.second;
+    }
+
+    std::size_t n_senders = topology.get_sender_count();
+    state.engines.resize(n_senders);
+    for (std::size_t s = 0; s < n_senders; ++s) {
+        state.engines[s].seed(
+            stream_seed(point.seed, topology.routing_streams[s]));
+    }
+}
+
+void run_point(const Topology &topology, PointState &state, TimeOffset d) {
+    PointNet net{topology, state};
+    run_counting_rounds(net, state.counts, d);
+}
+
+SweepResult summarize(const Topology &topology, const CountingState &state,
+                      TimeOffset d) {
+    SweepResult result;
+    std::size_t n_workers = topology.worker_ids.size();
+    for (std::size_t stock : state.stock) {
+        result.delivered += stock;
+    }
+    for (std::size_t w = 0; w < n_workers; ++w) {
+        result.in_progress += state.queues[w] + state.busy[w];
+    }
+    for (std::uint8_t sending : state.sending) {
+        result.in_progress += sending;
+    }
+    result.max_queue = state.max_queue;
+    if (n_workers > 0) {
+        result.max_queue_worker = topology.worker_ids[state.max_queue_worker];
+    }
+    if (d > 0) {
+        result.mean_queue = static_cast<double>(state.queue_sum) / d;
+        if (n_workers > 0) {
+            result.mean_utilization =
+                static_cast<double>(state.busy_rounds) / (d * n_workers);
+        }
+    }
+    return result;
+}
+} // namespace
+
+SweepResult run_sweep_point(const Topology &topology, const SweepPoint &point,
+                            TimeOffset d) {
+    PointState state;
+    prepare(topology, point, state);
+    run_point(topology, state, d);
+    return summarize(topology, state.counts, d);
+}
+
+NodeCounts sweep_point_counts(const Topology &topology,
+                              const SweepPoint &point, TimeOffset d) {
+    PointState state;
+    prepare(topology, point, state);
+    run_point(topology, state, d);
+
+    NodeCounts counts;
+    std::size_t n_ramps = topology.ramp_ids.size();
+    const CountingState &end = state.counts;
+    for (std::size_t w = 0; w < topology.worker_ids.size(); ++w) {
+        ElementID id = topology.worker_ids[w];
+        counts.worker_queues[id] = end.queues[w];
+        counts.worker_busy[id] = end.busy[w];
+        counts.worker_sending[id] = end.sending[n_ramps + w];
+    }
+    for (std::size_t s = 0; s < topology.storehouse_ids.size(); ++s) {
+        counts.storehouse_stock[topology.storehouse_ids[s]] = end.stock[s];
+    }
+    return counts;
+}
+
+// SWEEP
+
+std::vector<SweepResult> run_sweep(const Topology &topology,
+                                   const std::vector<SweepPoint> &points,
+                                   TimeOffset d, unsigned n_threads) {
+    // Invalid points are reported before any thread starts
+    {
+        PointState state;
+        for (const auto &point : points) {
+            prepare(topology, point, state);
+        }
+    }
+
+    if (n_threads == 0) {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    n_threads = static_cast<unsigned>(
+        std::min<std::size_t>(n_threads, std::max<std::size_t>(1, points.size())));
+
+    std::vector<SweepResult> results(points.size());
+    std::atomic<std::size_t> next_point{0};
+    auto worker = [&]() {
+        PointState state; // reused for all points of this thread
+        for (std::size_t i = next_point++; i < points.size(); i = next_point++) {
+            prepare(topology, points[i], state);
+            run_point(topology, state, d);
+            results[i] = summarize(topology, state.counts, d);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < n_threads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker(); // calling thread works too
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    return results;
+}
+
+void print_sweep_table(std::ostream &os, const std::vector<SweepPoint> &points,
+                       const std::vector<SweepResult> &results) {
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+
+    os << "== SWEEP ==" << std::endl;
+    os << "point;parameters;delivered;in progress;mean queue;max queue;"
+          "utilization"
+       << std::endl;
+    os << std::fixed << std::setprecision(3);
+    for (std::size_t i = 0; i < points.size() && i < results.size(); ++i) {
+        os << i << ";";
+        const char *separator = "";
+        for (const auto &pair : points[i].delivery_intervals) {
+            os << separator << "LOADING RAMP #" << pair.first << "="
+               << pair.second;
+            separator = " ";
+        }
+        for (const auto &pair : points[i].processing_durations) {
+            os << separator << "WORKER #" << pair.first << "=" << pair.second;
+            separator = " ";
+        }
+        const SweepResult &result = results[i];
+        os << ";" << result.delivered << ";" << result.in_progress << ";"
+           << result.mean_queue << ";" << result.max_queue << " (WORKER #"
+           << result.max_queue_worker << ");" << result.mean_utilization
+           << std::endl;
+    }
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+} // namespace NetSim
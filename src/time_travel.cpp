@@ -0,0 +1,346 @@
+#include "../include/time_travel.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace NetSim {
+
+IPackageMoveListener *package_move_listener = nullptr;
+
+namespace {
+// Event: varint (value << 3 | op), then the package ID if the op has one
+enum Op : unsigned {
+    ROUND = 0,   // value - round number
+    DELIVERY,    // value - ramp ID
+    TO_WORKER,   // value - worker ID
+    TO_STOREHOUSE, // value - storehouse ID
+    START,       // value - worker ID
+    FINISH       // value - worker ID, no package
+};
+
+void put_varint(std::string &out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+std::uint64_t get_varint(const std::string &in, std::size_t &pos) {
+    std::uint64_t value = 0;
+    int shift = 0;
+    while (true) {
+        auto byte = static_cast<std::uint8_t>(in[pos++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+        shift += 7;
+    }
+}
+
+std::uint64_t encode_id(ElementID id) {
+    return static_cast<std::uint32_t>(id);
+}
+
+ElementID decode_id(std::uint64_t value) {
+    return static_cast<ElementID>(static_cast<std::uint32_t>(value));
+}
+
+/**
+ * @brief State being replayed, nodes in the checkpoint order
+ */
+struct ReplayState {
+    struct Worker {
+        ElementID id;
+        std::deque<ElementID> queue;
+        ElementID processing;
+        Time start;
+        ElementID sending;
+    };
+
+    ReplayState(const TurnSnapshot &checkpoint,
+                const std::vector<std::size_t> &stock_sizes);
+
+    std::size_t find(const std::unordered_map<ElementID, std::size_t> &index,
+                     ElementID id) const;
+
+    /**
+     * @brief Empties the output buffer holding the package
+     */
+    void take_from_sender(ElementID package_id);
+
+    /**
+     * @brief Writes the state, stock taken from the recorded history
+     */
+    void write(Time t, const std::vector<std::vector<ElementID>> &stock,
+               TurnSnapshot &snapshot) const;
+
+    std::vector<TurnSnapshot::RampState> ramps;
+    std::vector<Worker> workers;
+    std::vector<std::pair<ElementID, std::size_t>> storehouses; // stock size
+    std::unordered_map<ElementID, std::size_t> ramp_index, worker_index,
+        storehouse_index;
+    // Package in an output buffer -> (is ramp, node index)
+    std::unordered_map<ElementID, std::pair<bool, std::size_t>> senders;
+};
+
+ReplayState::ReplayState(const TurnSnapshot &checkpoint,
+                         const std::vector<std::size_t> &stock_sizes)
+    : ramps(checkpoint.ramps) {
+    const auto &ids = checkpoint.package_ids;
+    for (std::size_t r = 0; r < ramps.size(); ++r) {
+        ramp_index.emplace(ramps[r].id, r);
+        if (ramps[r].sending_package != TurnSnapshot::NO_PACKAGE) {
+            senders[ramps[r].sending_package] = {true, r};
+        }
+    }
+    for (const auto &state : checkpoint.workers) {
+        std::size_t w = workers.size();
+        worker_index.emplace(state.id, w);
+        std::deque<ElementID> queue(ids.begin() + state.queue_begin,
+                                    ids.begin() + state.queue_end);
+        workers.push_back({state.id, std::move(queue),
+                           state.processed_package,
+                           checkpoint.t - state.processing_time + 1,
+                           state.sending_package});
+        if (state.sending_package != TurnSnapshot::NO_PACKAGE) {
+            senders[state.sending_package] = {false, w};
+        }
+    }
+    for (std::size_t s = 0; s < checkpoint.storehouses.size(); ++s) {
+        storehouse_index.emplace(checkpoint.storehouses[s].id, s);
+        storehouses.emplace_back(checkpoint.storehouses[s].id, stock_sizes[s]);
+    }
+}
+
+std::size_t
+ReplayState::find(const std::unordered_map<ElementID, std::size_t> &index,
+                  ElementID id) const {
+    auto it = index.find(id);
+    if (it == index.end()) {
+        throw std::runtime_error("Package move log does not match the Net.");
+    }
+    return it->second;
+}
+
+void ReplayState::take_from_sender(ElementID package_id) {
+    auto it = senders.find(package_id);
+    if (it == senders.end()) {
+        return; // package was put in from outside the Net
+    }
+    if (it->second.first) {
+        ramps[it->second.second].sending_package = TurnSnapshot::NO_PACKAGE;
+    } else {
+        workers[it->second.second].sending = TurnSnapshot::NO_PACKAGE;
+    }
+    senders.erase(it);
+}
+
+void ReplayState::write(Time t,
+                        const std::vector<std::vector<ElementID>> &stock,
+                        TurnSnapshot &snapshot) const {
+    snapshot.t = t;
+    snapshot.ramps = ramps;
+    snapshot.workers.clear();
+    snapshot.storehouses.clear();
+    snapshot.package_ids.clear();
+    for (const auto &worker : workers) {
+        TurnSnapshot::WorkerState state;
+        state.id = worker.id;
+        state.processed_package = worker.processing;
+        state.processing_time = t - worker.start + 1;
+        state.sending_package = worker.sending;
+        state.queue_begin = snapshot.package_ids.size();
+        snapshot.package_ids.insert(snapshot.package_ids.end(),
+                                    worker.queue.begin(), worker.queue.end());
+        state.queue_end = snapshot.package_ids.size();
+        snapshot.workers.push_back(state);
+    }
+    for (std::size_t s = 0; s < storehouses.size(); ++s) {
+        TurnSnapshot::StorehouseState state;
+        state.id = storehouses[s].first;
+        state.stock_begin = snapshot.package_ids.size();
+        snapshot.package_ids.insert(snapshot.package_ids.end(),
+                                    stock[s].begin(),
+                                    stock[s].begin() + storehouses[s].second);
+        state.stock_end = snapshot.package_ids.size();
+        snapshot.storehouses.push_back(state);
+    }
+}
+} // namespace
+
+// RECORDING
+
+TimeTravelRecorder::TimeTravelRecorder(const Factory &f,
+                                       Time checkpoint_interval)
+    : f_(f), interval_(checkpoint_interval) {
+    if (checkpoint_interval < 1) {
+        throw std::logic_error("Checkpoint interval must be at least 1.");
+    }
+}
+
+TimeTravelRecorder::~TimeTravelRecorder() {
+    if (package_move_listener == this) {
+        package_move_listener = nullptr;
+    }
+}
+
+void TimeTravelRecorder::put_event(unsigned op, std::uint64_t value) {
+    put_varint(log_, (value << 3) | op);
+}
+
+void TimeTravelRecorder::on_round(Time t) {
+    if (!checkpoints_.empty() && t <= round_) {
+        throw std::logic_error("Recorded rounds must increase.");
+    }
+    if (checkpoints_.empty() || (t - 1) % interval_ == 0) {
+        take_checkpoint(t - 1);
+    }
+    round_ = t;
+    put_event(ROUND, static_cast<std::uint64_t>(t));
+}
+
+void TimeTravelRecorder::take_checkpoint(Time t) {
+    if (checkpoints_.empty()) { // stock so far starts the history
+        for (auto it = f_.storehouse_cbegin(); it != f_.storehouse_cend();
+             ++it) {
+            storehouse_index_.emplace(it->get_id(), stock_history_.size());
+            stock_history_.emplace_back();
+            for (const auto &package : *it) {
+                stock_history_.back().push_back(package.get_id());
+            }
+        }
+    }
+    Checkpoint checkpoint;
+    take_snapshot(f_, t, checkpoint.state, false);
+    for (const auto &stock : stock_history_) {
+        checkpoint.stock_sizes.push_back(stock.size());
+    }
+    checkpoint.log_offset = log_.size();
+    checkpoints_.push_back(std::move(checkpoint));
+}
+
+void TimeTravelRecorder::on_delivery(ElementID ramp_id,
+                                     ElementID package_id) {
+    put_event(DELIVERY, encode_id(ramp_id));
+    put_varint(log_, encode_id(package_id));
+}
+
+void TimeTravelRecorder::on_receive(ReceiverType type, ElementID receiver_id,
+                                    ElementID package_id) {
+    if (type == ReceiverType::STOREHOUSE) {
+        auto it = storehouse_index_.find(receiver_id);
+        if (it == storehouse_index_.end()) {
+            throw std::logic_error("Storehouse added while recording.");
+        }
+        stock_history_[it->second].push_back(package_id);
+    }
+    put_event(type == ReceiverType::WORKER ? TO_WORKER : TO_STOREHOUSE,
+              encode_id(receiver_id));
+    put_varint(log_, encode_id(package_id));
+}
+
+void TimeTravelRecorder::on_start(ElementID worker_id, ElementID package_id) {
+    put_event(START, encode_id(worker_id));
+    put_varint(log_, encode_id(package_id));
+}
+
+void TimeTravelRecorder::on_finish(ElementID worker_id) {
+    put_event(FINISH, encode_id(worker_id));
+}
+
+// QUERIES
+
+Time TimeTravelRecorder::get_first_round() const {
+    if (checkpoints_.empty()) {
+        throw std::out_of_range("Nothing recorded yet.");
+    }
+    return checkpoints_.front().state.t;
+}
+
+void TimeTravelRecorder::reconstruct(Time t, TurnSnapshot &snapshot) const {
+    if (checkpoints_.empty() || t < checkpoints_.front().state.t ||
+        t > round_) {
+        throw std::out_of_range("Round " + std::to_string(t) +
+                                " was not recorded.");
+    }
+    // Last checkpoint taken after a round <= t
+    auto checkpoint = std::prev(std::upper_bound(
+        checkpoints_.begin(), checkpoints_.end(), t,
+        [](Time round, const Checkpoint &c) { return round < c.state.t; }));
+
+    ReplayState state(checkpoint->state, checkpoint->stock_sizes);
+    Time round = checkpoint->state.t;
+    std::size_t pos = checkpoint->log_offset;
+    while (pos < log_.size()) {
+        std::uint64_t event = get_varint(log_, pos);
+        std::uint64_t value = event >> 3;
+        switch (static_cast<Op>(event & 7)) {
+        case ROUND:
+            round = static_cast<Time>(value);
+            break;
+        case DELIVERY: {
+            std::size_t r = state.find(state.ramp_index, decode_id(value));
+            ElementID package = decode_id(get_varint(log_, pos));
+            state.ramps[r].sending_package = package;
+            state.senders[package] = {true, r};
+            break;
+        }
+        case TO_WORKER: {
+            std::size_t w = state.find(state.worker_index, decode_id(value));
+            ElementID package = decode_id(get_varint(log_, pos));
+            state.take_from_sender(package);
+            state.workers[w].queue.push_back(package);
+            break;
+        }
+        case TO_STOREHOUSE: {
+            std::size_t s =
+                state.find(state.storehouse_index, decode_id(value));
+            ElementID package = decode_id(get_varint(log_, pos));
+            state.take_from_sender(package);
+            ++state.storehouses[s].second; // next one in the history
+            break;
+        }
+        case START: {
+            auto &worker =
+                state.workers[state.find(state.worker_index, decode_id(value))];
+            ElementID package = decode_id(get_varint(log_, pos));
+            auto &queue = worker.queue;
+            if (!queue.empty() && queue.back() == package) {
+                queue.pop_back(); // LIFO
+            } else {
+                auto it = std::find(queue.begin(), queue.end(), package);
+                if (it == queue.end()) {
+                    throw std::runtime_error(
+                        "Package move log does not match the Net.");
+                }
+                queue.erase(it); // FIFO - the front
+            }
+            worker.processing = package;
+            worker.start = round;
+            break;
+        }
+        case FINISH: {
+            std::size_t w = state.find(state.worker_index, decode_id(value));
+            auto &worker = state.workers[w];
+            worker.sending = worker.processing;
+            worker.processing = TurnSnapshot::NO_PACKAGE;
+            state.senders[worker.sending] = {false, w};
+            break;
+        }
+        default:
+            throw std::runtime_error("Corrupted package move log.");
+        }
+        if (round > t) {
+            break; // marker of the round after t
+        }
+    }
+    state.write(t, stock_history_, snapshot);
+}
+
+} // namespace NetSim
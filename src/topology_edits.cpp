@@ -0,0 +1,271 @@
+#include "../include/topology_edits.hpp"
+
+#include <memory>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace NetSim {
+
+// BATCH
+
+void TopologyEditBatch::add_ramp(ElementID id, TimeOffset delivery_interval) {
+    edits_.push_back({EditType::ADD_NODE, {NodeType::RAMP, id}, {},
+                      delivery_interval, PackageQueueType::FIFO});
+}
+
+void TopologyEditBatch::remove_ramp(ElementID id) {
+    edits_.push_back({EditType::REMOVE_NODE, {NodeType::RAMP, id}, {}, 0,
+                      PackageQueueType::FIFO});
+}
+
+void TopologyEditBatch::add_worker(ElementID id, TimeOffset processing_duration,
+                                   PackageQueueType queue_type) {
+    edits_.push_back({EditType::ADD_NODE, {NodeType::WORKER, id}, {},
+                      processing_duration, queue_type});
+}
+
+void TopologyEditBatch::remove_worker(ElementID id) {
+    edits_.push_back({EditType::REMOVE_NODE, {NodeType::WORKER, id}, {}, 0,
+                      PackageQueueType::FIFO});
+}
+
+void TopologyEditBatch::add_storehouse(ElementID id) {
+    edits_.push_back({EditType::ADD_NODE, {NodeType::STOREHOUSE, id}, {}, 0,
+                      PackageQueueType::FIFO});
+}
+
+void TopologyEditBatch::remove_storehouse(ElementID id) {
+    edits_.push_back({EditType::REMOVE_NODE, {NodeType::STOREHOUSE, id}, {}, 0,
+                      PackageQueueType::FIFO});
+}
+
+void TopologyEditBatch::add_link(NodeRef sender, NodeRef receiver) {
+    edits_.push_back(
+        {EditType::ADD_LINK, sender, receiver, 0, PackageQueueType::FIFO});
+}
+
+void TopologyEditBatch::remove_link(NodeRef sender, NodeRef receiver) {
+    edits_.push_back(
+        {EditType::REMOVE_LINK, sender, receiver, 0, PackageQueueType::FIFO});
+}
+
+// QUEUE
+
+namespace {
+bool exists_in_factory(const Factory &f, NodeRef node) {
+    switch (node.type) {
+    case NodeType::RAMP:
+        return f.find_ramp_by_id(node.id) != f.ramp_cend();
+    case NodeType::WORKER:
+        return f.find_worker_by_id(node.id) != f.worker_cend();
+    case NodeType::STOREHOUSE:
+        return f.find_storehouse_by_id(node.id) != f.storehouse_cend();
+    }
+    return false;
+}
+
+PackageSender *find_sender(Factory &f, NodeRef node) {
+    if (node.type == NodeType::RAMP) {
+        return &*f.find_ramp_by_id(node.id);
+    }
+    return &*f.find_worker_by_id(node.id);
+}
+
+IPackageReceiver *find_receiver(Factory &f, NodeRef node) {
+    if (node.type == NodeType::WORKER) {
+        return &*f.find_worker_by_id(node.id);
+    }
+    return &*f.find_storehouse_by_id(node.id);
+}
+} // namespace
+
+void TopologyEditQueue::submit(TopologyEditBatch batch) {
+    if (batch.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(staging_mutex_);
+    staged_.push_back(std::move(batch));
+}
+
+bool TopologyEditQueue::validate(const Factory &f,
+                                 const TopologyEditBatch &batch) const {
+    // Effects of earlier edits of the same batch
+    std::set<std::pair<NodeType, ElementID>> added, removed;
+    auto exists = [&](NodeRef node) {
+        auto key = std::make_pair(node.type, node.id);
+        if (added.count(key)) {
+            return true;
+        }
+        return !removed.count(key) && exists_in_factory(f, node);
+    };
+
+    for (const auto &edit : batch.edits_) {
+        auto key = std::make_pair(edit.node.type, edit.node.id);
+        switch (edit.type) {
+        case TopologyEditBatch::EditType::ADD_NODE:
+            if (exists(edit.node)) {
+                return false;
+            }
+            if (edit.node.type != NodeType::STOREHOUSE && edit.offset <= 0) {
+                return false;
+            }
+            added.insert(key);
+            removed.erase(key);
+            break;
+        case TopologyEditBatch::EditType::REMOVE_NODE:
+            if (!exists(edit.node)) {
+                return false;
+            }
+            removed.insert(key);
+            added.erase(key);
+            break;
+        case TopologyEditBatch::EditType::ADD_LINK:
+        case TopologyEditBatch::EditType::REMOVE_LINK:
+            if (edit.node.type == NodeType::STOREHOUSE ||
+                edit.target.type == NodeType::RAMP || !exists(edit.node) ||
+                !exists(edit.target)) {
+                return false;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+void TopologyEditQueue::apply(Factory &f, TopologyEditBatch &batch,
+                              Retired &retired) {
+    for (const auto &edit : batch.edits_) {
+        switch (edit.type) {
+        case TopologyEditBatch::EditType::ADD_NODE:
+            if (edit.node.type == NodeType::RAMP) {
+                f.add_ramp(Ramp(edit.node.id, edit.offset));
+            } else if (edit.node.type == NodeType::WORKER) {
+                f.add_worker(Worker(edit.node.id, edit.offset,
+                                    std::make_unique<PackageQueue>(
+                                        edit.queue_type,
+                                        f.get_memory_resource(
+                                            MemoryCategory::QUEUES))));
+            } else {
+                f.add_storehouse(Storehouse(
+                    edit.node.id,
+                    std::make_unique<PackageQueue>(
+                        PackageQueueType::FIFO,
+                        f.get_memory_resource(MemoryCategory::STOCKPILES))));
+            }
+            break;
+        case TopologyEditBatch::EditType::REMOVE_NODE:
+            // Node keeps its address in the retired list
+            if (edit.node.type == NodeType::RAMP) {
+                retired.ramps.splice(retired.ramps.end(),
+                                     f.extract_ramp(edit.node.id));
+            } else if (edit.node.type == NodeType::WORKER) {
+                retired.workers.splice(retired.workers.end(),
+                                       f.extract_worker(edit.node.id));
+            } else {
+                retired.storehouses.splice(retired.storehouses.end(),
+                                           f.extract_storehouse(edit.node.id));
+            }
+            break;
+        case TopologyEditBatch::EditType::ADD_LINK:
+            find_sender(f, edit.node)
+                ->get_receiver_preferences()
+                .add_receiver(find_receiver(f, edit.target));
+            break;
+        case TopologyEditBatch::EditType::REMOVE_LINK:
+            find_sender(f, edit.node)
+                ->get_receiver_preferences()
+                .remove_receiver(find_receiver(f, edit.target));
+            break;
+        }
+    }
+}
+
+std::size_t TopologyEditQueue::publish(Factory &f) {
+    std::vector<TopologyEditBatch> batches;
+    {
+        std::lock_guard<std::mutex> lock(staging_mutex_);
+        batches.swap(staged_); // planners are blocked only for the swap
+    }
+
+    std::size_t applied = 0;
+    if (!batches.empty()) {
+        std::unique_lock<std::shared_mutex> lock(structure_mutex_);
+        // Retired nodes stay in the Factory memory (same list allocator)
+        std::pmr::memory_resource *lists =
+            f.get_memory_resource(MemoryCategory::NODE_LISTS);
+        Retired retired{epoch_.load(), NodeCollection<Ramp>::container_t(lists),
+                        NodeCollection<Worker>::container_t(lists),
+                        NodeCollection<Storehouse>::container_t(lists)};
+        for (auto &batch : batches) {
+            if (!validate(f, batch)) {
+                ++rejected_;
+                continue;
+            }
+            apply(f, batch, retired);
+            ++applied;
+        }
+        if (!retired.ramps.empty() || !retired.workers.empty() ||
+            !retired.storehouses.empty()) {
+            retired_.push_back(std::move(retired));
+        }
+        if (applied > 0) {
+            ++epoch_;
+        }
+    }
+
+    reclaim();
+    return applied;
+}
+
+void TopologyEditQueue::reclaim() {
+    // Oldest epoch some reader may still be in
+    std::uint64_t oldest = epoch_.load();
+    for (const auto &slot : reader_epochs_) {
+        std::uint64_t e = slot.load();
+        if (e != 0 && e < oldest) {
+            oldest = e;
+        }
+    }
+    while (!retired_.empty() && retired_.front().epoch < oldest) {
+        retired_.pop_front();
+    }
+}
+
+std::size_t TopologyEditQueue::get_retired_nodes() const {
+    std::size_t count = 0;
+    for (const auto &retired : retired_) {
+        count += retired.ramps.size() + retired.workers.size() +
+                 retired.storehouses.size();
+    }
+    return count;
+}
+
+// READER GUARD
+
+TopologyEditQueue::ReaderGuard::ReaderGuard(TopologyEditQueue &queue)
+    : queue_(queue), slot_(MAX_READERS) {
+    std::uint64_t epoch = queue_.epoch_.load();
+    for (std::size_t i = 0; i < MAX_READERS && slot_ == MAX_READERS; ++i) {
+        std::uint64_t free_slot = 0;
+        if (queue_.reader_epochs_[i].compare_exchange_strong(free_slot,
+                                                             epoch)) {
+            slot_ = i;
+        }
+    }
+    if (slot_ == MAX_READERS) {
+        throw std::runtime_error("Too many topology readers.");
+    }
+    // Epoch may have moved before the slot was visible - announce the newest
+    while (epoch != queue_.epoch_.load()) {
+        epoch = queue_.epoch_.load();
+        queue_.reader_epochs_[slot_].store(epoch);
+    }
+}
+
+TopologyEditQueue::ReaderGuard::~ReaderGuard() {
+    queue_.reader_epochs_[slot_].store(0);
+}
+
+} // namespace NetSim
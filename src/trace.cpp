@@ -0,0 +1,226 @@
+#include "../include/trace.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <stdexcept>
+
+namespace NetSim {
+
+TraceSink *trace_sink = nullptr;
+
+namespace {
+// Trace processes (Chrome groups threads - here nodes - by process)
+constexpr int RAMP_PID = 1;
+constexpr int WORKER_PID = 2;
+constexpr int STOREHOUSE_PID = 3;
+
+std::atomic<std::uint64_t> next_instance{1};
+
+/**
+ * @brief Cache of the calling thread's ring for the last used sink
+ */
+struct ThreadRingCache {
+    std::uint64_t instance = 0;
+    void *ring = nullptr;
+};
+thread_local ThreadRingCache ring_cache;
+
+void append_int(std::string &s, long long value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    s.append(digits, result.ptr);
+}
+} // namespace
+
+TraceSink::TraceSink(const std::string &path, const TraceOptions &options)
+    : options_(options), instance_(next_instance++), out_(path) {
+    if (!out_) {
+        throw std::runtime_error("Cannot open trace file: " + path);
+    }
+    std::size_t capacity = options_.ring_capacity;
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        throw std::invalid_argument("Ring capacity must be a power of two.");
+    }
+    if (options_.sample_every <= 0) {
+        throw std::invalid_argument("Sampling period must be positive.");
+    }
+
+    buffer_.reserve(options_.write_buffer_size + 256);
+    buffer_ += "{\"traceEvents\":[\n"
+               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"args\":{\"name\":\"Ramps\"}},\n"
+               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,"
+               "\"args\":{\"name\":\"Workers\"}},\n"
+               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":3,"
+               "\"args\":{\"name\":\"Storehouses\"}}";
+
+    writer_ = std::thread(&TraceSink::writer_loop, this);
+}
+
+TraceSink::~TraceSink() { close(); }
+
+void TraceSink::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+
+    stop_ = true;
+    wake_.notify_one();
+    writer_.join();
+    drain(); // events pushed after the last writer pass
+
+    buffer_ += "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":";
+    append_int(buffer_, static_cast<long long>(get_dropped_events()));
+    buffer_ += "}}\n";
+    flush_buffer();
+    out_.close();
+
+    if (trace_sink == this) {
+        trace_sink = nullptr;
+    }
+}
+
+TraceSink::Ring &TraceSink::thread_ring() {
+    if (ring_cache.instance != instance_) {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        Ring *&ring = thread_rings_[std::this_thread::get_id()];
+        if (!ring) {
+            rings_.push_back(std::make_unique<Ring>(options_.ring_capacity));
+            ring = rings_.back().get();
+        }
+        ring_cache.instance = instance_;
+        ring_cache.ring = ring;
+    }
+    return *static_cast<Ring *>(ring_cache.ring);
+}
+
+void TraceSink::push(const TraceEvent &event) {
+    Ring &ring = thread_ring();
+    std::size_t head = ring.head.load(std::memory_order_relaxed);
+    std::size_t tail = ring.tail.load(std::memory_order_acquire);
+    if (head - tail == ring.events.size()) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return; // ring full - the writer is behind
+    }
+    ring.events[head & (ring.events.size() - 1)] = event;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void TraceSink::set_round(Time t) { thread_ring().round = t; }
+
+void TraceSink::record_delivery(ElementID ramp_id, ElementID package_id,
+                                Time t) {
+    if (!is_sampled(package_id)) {
+        return;
+    }
+    push(TraceEvent{TraceEventType::DELIVERY, 0, ramp_id, package_id, t, t});
+}
+
+void TraceSink::record_processing(ElementID worker_id, ElementID package_id,
+                                  Time start, Time end) {
+    if (!is_sampled(package_id)) {
+        return;
+    }
+    push(TraceEvent{TraceEventType::PROCESSING, 0, worker_id, package_id,
+                    start, end});
+}
+
+void TraceSink::record_receive(std::uint8_t receiver_kind,
+                               ElementID receiver_id, ElementID package_id) {
+    if (!is_sampled(package_id)) {
+        return;
+    }
+    Time t = thread_ring().round;
+    push(TraceEvent{TraceEventType::RECEIVE, receiver_kind, receiver_id,
+                    package_id, t, t});
+}
+
+std::size_t TraceSink::get_dropped_events() const {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    std::size_t dropped = 0;
+    for (const auto &ring : rings_) {
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+std::size_t TraceSink::get_ring_count() const {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    return rings_.size();
+}
+
+void TraceSink::writer_loop() {
+    while (!stop_) {
+        drain();
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_.wait_for(lock, std::chrono::milliseconds(1),
+                       [this] { return stop_.load(); });
+    }
+}
+
+void TraceSink::drain() {
+    std::vector<Ring *> rings;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const auto &ring : rings_) {
+            rings.push_back(ring.get());
+        }
+    }
+
+    for (Ring *ring : rings) {
+        std::size_t tail = ring->tail.load(std::memory_order_relaxed);
+        std::size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            format(ring->events[tail & (ring->events.size() - 1)]);
+            if (buffer_.size() >= options_.write_buffer_size) {
+                flush_buffer();
+            }
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+}
+
+void TraceSink::format(const TraceEvent &event) {
+    const long long us = options_.round_duration_us;
+    buffer_ += ",\n"; // metadata events always come first
+
+    switch (event.type) {
+    case TraceEventType::DELIVERY:
+        buffer_ += "{\"name\":\"delivery\",\"cat\":\"ramp\",\"ph\":\"i\","
+                   "\"s\":\"t\",\"pid\":";
+        append_int(buffer_, RAMP_PID);
+        break;
+    case TraceEventType::PROCESSING:
+        buffer_ += "{\"name\":\"package #";
+        append_int(buffer_, event.package_id);
+        buffer_ += "\",\"cat\":\"worker\",\"ph\":\"X\",\"dur\":";
+        // Processing takes rounds start..end inclusive
+        append_int(buffer_, (event.end - event.start + 1) * us);
+        buffer_ += ",\"pid\":";
+        append_int(buffer_, WORKER_PID);
+        break;
+    case TraceEventType::RECEIVE:
+        buffer_ += "{\"name\":\"receive\",\"cat\":\"";
+        buffer_ += event.node_kind == 0 ? "worker" : "storehouse";
+        buffer_ += "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":";
+        append_int(buffer_, event.node_kind == 0 ? WORKER_PID : STOREHOUSE_PID);
+        break;
+    }
+
+    buffer_ += ",\"tid\":";
+    append_int(buffer_, event.node_id);
+    buffer_ += ",\"ts\":";
+    append_int(buffer_, (event.start - 1) * us); // round 1 starts at 0
+    buffer_ += ",\"args\":{\"package\":";
+    append_int(buffer_, event.package_id);
+    buffer_ += "}}";
+    ++written_;
+}
+
+void TraceSink::flush_buffer() {
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+}
+
+} // namespace NetSim
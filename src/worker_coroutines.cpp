@@ -0,0 +1,170 @@
+#include "../include/worker_coroutines.hpp"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <stdexcept>
+#include <utility>
+
+namespace NetSim {
+
+// TASK
+
+WorkerTask::WorkerTask(WorkerTask &&other) noexcept
+    : handle_(std::exchange(other.handle_, nullptr)) {}
+
+WorkerTask &WorkerTask::operator=(WorkerTask &&other) noexcept {
+    if (this != &other) {
+        if (handle_) {
+            handle_.destroy();
+        }
+        handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+}
+
+WorkerTask::~WorkerTask() {
+    if (handle_) {
+        handle_.destroy();
+    }
+}
+
+// AWAITERS
+
+void WorkerContext::RoundsAwaiter::await_suspend(std::coroutine_handle<>) {
+    ctx.wait_ = Wait::ROUND;
+    ctx.wake_round_ = ctx.t_ + n;
+}
+
+bool WorkerContext::PackagesAwaiter::await_ready() const {
+    return ctx.worker_->get_queue()->size() >= n;
+}
+
+void WorkerContext::PackagesAwaiter::await_suspend(std::coroutine_handle<>) {
+    ctx.wait_ = Wait::PACKAGES;
+    ctx.packages_ = n;
+}
+
+void WorkerContext::PackagesAwaiter::await_resume() {
+    if (take && !ctx.worker_->start_processing(ctx.t_)) {
+        throw std::logic_error("Worker already holds a package.");
+    }
+}
+
+bool WorkerContext::ReleaseAwaiter::await_ready() {
+    if (!ctx.worker_->get_processing_buffer()) {
+        throw std::logic_error("Worker holds no package to release.");
+    }
+    return ctx.worker_->finish_processing(ctx.t_);
+}
+
+void WorkerContext::ReleaseAwaiter::await_suspend(std::coroutine_handle<>) {
+    ctx.wait_ = Wait::RELEASE; // released by do_work
+}
+
+// BEHAVIOUR
+
+CoroutineBehaviour::CoroutineBehaviour(WorkerBody body)
+    : body_(std::move(body)), task_(body_(ctx_)) {}
+
+void CoroutineBehaviour::do_work(Worker &worker, Time t) {
+    ctx_.worker_ = &worker;
+    ctx_.t_ = t;
+    switch (ctx_.wait_) {
+    case WorkerContext::Wait::START:
+        break;
+    case WorkerContext::Wait::ROUND:
+        if (t < ctx_.wake_round_) {
+            return;
+        }
+        break;
+    case WorkerContext::Wait::PACKAGES:
+        if (worker.get_queue()->size() < ctx_.packages_) {
+            return;
+        }
+        break;
+    case WorkerContext::Wait::RELEASE:
+        if (!worker.finish_processing(t)) {
+            return; // still blocked
+        }
+        break;
+    case WorkerContext::Wait::DONE:
+        return;
+    }
+    resume();
+}
+
+void CoroutineBehaviour::resume() {
+    auto handle = task_.handle_;
+    handle.resume(); // runs till the next wait sets ctx_.wait_
+    if (handle.done()) {
+        ctx_.wait_ = WorkerContext::Wait::DONE;
+        if (auto error = std::exchange(handle.promise().error, nullptr)) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+Time CoroutineBehaviour::get_wake_round() const {
+    switch (ctx_.wait_) {
+    case WorkerContext::Wait::START:
+        return ctx_.t_ + 1;
+    case WorkerContext::Wait::ROUND:
+        return ctx_.wake_round_;
+    case WorkerContext::Wait::RELEASE:
+        return ctx_.t_ + 1; // tries again every round
+    case WorkerContext::Wait::PACKAGES:
+    case WorkerContext::Wait::DONE:
+        break;
+    }
+    return 0;
+}
+
+void set_coroutine_behaviour(Worker &worker, WorkerBody body) {
+    worker.set_behaviour(std::make_unique<CoroutineBehaviour>(std::move(body)));
+}
+
+// STATIONS
+
+WorkerTask fixed_duration_station(WorkerContext &ctx, TimeOffset pd) {
+    while (true) {
+        co_await ctx.take_package();
+        co_await ctx.wait_rounds(pd - 1);
+        co_await ctx.release_package();
+        co_await ctx.wait_rounds(1); // the next package in the next round
+    }
+}
+
+WorkerTask maintenance_station(WorkerContext &ctx, TimeOffset pd,
+                               std::size_t packages_between,
+                               TimeOffset downtime) {
+    if (packages_between == 0) {
+        throw std::logic_error("Maintenance needs packages between stops.");
+    }
+    for (std::size_t done = 1;; ++done) {
+        co_await ctx.take_package();
+        co_await ctx.wait_rounds(pd - 1);
+        co_await ctx.release_package();
+        co_await ctx.wait_rounds(done % packages_between == 0 ? 1 + downtime
+                                                              : 1);
+    }
+}
+
+WorkerTask batch_station(WorkerContext &ctx, std::size_t batch_size,
+                         TimeOffset pd) {
+    if (batch_size == 0) {
+        throw std::logic_error("Batch size must be positive.");
+    }
+    while (true) {
+        co_await ctx.wait_packages(batch_size);
+        co_await ctx.wait_rounds(pd - 1);
+        for (std::size_t i = 0; i < batch_size; ++i) {
+            co_await ctx.take_package();
+            co_await ctx.release_package();
+            co_await ctx.wait_rounds(1);
+        }
+    }
+}
+
+} // namespace NetSim
+
+#endif // __cpp_impl_coroutine
@@ -3,6 +3,42 @@
 #include "storage_types.hpp"
 #include "nodes.hpp"
 #include "helpers.hpp"
+#include "factory.hpp"
+#include "simulation.hpp"
+#include "estimator.hpp"
+#include "bottleneck.hpp"
+#include "trace.hpp"
+#include "reports.hpp"
+#include "metrics.hpp"
+#include "replay.hpp"
+#include "live_stats.hpp"
+#include "partition.hpp"
+#include "topology_edits.hpp"
+#include "static_factory.hpp"
+#include "differential.hpp"
+#include "package_table.hpp"
+#include "sweep.hpp"
+#include "factory_image.hpp"
+#include "replications.hpp"
+#include "modules.hpp"
+#include "routing_policies.hpp"
+#include "locality.hpp"
+#include "node_counts.hpp"
+#include "routing_streams.hpp"
+#include "time_travel.hpp"
+#include "worker_coroutines.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
 
 using namespace NetSim;
 
@@ -45,12 +81,17 @@ class TestSender : public PackageSender {
 public:
     // Wrapper exposing the push_package method
     void push_package_public(Package&& p) {
-        push_package(std::move(p));
+        push_package(table_.create(std::move(p)));
+    }
+    IPackageReceiver *send_package() {
+        return PackageSender::send_package(table_);
     }
     // Check if buffer is empty
     bool is_buffer_empty() const {
-        return !buffer_.has_value();
+        return !buffer_;
     }
+private:
+    PackageTable table_;
 };
 
 TEST(PackageSenderTest, BufferClearedAfterSend) {
@@ -160,6 +201,1361 @@ TEST(StorehouseTest, ReceivingPackage) {
     EXPECT_EQ(it->get_id(), 99);
 }
 
+// --- FACTORY AND SIMULATION TESTS ---
+
+// Helper building a simple line: ramp -> worker -> storehouse
+static void build_line(Factory &factory, TimeOffset delivery_interval,
+                       TimeOffset processing_duration) {
+    factory.add_ramp(Ramp(1, delivery_interval));
+    factory.add_worker(Worker(1, processing_duration,
+                              std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.add_storehouse(Storehouse(1));
+
+    factory.find_ramp_by_id(1)->get_receiver_preferences().add_receiver(
+        &*factory.find_worker_by_id(1));
+    factory.find_worker_by_id(1)->get_receiver_preferences().add_receiver(
+        &*factory.find_storehouse_by_id(1));
+}
+
+TEST(FactoryTest, ConsistencyRequiresStorehouse) {
+    Factory factory;
+    build_line(factory, 1, 1);
+    EXPECT_TRUE(factory.is_consistent());
+
+    // Without the storehouse the worker has nowhere to send
+    factory.remove_storehouse(1);
+    EXPECT_TRUE(factory.find_worker_by_id(1)->get_receiver_preferences()
+                    .get_preferences().empty());
+    EXPECT_FALSE(factory.is_consistent());
+}
+
+TEST(SimulationTest, PackagesReachStorehouse) {
+    Factory factory;
+    build_line(factory, 1, 1);
+
+    simulate(factory, 10, [](Factory &, Time) {});
+
+    // Delivered in rounds 1..10, stored in rounds 2..10
+    EXPECT_EQ(factory.find_storehouse_by_id(1)->get_stockpile()->size(), 9u);
+}
+
+TEST(SimulationTest, SteadyStateStopsEarly) {
+    Factory factory;
+    build_line(factory, 2, 1);
+
+    SteadyStateOptions options;
+    options.enabled = true;
+    options.batch_length = 10;
+    options.min_batches = 5;
+
+    SimulationSummary summary =
+        simulate(factory, 100000, [](Factory &, Time) {}, options);
+
+    EXPECT_TRUE(summary.steady_state_reached);
+    EXPECT_LT(summary.rounds_run, 1000);
+    EXPECT_EQ(summary.rounds_saved, summary.horizon - summary.rounds_run);
+    EXPECT_LT(summary.warmup_length, summary.rounds_run);
+}
+
+TEST(SimulationTest, SteadyStateHistoryIsBounded) {
+    // Queue grows by one package every two rounds, so the run never settles
+    Factory factory;
+    build_line(factory, 1, 2);
+
+    SteadyStateOptions options;
+    options.batch_length = 1;
+    options.min_batches = 2;
+    options.max_batches = 4;
+    SteadyStateDetector detector(options);
+
+    for (Time t = 1; t <= 64; ++t) {
+        factory.do_deliveries(t);
+        factory.do_package_passing();
+        factory.do_work(t);
+        detector.observe(factory, t);
+    }
+    // Merged at 4, 8, 16, 32 and 64 rounds: 2 batches of 32 rounds stored
+    EXPECT_FALSE(detector.is_steady());
+    EXPECT_EQ(detector.get_batch_length(), 32);
+    EXPECT_LE(detector.get_warmup_length(), 64);
+
+    options.max_batches = 3;
+    EXPECT_THROW(SteadyStateDetector{options}, std::invalid_argument);
+}
+
+TEST(EstimatorTest, UtilizationOfLine) {
+    Factory factory;
+    build_line(factory, 2, 1);
+
+    NetworkEstimate estimate = estimate_network(factory);
+    ASSERT_TRUE(estimate.converged);
+    ASSERT_EQ(estimate.workers.size(), 1u);
+    EXPECT_DOUBLE_EQ(estimate.workers[0].arrival_rate, 0.5);
+    EXPECT_DOUBLE_EQ(estimate.workers[0].utilization, 0.5);
+    EXPECT_FALSE(estimate.workers[0].saturated);
+    EXPECT_DOUBLE_EQ(estimate.storehouses[0].arrival_rate, 0.5);
+}
+
+TEST(EstimatorTest, FlagsSaturatedWorker) {
+    Factory factory;
+    build_line(factory, 1, 2);
+
+    NetworkEstimate estimate = estimate_network(factory);
+    EXPECT_TRUE(estimate.has_saturated_worker());
+    EXPECT_DOUBLE_EQ(estimate.workers[0].utilization, 2.0);
+    // Saturated worker passes on only what it manages to process
+    EXPECT_DOUBLE_EQ(estimate.storehouses[0].arrival_rate, 0.5);
+}
+
+TEST(BottleneckTest, FindsSlowWorkerAndItsRamp) {
+    // ramp -> fast worker 1 -> slow worker 2 -> storehouse
+    Factory factory;
+    build_line(factory, 1, 1);
+    factory.add_worker(Worker(2, 3, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    auto &prefs = factory.find_worker_by_id(1)->get_receiver_preferences();
+    prefs.remove_receiver(&*factory.find_storehouse_by_id(1));
+    prefs.add_receiver(&*factory.find_worker_by_id(2));
+    factory.find_worker_by_id(2)->get_receiver_preferences().add_receiver(
+        &*factory.find_storehouse_by_id(1));
+
+    BottleneckAnalyzer analyzer;
+    simulate(factory, 300,
+             [&analyzer](Factory &f, Time t) { analyzer.observe(f, t); });
+
+    BottleneckReport report = analyzer.make_report(factory);
+    ASSERT_EQ(report.ranking.size(), 2u);
+    EXPECT_EQ(report.ranking[0].id, 2);
+    EXPECT_GT(report.ranking[0].queue_growth, 0.5);
+    EXPECT_GT(report.ranking[0].utilization, 0.95);
+    EXPECT_EQ(report.feeding_ramps, std::vector<ElementID>{1});
+    EXPECT_EQ(report.feeding_workers, std::vector<ElementID>{1});
+}
+
+TEST(TraceTest, WritesChromeTraceEvents) {
+    Factory factory;
+    build_line(factory, 1, 2);
+    std::string path = ::testing::TempDir() + "netsim_trace.json";
+
+    TraceSink sink(path);
+    trace_sink = &sink;
+    simulate(factory, 10, [](Factory &, Time) {});
+    sink.close(); // also detaches the global sink
+
+    EXPECT_EQ(trace_sink, nullptr);
+    EXPECT_EQ(sink.get_dropped_events(), 0u);
+    // 10 deliveries, 10 receives by the worker, 5 processed, 4 stored
+    EXPECT_EQ(sink.get_written_events(), 29u);
+
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    std::string json = content.str();
+    EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0u);
+    EXPECT_NE(json.find("\"ph\":\"X\",\"dur\":2000"), std::string::npos);
+    EXPECT_NE(json.find("\"dropped_events\":0}}"), std::string::npos);
+}
+
+TEST(TraceTest, SamplingSkipsPackages) {
+    std::string path = ::testing::TempDir() + "netsim_trace_sampled.json";
+    TraceOptions options;
+    options.sample_every = 2;
+
+    TraceSink sink(path, options);
+    sink.record_delivery(1, 1, 1);
+    sink.record_delivery(1, 2, 1);
+    sink.record_delivery(1, 3, 1);
+    sink.close();
+
+    EXPECT_EQ(sink.get_written_events(), 1u);
+}
+
+TEST(TraceTest, ThreadKeepsItsRingAcrossSinks) {
+    TraceSink a(::testing::TempDir() + "netsim_trace_a.json");
+    TraceSink b(::testing::TempDir() + "netsim_trace_b.json");
+    for (ElementID id = 1; id <= 100; ++id) {
+        a.record_delivery(1, id, 1);
+        b.record_delivery(1, id, 1);
+    }
+    std::thread([&] { a.record_delivery(1, 1, 1); }).join();
+    EXPECT_EQ(a.get_ring_count(), 2u);
+    EXPECT_EQ(b.get_ring_count(), 1u);
+    a.close();
+    b.close();
+    EXPECT_EQ(a.get_written_events(), 101u);
+    EXPECT_EQ(b.get_written_events(), 100u);
+}
+
+TEST(ReportsTest, TurnReportContent) {
+    Factory factory;
+    build_line(factory, 1, 2);
+    simulate(factory, 1, [](Factory &, Time) {});
+
+    std::ostringstream os;
+    generate_simulation_turn_report(factory, os, 1);
+    std::string report = os.str();
+    EXPECT_NE(report.find("=== [ Turn: 1 ] ==="), std::string::npos);
+    EXPECT_NE(report.find("(pt = 1)"), std::string::npos);
+    EXPECT_NE(report.find("Stock: (empty)"), std::string::npos);
+}
+
+TEST(ReportsTest, AsyncWriterMatchesSynchronousReports) {
+    Factory factory;
+    build_line(factory, 1, 2);
+
+    std::ostringstream expected;
+    std::ostringstream actual;
+    {
+        AsyncReportWriter writer(actual, 2, 64); // tiny queue and buffer
+        simulate(factory, 20, [&](Factory &f, Time t) {
+            generate_simulation_turn_report(f, expected, t);
+            writer.publish(f, t);
+        });
+    }
+
+    EXPECT_EQ(actual.str(), expected.str());
+}
+
+TEST(MetricsTest, RoundTripWithDownsampling) {
+    Factory factory;
+    build_line(factory, 1, 2); // queue grows by one every second round
+    std::string path = ::testing::TempDir() + "netsim_metrics.bin";
+
+    MetricsOptions options;
+    options.sample_every = 2;
+    options.block_rows = 3; // several blocks and a partial one
+    {
+        MetricsRecorder recorder(path, options);
+        simulate(factory, 20, [&recorder](Factory &f, Time t) {
+            recorder.record(f, t);
+        });
+    }
+
+    MetricsReader reader(path);
+    EXPECT_EQ(reader.get_sample_every(), 2);
+    EXPECT_EQ(reader.get_columns().size(), 5u);
+
+    std::vector<std::int64_t> rounds =
+        reader.read_column(reader.find_column(MetricType::ROUND, 0));
+    ASSERT_EQ(rounds.size(), 10u);
+    EXPECT_EQ(rounds.front(), 2);
+    EXPECT_EQ(rounds.back(), 20);
+
+    std::vector<std::int64_t> queue =
+        reader.read_column(reader.find_column(MetricType::QUEUE_SIZE, 1));
+    std::vector<std::int64_t> stock =
+        reader.read_column(reader.find_column(MetricType::STOCK_SIZE, 1));
+    ASSERT_EQ(queue.size(), 10u);
+    EXPECT_EQ(queue.back(), 10); // 20 received, 10 taken (rounds 1, 3, ...)
+    EXPECT_EQ(stock.back(), 9);  // finished in rounds 2, 4, ..., 18
+    // Sampled rounds are the finishing ones, busy all the same
+    std::vector<std::int64_t> busy =
+        reader.read_column(reader.find_column(MetricType::BUSY, 1));
+    EXPECT_EQ(busy, std::vector<std::int64_t>(10, 1));
+
+    // pd = 1 takes and finishes a package within one do_work
+    Factory fast;
+    build_line(fast, 2, 1);
+    {
+        MetricsRecorder recorder(path);
+        simulate(fast, 6, [&recorder](Factory &f, Time t) {
+            recorder.record(f, t);
+        });
+    }
+    MetricsReader fast_reader(path);
+    EXPECT_EQ(fast_reader.read_column(fast_reader.find_column(MetricType::BUSY, 1)),
+              (std::vector<std::int64_t>{1, 0, 1, 0, 1, 0}));
+}
+
+// Helper: the line with a second storehouse after the worker (random split)
+static void build_split(Factory &factory) {
+    build_line(factory, 1, 1);
+    factory.add_storehouse(Storehouse(2));
+    factory.find_worker_by_id(1)->get_receiver_preferences().add_receiver(
+        &*factory.find_storehouse_by_id(2));
+}
+
+TEST(MetricsTest, BlockEndsAtByteBudget) {
+    Factory factory;
+    build_line(factory, 1, 2);
+    std::string path = ::testing::TempDir() + "netsim_metrics_bytes.bin";
+
+    MetricsOptions options;
+    options.block_bytes = 10; // 5 columns, at least 5 bytes per row
+    {
+        MetricsRecorder recorder(path, options);
+        simulate(factory, 20, [&recorder](Factory &f, Time t) {
+            recorder.record(f, t);
+        });
+    }
+
+    // Every block ends after its second row
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+    std::size_t blocks = 0;
+    for (std::size_t pos = bytes.find("NSMB"); pos != std::string::npos;
+         pos = bytes.find("NSMB", pos + 4)) {
+        ++blocks;
+    }
+    EXPECT_EQ(blocks, 10u);
+
+    MetricsReader reader(path);
+    std::vector<std::int64_t> queue =
+        reader.read_column(reader.find_column(MetricType::QUEUE_SIZE, 1));
+    ASSERT_EQ(queue.size(), 20u);
+    EXPECT_EQ(queue.back(), 10);
+}
+
+TEST(ReplayTest, ReplayReproducesRunWithoutGenerator) {
+    std::string path = ::testing::TempDir() + "netsim_routing.log";
+    std::size_t recorded_sizes[2];
+    {
+        Factory factory;
+        build_split(factory);
+        RoutingRecorder recorder(path);
+        routing_hook = &recorder;
+        simulate(factory, 50, [](Factory &, Time) {});
+        recorder.close();
+        EXPECT_EQ(routing_hook, nullptr);
+        recorded_sizes[0] = factory.find_storehouse_by_id(1)->get_stockpile()->size();
+        recorded_sizes[1] = factory.find_storehouse_by_id(2)->get_stockpile()->size();
+    }
+
+    // Senders built now copy a generator that must never be called
+    ProbabilityGenerator saved = probability_generator;
+    int generator_calls = 0;
+    probability_generator = [&generator_calls]() {
+        ++generator_calls;
+        return 0.0;
+    };
+    Factory factory;
+    build_split(factory);
+    probability_generator = saved;
+
+    RoutingReplayer replayer(path);
+    routing_hook = &replayer;
+    simulate(factory, 50, [](Factory &, Time) {});
+    routing_hook = nullptr;
+
+    EXPECT_TRUE(replayer.finished());
+    EXPECT_EQ(generator_calls, 0);
+    EXPECT_EQ(factory.find_storehouse_by_id(1)->get_stockpile()->size(), recorded_sizes[0]);
+    EXPECT_EQ(factory.find_storehouse_by_id(2)->get_stockpile()->size(), recorded_sizes[1]);
+
+    // Receivers changed half-way: the next decision for storehouse 2 fails
+    Factory changed;
+    build_split(changed);
+    RoutingReplayer partial(path);
+    routing_hook = &partial;
+    simulate(changed, 25, [](Factory &, Time) {});
+    changed.find_worker_by_id(1)->get_receiver_preferences().remove_receiver(
+        &*changed.find_storehouse_by_id(2));
+    EXPECT_THROW(simulate(changed, 25, [](Factory &, Time) {}), std::runtime_error);
+    routing_hook = nullptr;
+}
+
+// Helper: workers 1 and 2 to storehouse 1, after round 10 worker 2 is
+// replaced by worker 3 sending to storehouse 2
+static void run_with_replaced_worker(Factory &factory) {
+    factory.add_ramp(Ramp(1, 1));
+    factory.add_storehouse(Storehouse(1));
+    factory.add_storehouse(Storehouse(2));
+    for (ElementID id = 1; id <= 2; ++id) {
+        factory.add_worker(Worker(id, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+        factory.find_worker_by_id(id)->get_receiver_preferences().add_receiver(
+            &*factory.find_storehouse_by_id(1));
+        factory.find_ramp_by_id(1)->get_receiver_preferences().add_receiver(
+            &*factory.find_worker_by_id(id));
+    }
+    simulate(factory, 30, [](Factory &f, Time t) {
+        if (t != 10) {
+            return;
+        }
+        f.remove_worker(2);
+        f.add_worker(Worker(3, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+        f.find_worker_by_id(3)->get_receiver_preferences().add_receiver(
+            &*f.find_storehouse_by_id(2));
+        f.find_ramp_by_id(1)->get_receiver_preferences().add_receiver(
+            &*f.find_worker_by_id(3));
+    });
+}
+
+TEST(ReplayTest, ReplayFollowsReplacedNodes) {
+    std::string path = ::testing::TempDir() + "netsim_routing_replaced.log";
+    std::size_t recorded_stock;
+    {
+        Factory factory;
+        RoutingRecorder recorder(path);
+        routing_hook = &recorder;
+        run_with_replaced_worker(factory);
+        recorder.close();
+        recorded_stock = factory.find_storehouse_by_id(2)->get_stockpile()->size();
+    }
+    EXPECT_GT(recorded_stock, 0u);
+
+    // The new worker's preferences may reuse the memory of the removed ones
+    Factory factory;
+    RoutingReplayer replayer(path);
+    routing_hook = &replayer;
+    EXPECT_NO_THROW(run_with_replaced_worker(factory));
+    routing_hook = nullptr;
+    EXPECT_TRUE(replayer.finished());
+    EXPECT_EQ(factory.find_storehouse_by_id(2)->get_stockpile()->size(), recorded_stock);
+}
+
+TEST(LiveStatsTest, ReaderSeesPublishedCounters) {
+    Factory factory;
+    build_line(factory, 1, 2);
+    std::string name = "/netsim_test_" + std::to_string(::getpid());
+
+    LiveStatsPublisher publisher(name, 4);
+    LiveStatsReader reader(name);
+    simulate(factory, 20, [&publisher](Factory &f, Time t) {
+        publisher.publish(f, t);
+    });
+
+    LiveStatsSnapshot snapshot;
+    ASSERT_TRUE(reader.read(snapshot));
+    EXPECT_EQ(snapshot.round, 20);
+    EXPECT_FALSE(snapshot.truncated);
+    ASSERT_EQ(snapshot.worker_queues.size(), 1u);
+    EXPECT_EQ(snapshot.worker_queues[0], std::make_pair(1, std::int64_t{10}));
+    ASSERT_EQ(snapshot.storehouse_totals.size(), 1u);
+    EXPECT_EQ(snapshot.storehouse_totals[0].second, 9);
+}
+
+// Helper: layered Net with random links (ramps -> workers -> storehouses)
+static void build_layered(Factory &factory, int n_workers, unsigned seed) {
+    std::mt19937 gen(seed);
+    auto pick = [&gen](int n) { return std::uniform_int_distribution<int>(1, n)(gen); };
+    int n_ramps = 3, n_storehouses = 3;
+
+    for (int id = 1; id <= n_ramps; ++id) {
+        factory.add_ramp(Ramp(id, pick(3)));
+    }
+    for (int id = 1; id <= n_workers; ++id) {
+        factory.add_worker(Worker(id, pick(3), std::make_unique<PackageQueue>(
+                                                   id % 2 ? PackageQueueType::FIFO
+                                                          : PackageQueueType::LIFO)));
+    }
+    for (int id = 1; id <= n_storehouses; ++id) {
+        factory.add_storehouse(Storehouse(id));
+    }
+
+    for (int id = 1; id <= n_ramps; ++id) {
+        auto &prefs = factory.find_ramp_by_id(id)->get_receiver_preferences();
+        prefs.add_receiver(&*factory.find_worker_by_id(pick(n_workers)));
+        prefs.add_receiver(&*factory.find_worker_by_id(pick(n_workers)));
+    }
+    for (int id = 1; id <= n_workers; ++id) {
+        auto &prefs = factory.find_worker_by_id(id)->get_receiver_preferences();
+        if (id < n_workers) { // forward links only - no cycles
+            prefs.add_receiver(&*factory.find_worker_by_id(
+                std::uniform_int_distribution<int>(id + 1, n_workers)(gen)));
+        }
+        prefs.add_receiver(&*factory.find_storehouse_by_id(pick(n_storehouses)));
+    }
+}
+
+TEST(PartitionTest, PartitionedRunMatchesSingleProcess) {
+    Factory reference, partitioned;
+    build_layered(reference, 12, 7);
+    build_layered(partitioned, 12, 7);
+
+    seed_routing_streams(reference, 42);
+    simulate(reference, 200, [](Factory &, Time) {});
+
+    PartitionPlan plan = make_partition_plan(partitioned, 3);
+    EXPECT_EQ(plan.workers.size(), 12u);
+    int caller_draws = 0;
+    Ramp &ramp = *partitioned.ramp_begin();
+    ramp.get_receiver_preferences().set_probability_generator([&caller_draws]() {
+        ++caller_draws;
+        return 0.5;
+    });
+    NodeCounts counts = simulate_partitioned(partitioned, 200, plan, 42);
+
+    EXPECT_TRUE(counts == collect_node_counts(reference));
+    ramp.get_receiver_preferences().choose_receiver(); // the caller's again
+    EXPECT_EQ(caller_draws, 1);
+}
+
+TEST(TopologyEditsTest, BatchesAppliedBetweenRounds) {
+    Factory factory;
+    build_line(factory, 1, 1);
+    TopologyEditQueue edits;
+
+    // Planner thread: second worker in front of the storehouse
+    std::thread planner([&edits]() {
+        TopologyEditBatch batch;
+        batch.add_worker(2, 1, PackageQueueType::FIFO);
+        batch.add_link({NodeType::RAMP, 1}, {NodeType::WORKER, 2});
+        batch.add_link({NodeType::WORKER, 2}, {NodeType::STOREHOUSE, 1});
+        edits.submit(std::move(batch));
+
+        TopologyEditBatch invalid; // storehouse can't send
+        invalid.add_link({NodeType::STOREHOUSE, 1}, {NodeType::WORKER, 1});
+        edits.submit(std::move(invalid));
+    });
+    planner.join();
+
+    std::size_t applied = 0;
+    simulate(factory, 5, [&](Factory &f, Time) { applied += edits.publish(f); });
+
+    EXPECT_EQ(applied, 1u);
+    EXPECT_EQ(edits.get_rejected_batches(), 1u);
+    EXPECT_EQ(edits.get_epoch(), 2u);
+    ASSERT_NE(factory.find_worker_by_id(2), factory.worker_end());
+    EXPECT_EQ(factory.find_ramp_by_id(1)->get_receiver_preferences().get_preferences().size(),
+              2u);
+    EXPECT_TRUE(factory.is_consistent());
+}
+
+TEST(TopologyEditsTest, RemovedNodeRetiredWhileReaderActive) {
+    Factory factory;
+    build_line(factory, 1, 1);
+    factory.add_worker(Worker(2, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.find_ramp_by_id(1)->get_receiver_preferences().add_receiver(
+        &*factory.find_worker_by_id(2));
+    factory.find_worker_by_id(2)->get_receiver_preferences().add_receiver(
+        &*factory.find_storehouse_by_id(1));
+    TopologyEditQueue edits;
+
+    {
+        TopologyEditQueue::ReaderGuard reader(edits);
+        Worker *removed = &*factory.find_worker_by_id(2);
+
+        TopologyEditBatch batch;
+        batch.remove_worker(2);
+        edits.submit(std::move(batch));
+        EXPECT_EQ(edits.publish(factory), 1u);
+
+        EXPECT_EQ(factory.find_worker_by_id(2), factory.worker_end());
+        EXPECT_EQ(factory.find_ramp_by_id(1)->get_receiver_preferences().get_preferences().size(),
+                  1u);
+        EXPECT_EQ(edits.get_retired_nodes(), 1u);
+        EXPECT_EQ(removed->get_id(), 2); // still alive
+    }
+
+    edits.publish(factory);
+    EXPECT_EQ(edits.get_retired_nodes(), 0u);
+}
+
+TEST(TopologyEditsTest, ReaderTraversesWhilePublishing) {
+    Factory factory;
+    build_line(factory, 1, 1);
+    const Factory &view = factory;
+    TopologyEditQueue edits;
+
+    // Every receiver of the ramp is a listed worker, whenever looked at
+    std::atomic<bool> done{false};
+    std::atomic<int> broken{0}, traversals{0};
+    std::thread reader([&]() {
+        TopologyEditQueue::ReaderGuard guard(edits);
+        while (!done.load()) {
+            TopologyEditQueue::ReadLock lock(edits);
+            for (const auto &pair : view.find_ramp_by_id(1)->get_receiver_preferences()) {
+                auto it = view.find_worker_by_id(pair.first->get_id());
+                if (it == view.worker_cend() || &*it != pair.first) {
+                    ++broken;
+                }
+            }
+            ++traversals;
+        }
+    });
+    for (ElementID id = 2; id < 400; ++id) {
+        TopologyEditBatch add;
+        add.add_worker(id, 1, PackageQueueType::FIFO);
+        add.add_link({NodeType::RAMP, 1}, {NodeType::WORKER, id});
+        add.add_link({NodeType::WORKER, id}, {NodeType::STOREHOUSE, 1});
+        edits.submit(std::move(add));
+        edits.publish(factory);
+        TopologyEditBatch remove;
+        remove.remove_worker(id);
+        edits.submit(std::move(remove));
+        edits.publish(factory);
+    }
+    while (traversals.load() == 0) {
+        std::this_thread::yield();
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(broken.load(), 0);
+    EXPECT_EQ(edits.get_epoch(), 1u + 2 * 398);
+    edits.publish(factory);
+    EXPECT_EQ(edits.get_retired_nodes(), 0u); // reader left
+}
+
+// Line with a split: ramp 1 -> worker 1 -> storehouse 1 / worker 2 -> storehouse 2
+static constexpr TopologySpec<2, 2, 2, 6> split_spec{
+    {RampSpec{1, 1}, RampSpec{2, 3}},
+    {WorkerSpec{1, 2, PackageQueueType::FIFO}, WorkerSpec{2, 3, PackageQueueType::LIFO}},
+    {StorehouseSpec{1}, StorehouseSpec{2}},
+    {LinkSpec{{NodeType::RAMP, 1}, {NodeType::WORKER, 1}},
+     LinkSpec{{NodeType::RAMP, 2}, {NodeType::WORKER, 2}},
+     LinkSpec{{NodeType::RAMP, 2}, {NodeType::WORKER, 1}},
+     LinkSpec{{NodeType::WORKER, 1}, {NodeType::STOREHOUSE, 2}},
+     LinkSpec{{NodeType::WORKER, 1}, {NodeType::WORKER, 2}},
+     LinkSpec{{NodeType::WORKER, 2}, {NodeType::STOREHOUSE, 1}}}};
+
+TEST(StaticFactoryTest, MatchesDynamicFactory) {
+    std::mt19937 dynamic_gen(11), static_gen(11);
+    ProbabilityGenerator saved = probability_generator;
+    probability_generator = [&dynamic_gen]() {
+        return std::generate_canonical<double, 10>(dynamic_gen);
+    };
+    Factory factory; // senders copy the generator when created
+    StaticFactory<split_spec>::populate_factory(factory);
+    ASSERT_TRUE(factory.is_consistent());
+    simulate(factory, 100, [](Factory &, Time) {});
+    probability_generator = saved;
+
+    StaticFactory<split_spec> static_factory;
+    auto pg = [&static_gen]() { return std::generate_canonical<double, 10>(static_gen); };
+    static_factory.simulate(100, pg);
+
+    EXPECT_TRUE(static_factory.collect_node_counts() == collect_node_counts(factory));
+}
+
+TEST(DifferentialTest, IdenticalRandomFactoriesMatch) {
+    RandomFactoryOptions options;
+    options.n_workers = 200;
+    options.seed = 3;
+    Factory reference, candidate;
+    build_random_factory(reference, options);
+    build_random_factory(candidate, options);
+    ASSERT_TRUE(reference.is_consistent());
+    seed_routing_streams(reference, 8);
+    seed_routing_streams(candidate, 8);
+
+    FactoryEngine reference_engine(reference), candidate_engine(candidate);
+    DifferentialReport report = run_differential(reference_engine, candidate_engine, 300);
+
+    EXPECT_FALSE(report.diverged);
+    EXPECT_EQ(report.rounds_compared, 300);
+}
+
+TEST(DifferentialTest, PackagesComparedInOrder) {
+    Factory fifo, lifo;
+    build_line(fifo, 1, 2);
+    lifo.add_ramp(Ramp(1, 1));
+    lifo.add_worker(Worker(1, 2, std::make_unique<PackageQueue>(PackageQueueType::LIFO)));
+    lifo.add_storehouse(Storehouse(1));
+    lifo.find_ramp_by_id(1)->get_receiver_preferences().add_receiver(
+        &*lifo.find_worker_by_id(1));
+    lifo.find_worker_by_id(1)->get_receiver_preferences().add_receiver(
+        &*lifo.find_storehouse_by_id(1));
+
+    // Same counts in every round, in round 3 the worker takes another one
+    FactoryEngine fifo_engine(fifo), lifo_engine(lifo);
+    DifferentialReport report = run_differential(fifo_engine, lifo_engine, 20);
+    ASSERT_TRUE(report.diverged);
+    EXPECT_EQ(report.round, 3);
+    EXPECT_EQ(report.node_type, NodeType::WORKER);
+    EXPECT_EQ(report.field, "packages");
+}
+
+// Same as split_spec, but worker 2 is slower
+static constexpr TopologySpec<2, 2, 2, 6> split_spec_slow{
+    split_spec.ramps,
+    {WorkerSpec{1, 2, PackageQueueType::FIFO}, WorkerSpec{2, 4, PackageQueueType::LIFO}},
+    split_spec.storehouses,
+    split_spec.links};
+
+TEST(DifferentialTest, StaticFactoryCheckedAgainstReference) {
+    Factory factory;
+    StaticFactory<split_spec>::populate_factory(factory);
+    set_routing_generator(factory, make_stream_generator(5, 0));
+    FactoryEngine reference(factory);
+    StaticFactoryEngine<split_spec, ProbabilityGenerator> matching(make_stream_generator(5, 0));
+    EXPECT_FALSE(run_differential(reference, matching, 200).diverged);
+
+    Factory factory_again;
+    StaticFactory<split_spec>::populate_factory(factory_again);
+    set_routing_generator(factory_again, make_stream_generator(5, 0));
+    FactoryEngine reference_again(factory_again);
+    StaticFactoryEngine<split_spec_slow, ProbabilityGenerator> slow(make_stream_generator(5, 0));
+    DifferentialReport report = run_differential(reference_again, slow, 200);
+
+    ASSERT_TRUE(report.diverged);
+    EXPECT_EQ(report.node_type, NodeType::WORKER);
+    EXPECT_EQ(report.node_id, 2);
+    std::ostringstream os;
+    print_differential_report(os, report);
+    EXPECT_NE(os.str().find("worker #2"), std::string::npos);
+}
+
+// Memory resource counting live allocations
+class CountingResource : public std::pmr::memory_resource {
+  public:
+    std::size_t allocations = 0;
+    std::size_t live = 0;
+
+  private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        ++allocations;
+        ++live;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+        --live;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+TEST(FactoryMemoryTest, NodesAndLinksUseFactoryMemory) {
+    CountingResource resource;
+    {
+        Factory factory(&resource);
+        factory.add_ramp(Ramp(1, 1));
+        factory.add_worker(Worker(1, 1, std::make_unique<PackageQueue>(
+                                            PackageQueueType::FIFO, factory.get_memory_resource())));
+        factory.add_storehouse(Storehouse(1));
+        std::size_t nodes_only = resource.allocations;
+        EXPECT_GE(nodes_only, 3u); // list nodes (+ queue chunks)
+
+        factory.find_ramp_by_id(1)->get_receiver_preferences().add_receiver(
+            &*factory.find_worker_by_id(1));
+        factory.find_worker_by_id(1)->get_receiver_preferences().add_receiver(
+            &*factory.find_storehouse_by_id(1));
+        EXPECT_EQ(resource.allocations, nodes_only + 2); // map nodes
+
+        simulate(factory, 10, [](Factory &, Time) {});
+        EXPECT_EQ(factory.find_storehouse_by_id(1)->get_stockpile()->size(), 9u);
+    }
+    EXPECT_EQ(resource.live, 0u);
+}
+
+TEST(FactoryMemoryTest, CountsMemoryPerCategory) {
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    for (ElementID id = 1; id <= 2; ++id) {
+        factory.add_worker(Worker(id, 2, std::make_unique<PackageQueue>(
+            PackageQueueType::FIFO,
+            factory.get_memory_resource(MemoryCategory::QUEUES))));
+    }
+    factory.add_storehouse(Storehouse(1, std::make_unique<PackageQueue>(
+        PackageQueueType::FIFO,
+        factory.get_memory_resource(MemoryCategory::STOCKPILES))));
+    Worker *w1 = &*factory.find_worker_by_id(1);
+    Worker *w2 = &*factory.find_worker_by_id(2);
+    factory.find_ramp_by_id(1)->get_receiver_preferences().add_receiver(w1);
+    factory.find_ramp_by_id(1)->get_receiver_preferences().add_receiver(w2);
+    w1->get_receiver_preferences().add_receiver(&*factory.find_storehouse_by_id(1));
+    w2->get_receiver_preferences().add_receiver(&*factory.find_storehouse_by_id(1));
+
+    MemoryReport built = factory.get_memory_report();
+    EXPECT_EQ(built[MemoryCategory::NODE_LISTS].blocks, 4u); // list nodes
+    EXPECT_EQ(built[MemoryCategory::PREFERENCES].blocks, 4u); // links
+    EXPECT_THROW(factory.get_memory_resource(MemoryCategory::PACKAGE_IDS),
+                 std::logic_error);
+
+    // Blocks may stay the same (freed IDs are reused), allocations grow
+    std::size_t ids = Package::get_id_memory_usage().allocations;
+    SimulationSummary summary = simulate(factory, 20, {}, SteadyStateOptions{});
+    EXPECT_GT(summary.memory[MemoryCategory::QUEUES].bytes, 0u);
+    EXPECT_GT(summary.memory[MemoryCategory::STOCKPILES].bytes, 0u);
+    EXPECT_GT(summary.memory[MemoryCategory::PACKAGE_IDS].allocations, ids);
+    EXPECT_EQ(summary.memory[MemoryCategory::NODE_LISTS].bytes,
+              built[MemoryCategory::NODE_LISTS].bytes);
+
+    factory.remove_worker(2);
+    MemoryReport removed = factory.get_memory_report();
+    EXPECT_EQ(removed[MemoryCategory::NODE_LISTS].blocks, 3u);
+    EXPECT_EQ(removed[MemoryCategory::PREFERENCES].blocks, 2u);
+    EXPECT_EQ(removed[MemoryCategory::PREFERENCES].peak_bytes,
+              built[MemoryCategory::PREFERENCES].peak_bytes);
+
+    std::ostringstream os;
+    generate_memory_report(removed, os);
+    EXPECT_NE(os.str().find("receiver preferences: "), std::string::npos);
+}
+
+TEST(PackageTableTest, ReusesLowestFreedId) {
+    static_assert(std::is_trivially_copyable<PackageHandle>::value, "");
+    PackageTable table;
+    PackageHandle a = table.create(), b = table.create(), c = table.create();
+    EXPECT_EQ(table.get_id(c), 3);
+
+    table.release(b);
+    table.release(a);
+    EXPECT_FALSE(table.is_live(a));
+    EXPECT_THROW(table.release(a), std::logic_error);
+
+    PackageHandle d = table.create();
+    EXPECT_EQ(table.get_id(d), 1); // like Package - lowest freed ID
+    EXPECT_TRUE(table.is_live(d));
+    EXPECT_FALSE(table.is_live(a)); // same slot, stale handle
+    EXPECT_EQ(table.size(), 2u);
+}
+
+TEST(PackageTableTest, HandleQueueWrapsAndMovesInBulk) {
+    PackageTable table;
+    PackageHandleQueue fifo(PackageQueueType::FIFO), other(PackageQueueType::LIFO);
+    for (int i = 0; i < 6; ++i) {
+        fifo.push(table.create()); // IDs 1..6
+    }
+    fifo.pop();
+    fifo.pop();
+    for (int i = 0; i < 6; ++i) {
+        fifo.push(table.create()); // wraps around, then grows: IDs 7..12
+    }
+    for (int i = 0; i < 3; ++i) {
+        other.push(table.create()); // IDs 13..15
+    }
+
+    other.take_all(fifo);
+    EXPECT_TRUE(fifo.empty());
+    ASSERT_EQ(other.size(), 13u);
+    EXPECT_EQ(table.get_id(other.pop_front()), 13);
+    EXPECT_EQ(table.get_id(other.pop()), 12); // LIFO
+    other.pop_front();
+    other.pop_front();
+    EXPECT_EQ(table.get_id(other.pop_front()), 3);
+
+    other.take_all(other); // nothing moves
+    ASSERT_EQ(other.size(), 8u);
+    EXPECT_EQ(table.get_id(other[0]), 4);
+    EXPECT_EQ(table.get_id(other[7]), 11);
+}
+
+TEST(PackageTableTest, FactoryNodesShareItsTable) {
+    Factory f;
+    f.add_ramp(Ramp(1, 1));
+    f.add_worker(
+        Worker(1, 3, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    f.add_storehouse(Storehouse(1));
+    Worker &worker = *f.find_worker_by_id(1);
+    f.find_ramp_by_id(1)->get_receiver_preferences().add_receiver(&worker);
+    worker.get_receiver_preferences().add_receiver(
+        &*f.find_storehouse_by_id(1));
+
+    for (Time t = 1; t <= 8; ++t) {
+        f.do_deliveries(t);
+        f.do_package_passing();
+        f.do_work(t);
+    }
+    const Storehouse &storehouse = *f.find_storehouse_by_id(1);
+    std::size_t stock = std::distance(storehouse.cbegin(), storehouse.cend());
+    std::size_t at_worker = worker.get_queue()->size() +
+                            (worker.get_processing_buffer() ? 1 : 0) +
+                            (worker.get_sending_buffer() ? 1 : 0);
+    EXPECT_EQ(stock, 2u);
+    EXPECT_EQ(f.get_package_table().size(),
+              stock + at_worker +
+                  (f.find_ramp_by_id(1)->get_sending_buffer() ? 1 : 0));
+    EXPECT_EQ(storehouse.cbegin()->get_id(), 1); // delivered first, stored
+
+    // An extracted worker takes its packages (with their IDs) along
+    ElementID in_hand = worker.get_processing_buffer()->get_id();
+    std::size_t in_factory = f.get_package_table().size();
+    auto extracted = f.extract_worker(1);
+    EXPECT_EQ(f.get_package_table().size(), in_factory - at_worker);
+    EXPECT_EQ(extracted.front().get_processing_buffer()->get_id(), in_hand);
+    EXPECT_EQ(&extracted.front().get_package_table(),
+              &default_package_table());
+}
+
+TEST(SweepTest, PointMatchesFactoryRun) {
+    RandomFactoryOptions options;
+    options.n_workers = 40;
+    Factory factory;
+    build_random_factory(factory, options);
+    Topology topology = make_topology(factory);
+
+    SweepPoint point;
+    point.seed = 21;
+    seed_routing_streams(factory, 21);
+    simulate(factory, 150, [](Factory &, Time) {});
+    EXPECT_TRUE(sweep_point_counts(topology, point, 150) == collect_node_counts(factory));
+
+    // Overridden duration gives the same as a Factory built with it
+    Factory fast, slow;
+    build_line(fast, 1, 1);
+    build_line(slow, 1, 3);
+    seed_routing_streams(slow, 2);
+    simulate(slow, 30, [](Factory &, Time) {});
+    SweepPoint slow_point;
+    slow_point.seed = 2;
+    slow_point.processing_durations[1] = 3;
+    EXPECT_TRUE(sweep_point_counts(make_topology(fast), slow_point, 30) ==
+                collect_node_counts(slow));
+
+    slow_point.processing_durations[7] = 3;
+    EXPECT_THROW(run_sweep_point(make_topology(fast), slow_point, 30), std::logic_error);
+
+    // Every package delivered so far is either stored or still in the Net
+    SweepResult result = run_sweep_point(topology, point, 150);
+    std::size_t deliveries = 0;
+    for (TimeOffset di : topology.delivery_intervals) {
+        deliveries += (150 - 1) / di + 1;
+    }
+    EXPECT_GT(result.in_progress, 0u);
+    EXPECT_EQ(result.delivered + result.in_progress, deliveries);
+}
+
+TEST(SweepTest, ThreadsShareTopology) {
+    Factory factory;
+    build_split(factory);
+    const Topology topology = make_topology(factory);
+    std::vector<SweepPoint> points =
+        make_sweep_grid({{NodeType::RAMP, 1, {1, 2, 3}}, {NodeType::WORKER, 1, {1, 2, 3, 4}}}, 5);
+    ASSERT_EQ(points.size(), 12u);
+
+    std::vector<SweepResult> results = run_sweep(topology, points, 100, 4);
+    ASSERT_EQ(results.size(), 12u);
+    for (std::size_t i = 0; i < points.size(); ++i) {
+        SweepResult alone = run_sweep_point(topology, points[i], 100);
+        EXPECT_EQ(results[i].delivered, alone.delivered);
+        EXPECT_DOUBLE_EQ(results[i].mean_queue, alone.mean_queue);
+    }
+    // Ramp every round, worker needing 4 rounds - the queue grows
+    EXPECT_GT(results[3].max_queue, results[0].max_queue);
+
+    std::ostringstream os;
+    print_sweep_table(os, points, results);
+    EXPECT_NE(os.str().find("LOADING RAMP #1=3 WORKER #1=4"), std::string::npos);
+}
+
+TEST(BackpressureTest, FullQueueBlocksSender) {
+    Factory factory;
+    build_line(factory, 1, 3); // ramp every round, worker needs 3 rounds
+    Worker &worker = *factory.find_worker_by_id(1);
+    worker.set_queue_capacity(2);
+
+    std::size_t max_queue = 0;
+    simulate(factory, 30, [&](Factory &f, Time) {
+        max_queue = std::max(max_queue, f.find_worker_by_id(1)->get_queue()->size());
+    });
+
+    EXPECT_EQ(max_queue, 2u);
+    const Ramp &ramp = *factory.find_ramp_by_id(1);
+    EXPECT_GT(ramp.get_blocked_rounds(), 15u); // ramp is 3 times faster
+    EXPECT_TRUE(ramp.get_sending_buffer() != nullptr);
+    // Throughput limited by the worker: one product every 3 rounds
+    EXPECT_EQ(factory.find_storehouse_by_id(1)->get_stockpile()->size(), 9u);
+    EXPECT_THROW(make_topology(factory), std::logic_error);
+}
+
+TEST(BackpressureTest, BlockedWorkerHoldsFinishedProduct) {
+    Worker upstream(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    Worker downstream(2, 5, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    downstream.set_queue_capacity(1);
+    upstream.get_receiver_preferences().add_receiver(&downstream);
+    for (ElementID id = 101; id <= 104; ++id) {
+        upstream.receive_package(Package(id));
+    }
+
+    for (Time t = 1; t <= 4; ++t) {
+        upstream.send_package();
+        upstream.do_work(t);
+        downstream.do_work(t);
+    }
+    // 101 in downstream's hands, 102 in its queue, 103 blocked in the
+    // buffer, 104 finished and held, nothing lost
+    EXPECT_EQ(downstream.get_processing_buffer()->get_id(), 101);
+    EXPECT_EQ(downstream.get_queue()->size(), 1u);
+    EXPECT_EQ(upstream.get_sending_buffer()->get_id(), 103);
+    EXPECT_EQ(upstream.get_processing_buffer()->get_id(), 104);
+    EXPECT_EQ(upstream.get_blocked_rounds(), 1u); // round 4
+}
+
+TEST(FactoryImageTest, LoadedFactoryRunsLikeOriginal) {
+    RandomFactoryOptions options;
+    options.n_workers = 30;
+    Factory original;
+    build_random_factory(original, options);
+    original.find_worker_by_id(3)->set_queue_capacity(2);
+    std::string path = ::testing::TempDir() + "netsim_factory.img";
+    write_factory_image(original, path);
+
+    Factory loaded;
+    {
+        FactoryImage image(path);
+        EXPECT_EQ(image.get_header().n_workers, 30u);
+        load_factory_image(loaded, image);
+        EXPECT_THROW(load_factory_image(loaded, image), std::logic_error);
+    }
+    EXPECT_TRUE(loaded.is_consistent());
+    EXPECT_EQ(loaded.find_worker_by_id(3)->get_queue_capacity(), 2u);
+
+    seed_routing_streams(original, 5);
+    seed_routing_streams(loaded, 5);
+    simulate(original, 100, [](Factory &, Time) {});
+    simulate(loaded, 100, [](Factory &, Time) {});
+    EXPECT_TRUE(collect_node_counts(loaded) == collect_node_counts(original));
+}
+
+TEST(FactoryImageTest, RejectsDamagedFile) {
+    Factory factory;
+    build_split(factory);
+    std::string path = ::testing::TempDir() + "netsim_damaged.img";
+    write_factory_image(factory, path);
+
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    std::ofstream(path, std::ios::binary) << bytes.substr(0, bytes.size() - 8);
+    EXPECT_THROW(FactoryImage image(path), std::runtime_error);
+
+    // Records the nodes can't run with (division by zero, no queue type)
+    FactoryImageHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    auto expect_rejected = [&](std::size_t offset, std::int32_t value) {
+        std::string damaged = bytes;
+        std::memcpy(&damaged[offset], &value, sizeof(value));
+        std::ofstream(path, std::ios::binary) << damaged;
+        EXPECT_THROW(FactoryImage image(path), std::runtime_error);
+    };
+    expect_rejected(header.ramps_offset + offsetof(RampRecord, delivery_interval), 0);
+    expect_rejected(header.workers_offset + offsetof(WorkerRecord, processing_duration), -1);
+    expect_rejected(header.workers_offset + offsetof(WorkerRecord, queue_type), 7);
+
+    bytes[0] = 'X';
+    std::ofstream(path, std::ios::binary) << bytes;
+    EXPECT_THROW(FactoryImage image(path), std::runtime_error);
+    EXPECT_THROW(FactoryImage image(path + ".missing"), std::runtime_error);
+}
+
+TEST(ReplicationsTest, CommonRandomNumbersReduceVariance) {
+    // B's worker is twice as slow; the metric depends on the random split
+    auto build_a = [](Factory &f) { build_split(f); };
+    auto build_b = [](Factory &f) {
+        build_line(f, 1, 2);
+        f.add_storehouse(Storehouse(2));
+        f.find_worker_by_id(1)->get_receiver_preferences().add_receiver(
+            &*f.find_storehouse_by_id(2));
+    };
+    auto first_storehouse = [](const Factory &f) {
+        return static_cast<double>(
+            f.find_storehouse_by_id(1)->get_stockpile()->size());
+    };
+    ReplicationOptions options;
+    options.n_replications = 20;
+    options.rounds = 60;
+
+    ComparisonReport common =
+        compare_configurations(build_a, build_b, options, first_storehouse);
+    EXPECT_EQ(common.metrics_a.size(), 20u);
+    EXPECT_GT(common.mean_difference, 0.0);
+    EXPECT_GT(common.variance_reduction, 2.0);
+
+    options.antithetic = true;
+    ComparisonReport antithetic =
+        compare_configurations(build_a, build_b, options, first_storehouse);
+    EXPECT_GT(antithetic.variance_reduction, 2.0);
+
+    std::ostringstream os;
+    print_comparison_report(os, antithetic);
+    EXPECT_NE(os.str().find("Variance reduction:"), std::string::npos);
+
+    options.n_replications = 5;
+    EXPECT_THROW(compare_configurations(build_a, build_b, options), std::logic_error);
+}
+
+TEST(ModulesTest, InstancesShareCellAndMatchExpandedFactory) {
+    CellBuilder builder;
+    std::size_t in = builder.add_worker(1);
+    std::size_t mid = builder.add_worker(2);
+    std::size_t out = builder.add_worker(3);
+    builder.add_link(in, mid);
+    builder.add_link(in, out);
+    builder.add_link(mid, out);
+    builder.add_input(in);
+    builder.add_output(out); // to the next cell
+    builder.add_output(mid); // scrap
+    EXPECT_THROW(builder.add_link(in, mid), std::logic_error);
+    std::shared_ptr<const CellType> cell = builder.build();
+
+    ModularFactory plant;
+    plant.add_ramp(1, 1);
+    plant.add_ramp(2, 2);
+    plant.add_storehouse(1);
+    plant.add_storehouse(2);
+    const std::size_t n = 40;
+    for (std::size_t i = 0; i < n; ++i) {
+        plant.add_instance(cell, static_cast<ElementID>(100 + 10 * i));
+    }
+    EXPECT_THROW(plant.add_instance(cell, 101), std::logic_error);
+    EXPECT_EQ(cell.use_count(), static_cast<long>(n + 1)); // one shared copy
+    EXPECT_EQ(plant.get_worker_count(), 3 * n);
+
+    plant.link_ramp(1, 0, 0);
+    plant.link_ramp(2, 0, 0);
+    plant.link_ramp(2, 20, 0);
+    for (std::size_t i = 0; i < n; ++i) {
+        if (i + 1 < n) {
+            plant.connect_output(i, 0, i + 1, 0);
+        } else {
+            EXPECT_THROW(plant.simulate(10, 1), std::logic_error);
+            plant.connect_output_to_storehouse(i, 0, 1);
+        }
+        plant.connect_output_to_storehouse(i, 1, 2);
+    }
+    plant.simulate(200, 9);
+
+    Factory factory;
+    plant.expand(factory);
+    EXPECT_TRUE(factory.is_consistent());
+    seed_routing_streams(factory, 9);
+    simulate(factory, 200, [](Factory &, Time) {});
+    EXPECT_TRUE(plant.collect_node_counts() == collect_node_counts(factory));
+}
+
+// Helper: one ramp per round feeding three workers needing 3 rounds each
+static std::size_t max_queue_with(std::unique_ptr<IRoutingPolicy> policy) {
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    factory.add_storehouse(Storehouse(1));
+    auto &prefs = factory.find_ramp_by_id(1)->get_receiver_preferences();
+    for (ElementID id = 1; id <= 3; ++id) {
+        factory.add_worker(Worker(id, 3, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+        factory.find_worker_by_id(id)->get_receiver_preferences().add_receiver(
+            &*factory.find_storehouse_by_id(1));
+        prefs.add_receiver(&*factory.find_worker_by_id(id));
+    }
+    seed_routing_streams(factory, 4);
+    prefs.set_routing_policy(std::move(policy));
+
+    std::size_t max_queue = 0;
+    simulate(factory, 300, [&](Factory &f, Time) {
+        for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+            max_queue = std::max(max_queue, it->get_queue()->size());
+        }
+    });
+    return max_queue;
+}
+
+TEST(RoutingPolicyTest, LoadAwarePoliciesKeepQueuesShort) {
+    std::size_t random = max_queue_with(nullptr);
+    EXPECT_GT(random, 3u); // fully loaded, random split drifts
+    EXPECT_LE(max_queue_with(std::make_unique<RoundRobinPolicy>()), 1u);
+    EXPECT_LT(max_queue_with(std::make_unique<PowerOfDPolicy>(2)), random);
+    EXPECT_THROW(PowerOfDPolicy(0), std::logic_error);
+}
+
+TEST(RoutingPolicyTest, RoundRobinFollowsReceiverChanges) {
+    Storehouse s1(1), s2(2), s3(3);
+    ReceiverPreferences prefs;
+    prefs.add_receiver(&s1);
+    prefs.add_receiver(&s2);
+    prefs.set_routing_policy(std::make_unique<RoundRobinPolicy>());
+    EXPECT_EQ(prefs.choose_receiver(), &s1);
+    EXPECT_EQ(prefs.choose_receiver(), &s2);
+    prefs.add_receiver(&s3);
+    EXPECT_EQ(prefs.choose_receiver(), &s1);
+    prefs.remove_receiver(&s1);
+    EXPECT_EQ(prefs.choose_receiver(), &s3);
+    EXPECT_EQ(prefs.choose_receiver(), &s2);
+
+    Factory factory;
+    build_line(factory, 1, 1);
+    factory.find_ramp_by_id(1)->get_receiver_preferences().set_routing_policy(
+        std::make_unique<PowerOfDPolicy>());
+    EXPECT_THROW(make_topology(factory), std::logic_error);
+}
+
+TEST(LocalityTest, ReorderedFactoryRunsTheSame) {
+    RandomFactoryOptions options;
+    options.n_workers = 60;
+    Factory reference, bfs, topological, chains;
+    build_random_factory(reference, options);
+    build_random_factory(bfs, options);
+    build_random_factory(topological, options);
+    build_random_factory(chains, options);
+    reorder_for_locality(chains, NodeOrder::CHAINS);
+
+    NodeLayout layout = make_node_layout(bfs, NodeOrder::BFS);
+    reorder_for_locality(bfs, NodeOrder::BFS);
+    std::vector<ElementID> ids;
+    for (auto it = bfs.worker_cbegin(); it != bfs.worker_cend(); ++it) {
+        ids.push_back(it->get_id());
+    }
+    EXPECT_EQ(ids, layout.workers);
+    EXPECT_EQ(ids.size(), 60u);
+
+    // Every worker comes after the workers feeding it
+    reorder_for_locality(topological, NodeOrder::TOPOLOGICAL);
+    std::set<const IPackageReceiver *> stepped;
+    for (auto it = topological.worker_cbegin(); it != topological.worker_cend(); ++it) {
+        for (const auto &pair : it->get_receiver_preferences()) {
+            EXPECT_FALSE(stepped.count(pair.first));
+        }
+        stepped.insert(&*it);
+    }
+
+    for (Factory *f : {&reference, &bfs, &topological, &chains}) {
+        EXPECT_TRUE(f->is_consistent());
+        seed_routing_streams(*f, 13);
+        simulate(*f, 120, [](Factory &, Time) {});
+    }
+    EXPECT_TRUE(collect_node_counts(bfs) == collect_node_counts(reference));
+    EXPECT_TRUE(collect_node_counts(topological) == collect_node_counts(reference));
+    EXPECT_TRUE(collect_node_counts(chains) == collect_node_counts(reference));
+
+    // Shared IDs can't be told apart - refused, nothing moved
+    Factory twins;
+    build_line(twins, 1, 1);
+    twins.add_worker(Worker(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    const Worker *first = &*twins.worker_cbegin();
+    EXPECT_THROW(reorder_for_locality(twins, NodeOrder::BFS), std::logic_error);
+    EXPECT_EQ(&*twins.worker_cbegin(), first);
+    EXPECT_EQ(std::distance(twins.worker_cbegin(), twins.worker_cend()), 2);
+}
+
+TEST(ActiveSetTest, SkipsIdleWorkersWithSameResults) {
+    RandomFactoryOptions options;
+    options.n_workers = 80;
+    options.max_interval = 6;
+    options.max_duration = 5;
+    Factory full, active;
+    build_random_factory(full, options);
+    build_random_factory(active, options);
+    active.set_active_stepping(true);
+
+    // One shared sequence - the same numbers only if senders keep the order
+    for (Factory *f : {&full, &active}) {
+        auto gen = std::make_shared<std::mt19937>(5);
+        set_routing_generator(*f, [gen]() {
+            return std::generate_canonical<double, 10>(*gen);
+        });
+        for (auto it = f->worker_begin(); it != f->worker_end(); ++it) {
+            it->set_queue_capacity(it->get_id() % 4 == 0 ? 1 : 0);
+        }
+    }
+    FactoryEngine full_engine(full), active_engine(active);
+    DifferentialReport report =
+        run_differential(full_engine, active_engine, 150);
+    EXPECT_FALSE(report.diverged);
+
+    // A package put in from outside wakes the worker by itself, getters
+    // leave the active sets alone
+    for (Factory *f : {&full, &active}) {
+        f->find_worker_by_id(options.n_workers)->receive_package(Package());
+        for (Time t = 151; t <= 160; ++t) {
+            f->do_deliveries(t);
+            f->do_package_passing();
+            f->do_work(t);
+        }
+    }
+    EXPECT_TRUE(collect_node_counts(active) == collect_node_counts(full));
+    EXPECT_TRUE(active.is_active_stepping());
+}
+
+TEST(TimeTravelTest, RebuildsPastRoundsFromCheckpoints) {
+    RandomFactoryOptions options;
+    options.n_workers = 30;
+    Factory factory;
+    build_random_factory(factory, options);
+    for (auto it = factory.worker_begin(); it != factory.worker_end(); ++it) {
+        it->set_queue_capacity(it->get_id() % 3 == 0 ? 2 : 0); // blocking
+    }
+    seed_routing_streams(factory, 21);
+
+    TimeTravelRecorder recorder(factory, 50);
+    package_move_listener = &recorder;
+    std::map<Time, TurnSnapshot> live;
+    take_snapshot(factory, 0, live[0]);
+    std::set<Time> probes = {1, 37, 50, 51, 100, 173, 299, 300};
+    simulate(factory, 300, [&](Factory &f, Time t) {
+        if (probes.count(t)) {
+            take_snapshot(f, t, live[t]);
+        }
+    });
+    package_move_listener = nullptr;
+    EXPECT_EQ(recorder.get_checkpoint_count(), 6u); // after 0, 50, ..., 250
+    EXPECT_EQ(recorder.get_last_round(), 300);
+
+    for (const auto &pair : live) {
+        TurnSnapshot past;
+        recorder.reconstruct(pair.first, past);
+        std::string expected, rebuilt;
+        format_turn_report(pair.second, expected);
+        format_turn_report(past, rebuilt);
+        EXPECT_EQ(rebuilt, expected) << "round " << pair.first;
+        ASSERT_EQ(past.ramps.size(), pair.second.ramps.size());
+        for (std::size_t r = 0; r < past.ramps.size(); ++r) {
+            EXPECT_EQ(past.ramps[r].sending_package,
+                      pair.second.ramps[r].sending_package);
+        }
+    }
+    TurnSnapshot past;
+    EXPECT_THROW(recorder.reconstruct(301, past), std::out_of_range);
+    EXPECT_THROW(TimeTravelRecorder(factory, 0), std::logic_error);
+}
+
+#if defined(__cpp_impl_coroutine)
+// Rounds in which workers moved a package to the output buffer
+struct FinishRounds : IPackageMoveListener {
+    void on_round(Time t) override { round = t; }
+    void on_delivery(ElementID, ElementID) override {}
+    void on_receive(ReceiverType, ElementID, ElementID) override {}
+    void on_start(ElementID, ElementID) override {}
+    void on_finish(ElementID) override { finished.push_back(round); }
+
+    Time round = 0;
+    std::vector<Time> finished;
+};
+
+TEST(WorkerCoroutineTest, StationsResumeOnlyWhenTheirWaitHolds) {
+    RandomFactoryOptions options;
+    options.n_workers = 40;
+    Factory plain, coroutines;
+    build_random_factory(plain, options);
+    build_random_factory(coroutines, options);
+    coroutines.set_active_stepping(true);
+    for (Factory *f : {&plain, &coroutines}) {
+        seed_routing_streams(*f, 8);
+        for (auto it = f->worker_begin(); it != f->worker_end(); ++it) {
+            it->set_queue_capacity(it->get_id() % 4 == 0 ? 1 : 0);
+            if (f == &coroutines) {
+                TimeOffset pd = it->get_processing_duration();
+                set_coroutine_behaviour(*it, [pd](WorkerContext &ctx) {
+                    return fixed_duration_station(ctx, pd);
+                });
+            }
+        }
+    }
+    FactoryEngine plain_engine(plain), coroutine_engine(coroutines);
+    EXPECT_FALSE(
+        run_differential(plain_engine, coroutine_engine, 150).diverged);
+    EXPECT_THROW(make_topology(coroutines), std::logic_error);
+
+    // Two packages, then 3 rounds of maintenance; not visited meanwhile
+    Factory factory;
+    build_line(factory, 1, 1);
+    factory.set_active_stepping(true);
+    Worker &station = *factory.find_worker_by_id(1);
+    set_coroutine_behaviour(station, [](WorkerContext &ctx) {
+        return maintenance_station(ctx, 1, 2, 3);
+    });
+    FinishRounds listener;
+    package_move_listener = &listener;
+    Time wake_after_2 = 0;
+    simulate(factory, 16, [&](Factory &, Time t) {
+        if (t == 2) {
+            wake_after_2 = station.get_behaviour()->get_wake_round();
+        }
+    });
+    package_move_listener = nullptr;
+    EXPECT_EQ(listener.finished, (std::vector<Time>{1, 2, 6, 7, 11, 12, 16}));
+    EXPECT_EQ(wake_after_2, 6);
+
+    Worker worker(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    set_coroutine_behaviour(worker, [](WorkerContext &ctx) {
+        return maintenance_station(ctx, 1, 0, 3);
+    });
+    EXPECT_THROW(worker.do_work(1), std::logic_error);
+    worker.do_work(2); // returned, does nothing
+}
+#endif
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,112 @@
+// Round time of a large, mostly idle Factory with full and active stepping
+// Run each mode in its own process - package IDs are global, so a second
+// Factory in the same process would run slower
+// Build: g++ -std=c++17 -O2 -I include tools/netsim_active_bench.cpp
+//        src/factory.cpp src/nodes.cpp src/package.cpp src/storage_types.cpp
+//        src/helpers.cpp src/trace.cpp src/replay.cpp src/package_table.cpp
+//        src/memory_accounting.cpp src/time_travel.cpp src/reports.cpp
+//        -o netsim_active_bench
+// Usage: netsim_active_bench [full|active] [workers] [ramps] [interval]
+// Layers of 100 workers, each linked to two workers of the next layer and
+// to a storehouse; the ramps feed the first layer every 'interval' rounds
+// Both modes print the same number of busy workers at the end
+
+#include "../include/factory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace NetSim;
+
+namespace {
+const int WIDTH = 100;
+const int N_STOREHOUSES = 16;
+
+void build(Factory &f, int n_workers, int n_ramps, TimeOffset interval) {
+    std::mt19937 gen(1);
+    std::pmr::memory_resource *resource = f.get_memory_resource();
+
+    std::vector<Worker *> workers;
+    for (ElementID id = 1; id <= n_workers; ++id) {
+        f.add_worker(Worker(id, 1 + id % 3,
+                            std::make_unique<PackageQueue>(
+                                PackageQueueType::FIFO, resource)));
+        workers.push_back(&*std::prev(f.worker_end()));
+    }
+    std::vector<Storehouse *> storehouses;
+    for (ElementID id = 1; id <= N_STOREHOUSES; ++id) {
+        f.add_storehouse(Storehouse(
+            id, std::make_unique<PackageQueue>(PackageQueueType::FIFO,
+                                               resource)));
+        storehouses.push_back(&*std::prev(f.storehouse_end()));
+    }
+
+    for (int i = 0; i < n_workers; ++i) {
+        auto &prefs = workers[i]->get_receiver_preferences();
+        int first = (i / WIDTH + 1) * WIDTH;
+        int last = std::min(first + WIDTH, n_workers) - 1;
+        if (first <= last) {
+            std::uniform_int_distribution<int> pick(first, last);
+            prefs.add_receiver(workers[pick(gen)]);
+            prefs.add_receiver(workers[pick(gen)]);
+        }
+        prefs.add_receiver(storehouses[i % N_STOREHOUSES]);
+    }
+    for (ElementID id = 1; id <= n_ramps; ++id) {
+        f.add_ramp(Ramp(id, interval));
+        std::prev(f.ramp_end())->get_receiver_preferences().add_receiver(
+            workers[(id - 1) % std::min(WIDTH, n_workers)]);
+    }
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "active";
+    int n_workers = argc > 2 ? std::atoi(argv[2]) : 200000;
+    int n_ramps = argc > 3 ? std::atoi(argv[3]) : 10;
+    TimeOffset interval = argc > 4 ? std::atoi(argv[4]) : 5;
+    if ((mode != "full" && mode != "active") || n_workers < 1 ||
+        n_ramps < 1 || interval < 1) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [full|active] [workers] [ramps] [interval]\n";
+        return 1;
+    }
+
+    // Seeded routing (one shared sequence), so both modes end the same
+    std::mt19937 routing(7);
+    probability_generator = [&routing]() {
+        return std::generate_canonical<double, 10>(routing);
+    };
+
+    Factory f;
+    build(f, n_workers, n_ramps, interval);
+    f.set_active_stepping(mode == "active");
+
+    const Time rounds = 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (Time t = 1; t <= rounds; ++t) {
+        f.do_deliveries(t);
+        f.do_package_passing();
+        f.do_work(t);
+    }
+    double round_time = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count() /
+                        rounds;
+
+    std::size_t busy = 0;
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        busy += it->get_processing_buffer() || !it->get_queue()->empty();
+    }
+    std::cout << mode << ", " << n_workers << " workers, " << n_ramps
+              << " ramps every " << interval << " rounds: round "
+              << round_time * 1e6 << " us, " << busy
+              << " workers busy at the end" << std::endl;
+    return 0;
+}
@@ -0,0 +1,105 @@
+// Build and teardown cost of a large Factory, pooled vs plain heap memory
+// Build: g++ -std=c++17 -O2 -I include tools/netsim_arena_bench.cpp
+//        src/factory.cpp src/nodes.cpp src/package.cpp src/storage_types.cpp
+//        src/helpers.cpp src/trace.cpp src/replay.cpp src/package_table.cpp
+//        src/memory_accounting.cpp src/time_travel.cpp src/reports.cpp
+//        -o netsim_arena_bench
+// Usage: netsim_arena_bench [pool|heap] [nodes]
+// Run each mode in its own process - freed heap memory is not returned to
+// the system, so RSS of a second run in the same process means nothing
+
+#include "../include/factory.hpp"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace NetSim;
+
+namespace {
+double resident_mb() {
+    std::ifstream statm("/proc/self/statm");
+    long pages_total = 0, pages_resident = 0;
+    statm >> pages_total >> pages_resident;
+    return pages_resident * static_cast<double>(sysconf(_SC_PAGESIZE)) /
+           (1024.0 * 1024.0);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+}
+
+/**
+ * @brief Chains of workers fed by one ramp each, every worker also linked
+ * to a storehouse (1% ramps, 1% storehouses)
+ */
+void build(Factory &f, int n_nodes) {
+    int n_ramps = std::max(1, n_nodes / 100);
+    int n_storehouses = n_ramps;
+    int n_workers = n_nodes - n_ramps - n_storehouses;
+    std::pmr::memory_resource *resource = f.get_memory_resource();
+
+    std::vector<Storehouse *> storehouses;
+    for (int id = 1; id <= n_storehouses; ++id) {
+        f.add_storehouse(Storehouse(
+            id, std::make_unique<PackageQueue>(PackageQueueType::FIFO,
+                                               resource)));
+        storehouses.push_back(&*std::prev(f.storehouse_end()));
+    }
+
+    int chain = n_workers / n_ramps;
+    Worker *previous = nullptr;
+    for (int id = 1; id <= n_workers; ++id) {
+        f.add_worker(Worker(id, 1 + id % 3,
+                            std::make_unique<PackageQueue>(
+                                PackageQueueType::FIFO, resource)));
+        Worker *worker = &*std::prev(f.worker_end());
+        worker->get_receiver_preferences().add_receiver(
+            storehouses[id % n_storehouses]);
+
+        if ((id - 1) % chain == 0 && (id - 1) / chain < n_ramps) {
+            f.add_ramp(Ramp((id - 1) / chain + 1, 2)); // head of a chain
+            std::prev(f.ramp_end())->get_receiver_preferences().add_receiver(
+                worker);
+        } else if (previous) {
+            previous->get_receiver_preferences().add_receiver(worker);
+        }
+        previous = worker;
+    }
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "pool";
+    int n_nodes = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    if ((mode != "pool" && mode != "heap") || n_nodes < 3) {
+        std::cerr << "Usage: " << argv[0] << " [pool|heap] [nodes]\n";
+        return 1;
+    }
+
+    double rss_before = resident_mb();
+    auto start = std::chrono::steady_clock::now();
+    auto f = mode == "pool"
+                 ? std::make_unique<Factory>()
+                 : std::make_unique<Factory>(std::pmr::new_delete_resource());
+    build(*f, n_nodes);
+    double build_time = seconds_since(start);
+    double rss_built = resident_mb();
+
+    start = std::chrono::steady_clock::now();
+    f.reset();
+    double teardown_time = seconds_since(start);
+
+    std::cout << mode << ": " << n_nodes << " nodes, build " << build_time
+              << " s, teardown " << teardown_time << " s, RSS +"
+              << rss_built - rss_before << " MB" << std::endl;
+    return 0;
+}
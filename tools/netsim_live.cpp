@@ -0,0 +1,51 @@
+// Reader tool for the live statistics of a running simulation
+// Build: g++ -std=c++17 -I include tools/netsim_live.cpp src/live_stats.cpp
+//        src/factory.cpp src/nodes.cpp src/package.cpp src/storage_types.cpp
+//        src/helpers.cpp src/trace.cpp src/replay.cpp src/package_table.cpp
+//        src/memory_accounting.cpp src/time_travel.cpp src/reports.cpp
+//        -lpthread -o netsim_live
+// Usage: netsim_live <shm-name> [interval-ms]
+
+#include "../include/live_stats.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+using namespace NetSim;
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <shm-name> [interval-ms]\n";
+        return 1;
+    }
+    int interval_ms = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    try {
+        LiveStatsReader reader(argv[1]);
+        LiveStatsSnapshot snapshot;
+
+        while (true) {
+            if (reader.read(snapshot)) {
+                std::cout << "Round " << snapshot.round << " ("
+                          << snapshot.rounds_per_second << " rounds/s)"
+                          << (snapshot.truncated ? " [truncated]" : "")
+                          << "\n";
+                for (const auto &worker : snapshot.worker_queues) {
+                    std::cout << "  WORKER #" << worker.first
+                              << " queue: " << worker.second << "\n";
+                }
+                for (const auto &storehouse : snapshot.storehouse_totals) {
+                    std::cout << "  STOREHOUSE #" << storehouse.first
+                              << " stored: " << storehouse.second << "\n";
+                }
+                std::cout << std::flush;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
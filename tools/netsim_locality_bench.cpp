@@ -0,0 +1,159 @@
+// Stepping speed of a large Factory with and without reorder_for_locality
+// Run each order in its own process - package IDs are global, so a second
+// Factory in the same process would run slower
+// Build: g++ -std=c++17 -O2 -I include tools/netsim_locality_bench.cpp
+//        src/factory.cpp src/nodes.cpp src/package.cpp src/storage_types.cpp
+//        src/helpers.cpp src/trace.cpp src/replay.cpp src/locality.cpp
+//        src/memory_accounting.cpp src/time_travel.cpp src/reports.cpp
+//        src/package_table.cpp -o netsim_locality_bench
+// Usage: netsim_locality_bench [random|layered] [workers]
+//        [none|bfs|topological|chains]
+// Workers are added in shuffled order, as when a Net is loaded from a file
+// sorted by ID. Besides round time it prints the share of links whose
+// sender and receiver are within 4 KiB; for hardware counters run it under
+// 'perf stat -e cache-misses'
+
+#include "../include/factory.hpp"
+#include "../include/locality.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace NetSim;
+
+namespace {
+const int N_STOREHOUSES = 16;
+
+/**
+ * @brief Random forward links (no cycles) or layers of 100 workers linked
+ * to the next layer, two links per worker, ramps feed the first workers
+ */
+void build(Factory &f, const std::string &shape, int n_workers) {
+    std::mt19937 gen(1);
+    std::pmr::memory_resource *resource = f.get_memory_resource();
+
+    // Position in the graph -> worker ID, IDs given in shuffled order
+    std::vector<ElementID> ids(n_workers);
+    for (int i = 0; i < n_workers; ++i) {
+        ids[i] = i + 1;
+    }
+    std::shuffle(ids.begin(), ids.end(), gen);
+    std::vector<int> position(n_workers + 1);
+    for (int i = 0; i < n_workers; ++i) {
+        position[ids[i]] = i;
+    }
+    std::vector<Worker *> at(n_workers);
+    for (ElementID id = 1; id <= n_workers; ++id) {
+        f.add_worker(Worker(id, 1 + id % 3,
+                            std::make_unique<PackageQueue>(
+                                PackageQueueType::FIFO, resource)));
+    }
+    for (auto it = f.worker_begin(); it != f.worker_end(); ++it) {
+        at[position[it->get_id()]] = &*it;
+    }
+    std::vector<Storehouse *> storehouses;
+    for (int id = 1; id <= N_STOREHOUSES; ++id) {
+        f.add_storehouse(Storehouse(
+            id, std::make_unique<PackageQueue>(PackageQueueType::FIFO,
+                                               resource)));
+        storehouses.push_back(&*std::prev(f.storehouse_end()));
+    }
+
+    const int width = 100;
+    for (int i = 0; i < n_workers; ++i) {
+        auto &prefs = at[i]->get_receiver_preferences();
+        int first = shape == "layered" ? (i / width + 1) * width : i + 1;
+        int last = shape == "layered" ? first + width - 1 : n_workers - 1;
+        last = std::min(last, n_workers - 1);
+        if (first <= last) {
+            std::uniform_int_distribution<int> pick(first, last);
+            prefs.add_receiver(at[pick(gen)]);
+            prefs.add_receiver(at[pick(gen)]);
+        }
+        prefs.add_receiver(storehouses[i % N_STOREHOUSES]);
+    }
+    int n_ramps = shape == "layered" ? width : 16;
+    for (int id = 1; id <= n_ramps; ++id) {
+        f.add_ramp(Ramp(id, 1));
+        std::prev(f.ramp_end())->get_receiver_preferences().add_receiver(
+            at[(id - 1) % n_workers]);
+    }
+}
+
+/**
+ * @brief Share of worker -> worker links whose ends lie within 4 KiB
+ */
+double near_link_share(Factory &f) {
+    std::size_t near = 0, n = 0;
+    for (auto it = f.worker_cbegin(); it != f.worker_cend(); ++it) {
+        auto from = reinterpret_cast<std::intptr_t>(&*it);
+        for (const auto &pair : it->get_receiver_preferences()) {
+            if (pair.first->get_receiver_type() == ReceiverType::WORKER) {
+                auto to = reinterpret_cast<std::intptr_t>(
+                    dynamic_cast<const Worker *>(pair.first));
+                near += std::abs(to - from) < 4096 ? 1 : 0;
+                ++n;
+            }
+        }
+    }
+    return n ? static_cast<double>(near) / static_cast<double>(n) : 0.0;
+}
+
+double seconds_per_round(Factory &f, Time &t, int rounds) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i, ++t) {
+        f.do_deliveries(t);
+        f.do_package_passing();
+        f.do_work(t);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+               .count() /
+           rounds;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string shape = argc > 1 ? argv[1] : "random";
+    int n_workers = argc > 2 ? std::atoi(argv[2]) : 200000;
+    std::string order_name = argc > 3 ? argv[3] : "bfs";
+    if ((shape != "random" && shape != "layered") || n_workers < 1 ||
+        (order_name != "none" && order_name != "bfs" &&
+         order_name != "topological" && order_name != "chains")) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [random|layered] [workers] "
+                     "[none|bfs|topological|chains]\n";
+        return 1;
+    }
+
+    Factory f;
+    build(f, shape, n_workers);
+    double reorder_time = 0.0;
+    if (order_name != "none") {
+        auto start = std::chrono::steady_clock::now();
+        NodeOrder order = order_name == "bfs"           ? NodeOrder::BFS
+                          : order_name == "topological" ? NodeOrder::TOPOLOGICAL
+                                                        : NodeOrder::CHAINS;
+        reorder_for_locality(f, order);
+        reorder_time = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+    }
+
+    Time t = 1;
+    seconds_per_round(f, t, 50); // fill the queues
+    double round_time = seconds_per_round(f, t, 200);
+
+    std::cout << shape << ", " << n_workers << " workers, " << order_name
+              << ": reorder " << reorder_time * 1e3 << " ms, round "
+              << round_time * 1e3 << " ms, links within 4 KiB "
+              << near_link_share(f) * 100 << "%" << std::endl;
+    return 0;
+}